@@ -0,0 +1,299 @@
+// DZArray append benchmark
+// Appends n ints one at a time and in bulk, and builds many tiny
+// arrays with the default and with an exact initial capacity. Then
+// pushes and pops a stack back and forth over a shrink boundary,
+// under several growth and shrink policies. Last, removes and inserts
+// items at the front of a big array, one at a time with the old per
+// item moves and with the block moves, and as a single range.
+// Usage: dz_array_bench [n] [tiny_arrays] [rounds] [shift_n]
+//  n           - number of ints appended (default 10000000)
+//  tiny_arrays - number of 2 item arrays (default 1000000)
+//  rounds      - push and pop rounds of the thrash benchmark
+//                (default 1000000)
+//  shift_n     - length of the array items are removed from and
+//                inserted into (default 1000000)
+
+#include "dz_array.h"
+#include "dz_bench.h"
+
+// Items appended per dz_arrpush_n call by the batched benchmark
+#define BENCH_BATCH 64
+
+// What dz_arrpush did before it checked for room itself: a call into
+// the library for every item
+#define bench_push_call_per_item(a, item)                    \
+  do {                                                       \
+    if (!a) {                                                \
+      dz_impl_arr_init((void **)(&a), sizeof(*a));           \
+    } else {                                                 \
+      dz_impl_arr_maybe_grow(dz_array_header(a), sizeof(*a), \
+                             (void **)&a);                   \
+    }                                                        \
+    a[dz_array_header(a)->length++] = item;                  \
+  } while (0)
+
+static void bench_finish(const char *name, DZArray(int) arr,
+                         const size_t n, const uint64_t start) {
+  dz_bench_report(name, n, n, dz_bench_now_ns() - start);
+  if (dz_arrlen(arr) != n || arr[n - 1] != (int)(n - 1)) {
+    fprintf(stderr, "%s: wrong contents\n", name);
+    exit(1);
+  }
+  dz_arrfree(arr);
+}
+
+static void bench_append(const int *source, const size_t n) {
+  uint64_t start = dz_bench_now_ns();
+  DZArray(int) arr = NULL;
+  for (size_t i = 0; i < n; i++) {
+    bench_push_call_per_item(arr, source[i]);
+  }
+  bench_finish("push, call per item", arr, n, start);
+
+  start = dz_bench_now_ns();
+  arr = NULL;
+  for (size_t i = 0; i < n; i++) {
+    dz_arrpush(arr, source[i]);
+  }
+  bench_finish("dz_arrpush", arr, n, start);
+
+  start = dz_bench_now_ns();
+  arr = NULL;
+  dz_arrreserve(arr, n);
+  for (size_t i = 0; i < n; i++) {
+    dz_arrpush(arr, source[i]);
+  }
+  bench_finish("dz_arrreserve + dz_arrpush", arr, n, start);
+
+  start = dz_bench_now_ns();
+  arr = NULL;
+  for (size_t i = 0; i < n; i += BENCH_BATCH) {
+    dz_arrpush_n(arr, &source[i], n - i < BENCH_BATCH ? n - i
+                                                      : BENCH_BATCH);
+  }
+  bench_finish("dz_arrpush_n, batches of 64", arr, n, start);
+
+  start = dz_bench_now_ns();
+  arr = NULL;
+  dz_arrpush_n(arr, source, n);
+  bench_finish("dz_arrpush_n, all at once", arr, n, start);
+
+  start = dz_bench_now_ns();
+  arr = NULL;
+  dz_arrresize(arr, n);
+  memcpy(arr, source, n * sizeof(int));
+  bench_finish("dz_arrresize + memcpy", arr, n, start);
+}
+
+// Builds count arrays of 2 ints, and reports the time and the bytes
+// the arrays take up (headers and capacity, not counting malloc's own
+// overhead)
+static void bench_tiny(const size_t count, const int exact) {
+  DZArray(int) *arrays = calloc(count, sizeof(DZArray(int)));
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < count; i++) {
+    if (exact) {
+      dz_arrinit_cap(arrays[i], 2);
+    }
+    dz_arrpush(arrays[i], (int)i);
+    dz_arrpush(arrays[i], (int)i + 1);
+  }
+  const uint64_t elapsed = dz_bench_now_ns() - start;
+  size_t bytes = 0;
+  for (size_t i = 0; i < count; i++) {
+    bytes += sizeof(DZArrayHeader) +
+             dz_array_header(arrays[i])->capacity * sizeof(int);
+    dz_arrfree(arrays[i]);
+  }
+  free(arrays);
+  const char *name = exact ? "tiny, dz_arrinit_cap(2)" : "tiny, default";
+  dz_bench_report(name, count, count, elapsed);
+  printf("%-32s %zu bytes per array\n", name, bytes / count);
+}
+
+// Fills a stack to just over half of a capacity of 100, then pops 3
+// items and pushes them back, rounds times. Shrinking at half full,
+// like arrays did before they had a policy, reallocates twice a round
+static void bench_thrash(const char *name, const DZArrayPolicy policy,
+                         const size_t rounds) {
+  DZArray(int) arr = NULL;
+  dz_arrset_policy(arr, policy);
+  for (int i = 0; i < 51; i++) {
+    dz_arrpush(arr, i);
+  }
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t round = 0; round < rounds; round++) {
+    for (int i = 0; i < 3; i++) {
+      dz_arrpop(arr);
+    }
+    for (int i = 48; i < 51; i++) {
+      dz_arrpush(arr, i);
+    }
+  }
+  const uint64_t elapsed = dz_bench_now_ns() - start;
+  const DZArrayStats stats = dz_arrstats(arr);
+  dz_bench_report(name, rounds * 6, rounds * 6, elapsed);
+  printf("%-32s %zu reallocs, %zu bytes moved\n", name, stats.reallocs,
+         stats.bytes_moved);
+  dz_arrfree(arr);
+}
+
+// Items removed and inserted at the front by the shift benchmarks
+#define BENCH_SHIFT_ITEMS 100
+// One item in this many is removed by the remove_if benchmark
+#define BENCH_REMOVE_IF_EVERY 1000
+
+// What dz_arrremove and dz_arrinsert did before they moved the rest of
+// the array as a block: a memmove call for every item after index
+static void bench_remove_per_item(DZArray(int) arr, const size_t index) {
+  DZArrayHeader *header = dz_array_header(arr);
+  for (size_t i = index; i + 1 < header->length; i++) {
+    memmove(&arr[i], &arr[i + 1], sizeof(int));
+  }
+  header->length--;
+}
+
+static void bench_insert_per_item(DZArray(int) arr, const size_t index,
+                                  const int item) {
+  DZArrayHeader *header = dz_array_header(arr);
+  header->length++;
+  for (size_t i = header->length - 1; i > index; i--) {
+    memmove(&arr[i], &arr[i - 1], sizeof(int));
+  }
+  arr[index] = item;
+}
+
+static DZArray(int) bench_shift_array(const size_t n) {
+  DZArray(int) arr = NULL;
+  dz_arrreserve(arr, n + BENCH_SHIFT_ITEMS);
+  dz_arrresize(arr, n);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = (int)i;
+  }
+  return arr;
+}
+
+static void bench_shift_finish(const char *name, DZArray(int) arr,
+                               const size_t n, const uint64_t start,
+                               const size_t expected_length,
+                               const int expected_first) {
+  dz_bench_report(name, n, BENCH_SHIFT_ITEMS, dz_bench_now_ns() - start);
+  if (dz_arrlen(arr) != expected_length || arr[0] != expected_first) {
+    fprintf(stderr, "%s: wrong contents\n", name);
+    exit(1);
+  }
+  dz_arrfree(arr);
+}
+
+// Reports the time per item removed or inserted at the front of an
+// array of n items
+static void bench_shift(const size_t n) {
+  DZArray(int) arr = bench_shift_array(n);
+  uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < BENCH_SHIFT_ITEMS; i++) {
+    bench_remove_per_item(arr, 0);
+  }
+  bench_shift_finish("remove front, memmove per item", arr, n, start,
+                     n - BENCH_SHIFT_ITEMS, BENCH_SHIFT_ITEMS);
+
+  arr = bench_shift_array(n);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < BENCH_SHIFT_ITEMS; i++) {
+    dz_arrremove(arr, 0);
+  }
+  bench_shift_finish("dz_arrremove front", arr, n, start,
+                     n - BENCH_SHIFT_ITEMS, BENCH_SHIFT_ITEMS);
+
+  arr = bench_shift_array(n);
+  start = dz_bench_now_ns();
+  dz_arrremove_range(arr, 0, BENCH_SHIFT_ITEMS);
+  bench_shift_finish("dz_arrremove_range front", arr, n, start,
+                     n - BENCH_SHIFT_ITEMS, BENCH_SHIFT_ITEMS);
+
+  arr = bench_shift_array(n);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < BENCH_SHIFT_ITEMS; i++) {
+    bench_insert_per_item(arr, 0, -1);
+  }
+  bench_shift_finish("insert front, memmove per item", arr, n, start,
+                     n + BENCH_SHIFT_ITEMS, -1);
+
+  arr = bench_shift_array(n);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < BENCH_SHIFT_ITEMS; i++) {
+    dz_arrinsert(arr, 0, -1);
+  }
+  bench_shift_finish("dz_arrinsert front", arr, n, start,
+                     n + BENCH_SHIFT_ITEMS, -1);
+
+  int items[BENCH_SHIFT_ITEMS];
+  for (size_t i = 0; i < BENCH_SHIFT_ITEMS; i++) {
+    items[i] = -1;
+  }
+  arr = bench_shift_array(n);
+  start = dz_bench_now_ns();
+  dz_arrinsert_n(arr, 0, items, BENCH_SHIFT_ITEMS);
+  bench_shift_finish("dz_arrinsert_n front", arr, n, start,
+                     n + BENCH_SHIFT_ITEMS, -1);
+}
+
+#define BENCH_REMOVED(item) (*(item) % BENCH_REMOVE_IF_EVERY == 0)
+
+// Removes one item in BENCH_REMOVE_IF_EVERY from an array of n items,
+// with a dz_arrremove per item, and with dz_arrremove_if
+static void bench_remove_if(const size_t n) {
+  const size_t expected = n - (n + BENCH_REMOVE_IF_EVERY - 1) /
+                                  BENCH_REMOVE_IF_EVERY;
+  DZArray(int) arr = bench_shift_array(n);
+  uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < dz_arrlen(arr);) {
+    if (BENCH_REMOVED(&arr[i])) {
+      dz_arrremove(arr, i);
+    } else {
+      i++;
+    }
+  }
+  dz_bench_report("remove matches, dz_arrremove", n, n,
+                  dz_bench_now_ns() - start);
+  if (dz_arrlen(arr) != expected || arr[0] != 1) {
+    fprintf(stderr, "dz_arrremove: wrong contents\n");
+    exit(1);
+  }
+  dz_arrfree(arr);
+
+  arr = bench_shift_array(n);
+  start = dz_bench_now_ns();
+  dz_arrremove_if(arr, BENCH_REMOVED);
+  dz_bench_report("remove matches, dz_arrremove_if", n, n,
+                  dz_bench_now_ns() - start);
+  if (dz_arrlen(arr) != expected || arr[0] != 1) {
+    fprintf(stderr, "dz_arrremove_if: wrong contents\n");
+    exit(1);
+  }
+  dz_arrfree(arr);
+}
+
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+  const size_t tiny =
+      argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+  const size_t rounds =
+      argc > 3 ? strtoull(argv[3], NULL, 10) : 1000000;
+  const size_t shift_n =
+      argc > 4 ? strtoull(argv[4], NULL, 10) : 1000000;
+  int *source = malloc(n * sizeof(int));
+  for (size_t i = 0; i < n; i++) {
+    source[i] = (int)i;
+  }
+  bench_append(source, n);
+  bench_tiny(tiny, 0);
+  bench_tiny(tiny, 1);
+  const DZArrayPolicy shrink_at_half = {2.0f, 2, 2};
+  bench_thrash("thrash, shrink at 1/2", shrink_at_half, rounds);
+  bench_thrash("thrash, default policy", DZ_ARR_DEFAULT_POLICY, rounds);
+  bench_thrash("thrash, never shrink", DZ_ARR_NEVER_SHRINK, rounds);
+  bench_shift(shift_n);
+  bench_remove_if(shift_n);
+  free(source);
+  return 0;
+}
@@ -0,0 +1,100 @@
+// DZArray search benchmark
+// Scans arrays of n items of 1, 2, 4 and 8 bytes for an item they
+// don't hold, with a memcmp call per item (what dz_arrindexof did
+// before it had kernels), then with dz_arrindexof and dz_arrcount on
+// every kernel the CPU supports.
+// Usage: dz_array_search_bench [n] [repeats]
+//  n       - number of items (default 1000000)
+//  repeats - scans per measurement (default 100)
+
+#include "dz_array.h"
+#include "dz_bench.h"
+
+// What dz_impl_arr_indexof did before: memcmp on every item, with a
+// size only known at run time
+static ssize_t bench_indexof_memcmp(const void *items, const size_t n,
+                                    const void *item,
+                                    const size_t width) {
+  const uint8_t *bytes = (const uint8_t *)items;
+  for (size_t i = 0; i < n; i++) {
+    if (!memcmp(item, &bytes[i * width], width)) {
+      return (ssize_t)i;
+    }
+  }
+  return -1;
+}
+
+static const char *bench_isa_name(const DZArraySearchIsa isa) {
+  switch (isa) {
+    case DZ_ARR_SEARCH_SCALAR:
+      return "scalar";
+    case DZ_ARR_SEARCH_SSE2:
+      return "sse2";
+    default:
+      return "avx2";
+  }
+}
+
+static void bench_fail(const char *name) {
+  fprintf(stderr, "%s: wrong result\n", name);
+  exit(1);
+}
+
+// Items are 0, 1, 2, ... wrapping around for the small types, and the
+// item searched for is all ones, which none of them is
+#define BENCH_SEARCH(T, width_name, n, repeats)                          \
+  do {                                                                   \
+    DZArray(T) arr = NULL;                                               \
+    dz_arrresize(arr, n);                                                \
+    for (size_t i = 0; i < n; i++) {                                     \
+      arr[i] = (T)(i % ((T)~(T)0));                                      \
+    }                                                                    \
+    const T missing = (T)~(T)0;                                          \
+    volatile size_t width = sizeof(T);                                   \
+    char name[64];                                                       \
+    snprintf(name, sizeof(name), "%s, memcmp per item", width_name);     \
+    uint64_t start = dz_bench_now_ns();                                  \
+    for (size_t r = 0; r < repeats; r++) {                               \
+      if (bench_indexof_memcmp(arr, n, &missing, width) != -1) {         \
+        bench_fail(name);                                                \
+      }                                                                  \
+    }                                                                    \
+    dz_bench_report(name, n, n * repeats, dz_bench_now_ns() - start);    \
+    const DZArraySearchIsa best = dz_impl_arr_search_isa();              \
+    for (int isa = DZ_ARR_SEARCH_SCALAR; isa <= DZ_ARR_SEARCH_AVX2;      \
+         isa++) {                                                        \
+      if (!dz_impl_arr_search_set_isa((DZArraySearchIsa)isa)) {          \
+        continue;                                                        \
+      }                                                                  \
+      snprintf(name, sizeof(name), "%s, indexof %s", width_name,         \
+               bench_isa_name((DZArraySearchIsa)isa));                   \
+      start = dz_bench_now_ns();                                         \
+      for (size_t r = 0; r < repeats; r++) {                             \
+        if (dz_arrindexof(arr, &missing) != -1) {                        \
+          bench_fail(name);                                              \
+        }                                                                \
+      }                                                                  \
+      dz_bench_report(name, n, n * repeats, dz_bench_now_ns() - start);  \
+      snprintf(name, sizeof(name), "%s, count %s", width_name,           \
+               bench_isa_name((DZArraySearchIsa)isa));                   \
+      start = dz_bench_now_ns();                                         \
+      for (size_t r = 0; r < repeats; r++) {                             \
+        if (dz_arrcount(arr, &missing) != 0) {                           \
+          bench_fail(name);                                              \
+        }                                                                \
+      }                                                                  \
+      dz_bench_report(name, n, n * repeats, dz_bench_now_ns() - start);  \
+    }                                                                    \
+    dz_impl_arr_search_set_isa(best);                                    \
+    dz_arrfree(arr);                                                     \
+  } while (0)
+
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  const size_t repeats = argc > 2 ? strtoull(argv[2], NULL, 10) : 100;
+  BENCH_SEARCH(uint8_t, "1 byte", n, repeats);
+  BENCH_SEARCH(uint16_t, "2 bytes", n, repeats);
+  BENCH_SEARCH(uint32_t, "4 bytes", n, repeats);
+  BENCH_SEARCH(uint64_t, "8 bytes", n, repeats);
+  return 0;
+}
@@ -0,0 +1,111 @@
+// DZArray sort benchmark
+// Sorts arrays of random uint32_t with qsort, dz_arrsort and
+// dz_arrradix_sort, and looks every item up again with bsearch and
+// dz_arrbsearch. Small arrays are sorted many times over, so every
+// size sorts about the same number of items in total.
+// Usage: dz_array_sort_bench [sizes...]
+//  sizes - array lengths to sort (default 1000 1000000 100000000)
+
+#include "dz_array_sort.h"
+#include "dz_bench.h"
+
+// Items sorted per measurement, at least, spread over repeats
+#define BENCH_MIN_ITEMS 10000000
+
+#define BENCH_LESS(x, y) (*(x) < *(y))
+
+static int bench_compare(const void *x, const void *y) {
+  const uint32_t a = *(const uint32_t *)x;
+  const uint32_t b = *(const uint32_t *)y;
+  return (a > b) - (a < b);
+}
+
+static void bench_check_sorted(const char *name, DZArray(uint32_t) arr) {
+  for (size_t i = 1; i < dz_arrlen(arr); i++) {
+    if (arr[i] < arr[i - 1]) {
+      fprintf(stderr, "%s: not sorted at %zu\n", name, i);
+      exit(1);
+    }
+  }
+}
+
+enum { BENCH_QSORT, BENCH_DZ_ARRSORT, BENCH_RADIX };
+
+// Sorts a fresh copy of source repeats times, and reports the time
+// taken by the sorts alone
+static void bench_sort(const int method, const uint32_t *source,
+                       DZArray(uint32_t) arr, const size_t repeats) {
+  static const char *const names[] = {"qsort", "dz_arrsort",
+                                      "dz_arrradix_sort"};
+  const size_t n = dz_arrlen(arr);
+  uint64_t elapsed = 0;
+  for (size_t r = 0; r < repeats; r++) {
+    memcpy(arr, source, n * sizeof(uint32_t));
+    const uint64_t start = dz_bench_now_ns();
+    switch (method) {
+      case BENCH_QSORT:
+        qsort(arr, n, sizeof(uint32_t), bench_compare);
+        break;
+      case BENCH_DZ_ARRSORT:
+        dz_arrsort(arr, BENCH_LESS);
+        break;
+      default:
+        dz_arrradix_sort(arr);
+        break;
+    }
+    elapsed += dz_bench_now_ns() - start;
+  }
+  dz_bench_report(names[method], n, n * repeats, elapsed);
+  bench_check_sorted(names[method], arr);
+}
+
+// Looks every item of source up in the sorted arr
+static void bench_search(const uint32_t *source, DZArray(uint32_t) arr) {
+  const size_t n = dz_arrlen(arr);
+  uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    if (!bsearch(&source[i], arr, n, sizeof(uint32_t), bench_compare)) {
+      fprintf(stderr, "bsearch: missed %zu\n", i);
+      exit(1);
+    }
+  }
+  dz_bench_report("bsearch", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    if (dz_arrbsearch(arr, &source[i], BENCH_LESS) == -1) {
+      fprintf(stderr, "dz_arrbsearch: missed %zu\n", i);
+      exit(1);
+    }
+  }
+  dz_bench_report("dz_arrbsearch", n, n, dz_bench_now_ns() - start);
+}
+
+static void bench_size(const size_t n) {
+  uint32_t *source = malloc(n * sizeof(uint32_t));
+  uint64_t seed = 0x5eed;
+  for (size_t i = 0; i < n; i++) {
+    source[i] = (uint32_t)dz_bench_rand(&seed);
+  }
+  DZArray(uint32_t) arr = NULL;
+  dz_arrresize(arr, n);
+  const size_t repeats = n < BENCH_MIN_ITEMS ? BENCH_MIN_ITEMS / n : 1;
+  bench_sort(BENCH_QSORT, source, arr, repeats);
+  bench_sort(BENCH_DZ_ARRSORT, source, arr, repeats);
+  bench_sort(BENCH_RADIX, source, arr, repeats);
+  bench_search(source, arr);
+  dz_arrfree(arr);
+  free(source);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      bench_size(strtoull(argv[i], NULL, 10));
+    }
+    return 0;
+  }
+  bench_size(1000);
+  bench_size(1000000);
+  bench_size(100000000);
+  return 0;
+}
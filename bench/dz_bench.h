@@ -0,0 +1,46 @@
+#pragma once
+
+// Small helpers shared by the benchmarks
+// Each benchmark is a plain executable that prints one line per
+// measurement. Build with CMAKE_BUILD_TYPE=Release for real numbers.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Monotonic time in nanoseconds
+static inline uint64_t dz_bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Deterministic pseudo random numbers (splitmix64)
+static inline uint64_t dz_bench_rand(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Prints a single result line. ops is the number of operations
+// that took elapsed_ns in total
+static inline void dz_bench_report(const char *name, size_t n,
+                                   size_t ops, uint64_t elapsed_ns) {
+  printf("%-32s n=%-10zu %10.2f ms %9.2f ns/op\n", name, n,
+         elapsed_ns / 1e6, ops ? (double)elapsed_ns / ops : 0.0);
+}
+
+// Returns true if the benchmark called name should run, given the
+// filter passed on the command line (NULL runs everything)
+static inline int dz_bench_selected(const char *filter,
+                                    const char *name) {
+  return !filter || strstr(name, filter) != NULL;
+}
+
+// Keeps the compiler from optimizing a result away
+static inline void dz_bench_escape(const void *p) {
+  __asm__ volatile("" : : "g"(p) : "memory");
+}
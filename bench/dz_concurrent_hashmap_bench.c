@@ -0,0 +1,117 @@
+// Concurrent hashmap scaling benchmark
+// Runs the same mixed workload (90% lookups, 10% overwrites by
+// default) on 1, 2, 4, ... up to max_threads threads, against a
+// DzHashmap behind one global mutex and against DzConcurrentHashmap.
+// Usage: dz_concurrent_hashmap_bench [max_threads] [n] [write_pct]
+//  max_threads - largest thread count (default: number of cores)
+//  n           - number of keys (default 1000000)
+//  write_pct   - percentage of operations that are chm_add (default 10)
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "dz_bench.h"
+#include "dz_concurrent_hashmap.h"
+
+#define BENCH_OPS_PER_THREAD 2000000
+
+typedef struct BenchShared {
+  DzHashmap hm;  // Used with lock, when chm is NULL
+  pthread_mutex_t lock;
+  DzConcurrentHashmap chm;
+  uint64_t n;
+  uint64_t write_pct;
+} BenchShared;
+
+typedef struct BenchThread {
+  BenchShared *shared;
+  uint64_t seed;
+  pthread_t thread;
+} BenchThread;
+
+static void *bench_worker(void *arg) {
+  BenchThread *self = (BenchThread *)arg;
+  BenchShared *shared = self->shared;
+  uint64_t seed = self->seed;
+  for (size_t i = 0; i < BENCH_OPS_PER_THREAD; i++) {
+    const uint64_t r = dz_bench_rand(&seed);
+    const uint64_t key = r % shared->n;
+    const int write = (r >> 32) % 100 < shared->write_pct;
+    uint64_t value = key;
+    if (shared->chm) {
+      if (write) {
+        chm_add(shared->chm, &key, sizeof(key), &r, sizeof(r), NULL);
+      } else {
+        chm_get(shared->chm, &key, sizeof(key), &value,
+                sizeof(value));
+      }
+    } else {
+      pthread_mutex_lock(&shared->lock);
+      if (write) {
+        hm_add(shared->hm, &key, sizeof(key), &r, sizeof(r), NULL);
+      } else {
+        const void *found = hm_get(shared->hm, &key, sizeof(key));
+        if (found) {
+          memcpy(&value, found, sizeof(value));
+        }
+      }
+      pthread_mutex_unlock(&shared->lock);
+    }
+    dz_bench_escape(&value);
+  }
+  return NULL;
+}
+
+static void bench_run(const char *name, BenchShared *shared,
+                      const size_t threads) {
+  BenchThread *workers = calloc(threads, sizeof(BenchThread));
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t t = 0; t < threads; t++) {
+    workers[t].shared = shared;
+    workers[t].seed = t + 1;
+    pthread_create(&workers[t].thread, NULL, bench_worker,
+                   &workers[t]);
+  }
+  for (size_t t = 0; t < threads; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+  const uint64_t elapsed = dz_bench_now_ns() - start;
+  const size_t ops = threads * BENCH_OPS_PER_THREAD;
+  printf("%-24s threads=%-3zu %8.2f Mops/s\n", name, threads,
+         ops / (elapsed / 1e3));
+  free(workers);
+}
+
+int main(int argc, char **argv) {
+  const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  const size_t max_threads = argc > 1 ? strtoull(argv[1], NULL, 10)
+                                      : (size_t)(cores > 0 ? cores : 1);
+  const uint64_t n = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+  const uint64_t write_pct =
+      argc > 3 ? strtoull(argv[3], NULL, 10) : 10;
+  BenchShared shared = {
+      .hm = hm_init_with_capacity(n, NULL),
+      .chm = NULL,
+      .n = n,
+      .write_pct = write_pct,
+  };
+  pthread_mutex_init(&shared.lock, NULL);
+  DzConcurrentHashmap chm = chm_init(0, NULL);
+  for (uint64_t key = 0; key < n; key++) {
+    hm_add(shared.hm, &key, sizeof(key), &key, sizeof(key), NULL);
+    chm_add(chm, &key, sizeof(key), &key, sizeof(key), NULL);
+  }
+  for (size_t threads = 1; threads <= max_threads;
+       threads = threads < max_threads && threads * 2 > max_threads
+                     ? max_threads
+                     : threads * 2) {
+    shared.chm = NULL;
+    bench_run("hm + global mutex", &shared, threads);
+    shared.chm = chm;
+    bench_run("chm", &shared, threads);
+  }
+  chm_free(chm);
+  hm_free(shared.hm);
+  pthread_mutex_destroy(&shared.lock);
+  return 0;
+}
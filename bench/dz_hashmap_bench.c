@@ -0,0 +1,321 @@
+// Hashmap benchmarks
+// Usage: dz_hashmap_bench [filter] [n]
+//  filter - only runs benchmarks whose name contains this string
+//  n      - number of keys (default 1000000)
+
+#include "dz_array.h"
+#include "dz_bench.h"
+#include "dz_debug.h"
+#include "dz_hashmap.h"
+
+#define BENCH_KEY_MAX 32
+
+typedef struct BenchKeys {
+  char (*keys)[BENCH_KEY_MAX];
+  size_t *keysizes;
+  size_t n;
+} BenchKeys;
+
+// Keys look like "user:0000001234:x", similar to real string keys
+static BenchKeys bench_keys_create(size_t n, uint64_t seed) {
+  BenchKeys keys = {
+      .keys = malloc(n * BENCH_KEY_MAX),
+      .keysizes = malloc(n * sizeof(size_t)),
+      .n = n,
+  };
+  for (size_t i = 0; i < n; i++) {
+    keys.keysizes[i] = (size_t)snprintf(
+        keys.keys[i], BENCH_KEY_MAX, "user:%010llu:x",
+        (unsigned long long)(dz_bench_rand(&seed) >> 1));
+  }
+  return keys;
+}
+
+static void bench_keys_free(BenchKeys *keys) {
+  free(keys->keys);
+  free(keys->keysizes);
+}
+
+static DzHashmap bench_fill(const BenchKeys *keys) {
+  DzHashmap hm = hm_init(NULL);
+  for (size_t i = 0; i < keys->n; i++) {
+    const uint64_t value = i;
+    hm_add(hm, keys->keys[i], keys->keysizes[i], &value,
+           sizeof(value), NULL);
+  }
+  return hm;
+}
+
+static void bench_insert(const BenchKeys *keys) {
+  const uint64_t start = dz_bench_now_ns();
+  DzHashmap hm = bench_fill(keys);
+  dz_bench_report("hm_add", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+static void bench_insert_reserved(const BenchKeys *keys) {
+  const uint64_t start = dz_bench_now_ns();
+  DzHashmap hm = hm_init_with_capacity(keys->n, NULL);
+  for (size_t i = 0; i < keys->n; i++) {
+    const uint64_t value = i;
+    hm_add(hm, keys->keys[i], keys->keysizes[i], &value,
+           sizeof(value), NULL);
+  }
+  dz_bench_report("hm_add reserved", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+static void bench_get_hit(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  size_t found = 0;
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    const void *value =
+        hm_get(hm, keys->keys[i], keys->keysizes[i]);
+    found += value != NULL;
+    dz_bench_escape(value);
+  }
+  dz_bench_report("hm_get hit", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  if (found != keys->n) {
+    printf("  WARNING: only found %zu of %zu keys\n", found,
+           keys->n);
+  }
+  hm_free(hm);
+}
+
+// Looks the same few keys up over and over, hashing every time and
+// with the hashes computed once up front
+static void bench_get_prehashed(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  const size_t hot = min(keys->n, (size_t)64);
+  DzHmHash hashes[64];
+  for (size_t i = 0; i < hot; i++) {
+    hashes[i] = hm_hash(hm, keys->keys[i], keys->keysizes[i]);
+  }
+  uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    const size_t k = i % hot;
+    dz_bench_escape(hm_get(hm, keys->keys[k], keys->keysizes[k]));
+  }
+  dz_bench_report("hm_get hot keys", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    const size_t k = i % hot;
+    dz_bench_escape(hm_get_prehashed(hm, keys->keys[k],
+                                     keys->keysizes[k], hashes[k]));
+  }
+  dz_bench_report("hm_get_prehashed hot keys", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+static void bench_get_miss(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  BenchKeys missing = bench_keys_create(keys->n, 0xdead);
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < missing.n; i++) {
+    dz_bench_escape(
+        hm_get(hm, missing.keys[i], missing.keysizes[i]));
+  }
+  dz_bench_report("hm_get miss", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  bench_keys_free(&missing);
+  hm_free(hm);
+}
+
+// Overwrites every key with a value of the same size
+static void bench_overwrite(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    const uint64_t value = i + 1;
+    hm_add(hm, keys->keys[i], keys->keysizes[i], &value,
+           sizeof(value), NULL);
+  }
+  dz_bench_report("hm_add overwrite", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+// Deletes and re-adds every key, keeping the size of the map steady
+static void bench_delete_add(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    const uint64_t value = i;
+    hm_delete(hm, keys->keys[i], keys->keysizes[i]);
+    hm_add(hm, keys->keys[i], keys->keysizes[i], &value,
+           sizeof(value), NULL);
+  }
+  dz_bench_report("hm_delete + hm_add", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+static void bench_free(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  const uint64_t start = dz_bench_now_ns();
+  hm_free(hm);
+  dz_bench_report("hm_free", keys->n, 1, dz_bench_now_ns() - start);
+}
+
+// Looks every key up in a shuffled order, with hm_get in a loop and
+// with hm_get_many. Use an n whose table is much bigger than the last
+// level cache to see the effect of overlapping the cache misses.
+static void bench_get_many(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  const void **key_ptrs = malloc(keys->n * sizeof(void *));
+  size_t *keysizes = malloc(keys->n * sizeof(size_t));
+  const void **values = malloc(keys->n * sizeof(void *));
+  uint64_t seed = 42;
+  for (size_t i = 0; i < keys->n; i++) {
+    const size_t k = dz_bench_rand(&seed) % keys->n;
+    key_ptrs[i] = keys->keys[k];
+    keysizes[i] = keys->keysizes[k];
+  }
+  uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    values[i] = hm_get(hm, key_ptrs[i], keysizes[i]);
+  }
+  dz_bench_report("hm_get loop (shuffled)", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  dz_bench_escape(values);
+  start = dz_bench_now_ns();
+  hm_get_many(hm, key_ptrs, keysizes, keys->n, values);
+  dz_bench_report("hm_get_many (shuffled)", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  dz_bench_escape(values);
+  free(key_ptrs);
+  free(keysizes);
+  free(values);
+  hm_free(hm);
+}
+
+// Worst single hm_add while growing a map from empty, which is
+// dominated by the insert that triggers the largest resize
+static void bench_max_latency(const BenchKeys *keys,
+                              const bool incremental) {
+  DzHashmap hm = hm_init(NULL);
+  hm_set_incremental_resize(hm, incremental);
+  uint64_t longest = 0;
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    const uint64_t value = i;
+    const uint64_t op_start = dz_bench_now_ns();
+    hm_add(hm, keys->keys[i], keys->keysizes[i], &value,
+           sizeof(value), NULL);
+    longest = max(longest, dz_bench_now_ns() - op_start);
+  }
+  const uint64_t elapsed = dz_bench_now_ns() - start;
+  dz_bench_report(incremental ? "hm_add incremental"
+                              : "hm_add stop the world",
+                  keys->n, keys->n, elapsed);
+  printf("  max single hm_add: %.1f us\n", longest / 1e3);
+  hm_free(hm);
+}
+
+// Visits every item with the iterator, then exports them all
+static void bench_iterate(const BenchKeys *keys) {
+  DzHashmap hm = bench_fill(keys);
+  uint64_t start = dz_bench_now_ns();
+  uint64_t sum = 0;
+  DzHmIter it = hm_iter_begin(hm);
+  while (hm_iter_next(&it)) {
+    sum += *(const uint64_t *)it.value;
+  }
+  dz_bench_escape(&sum);
+  dz_bench_report("hm_iter", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  DZArray(DzHmSpan) exported_keys = NULL;
+  DZArray(DzHmSpan) exported_values = NULL;
+  start = dz_bench_now_ns();
+  hm_export(hm, &exported_keys, &exported_values);
+  dz_bench_report("hm_export", keys->n, keys->n,
+                  dz_bench_now_ns() - start);
+  dz_arrfree(exported_keys);
+  dz_arrfree(exported_values);
+  hm_free(hm);
+}
+
+// Counts how often each key shows up in a stream of n keys drawn from
+// the first n / 8 keys, the way an aggregation loop would
+static void bench_count(const BenchKeys *keys, const bool upsert) {
+  const size_t distinct = max(keys->n / 8, (size_t)1);
+  DzHashmap hm = hm_init(NULL);
+  uint64_t seed = 0xc0de;
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < keys->n; i++) {
+    const size_t k = dz_bench_rand(&seed) % distinct;
+    if (upsert) {
+      uint64_t *count = (uint64_t *)hm_get_or_insert(
+          hm, keys->keys[k], keys->keysizes[k], sizeof(uint64_t), NULL,
+          NULL);
+      (*count)++;
+    } else {
+      const uint64_t *found =
+          (const uint64_t *)hm_get(hm, keys->keys[k], keys->keysizes[k]);
+      const uint64_t count = found ? *found + 1 : 1;
+      hm_add(hm, keys->keys[k], keys->keysizes[k], &count,
+             sizeof(count), NULL);
+    }
+  }
+  dz_bench_report(
+      upsert ? "count hm_get_or_insert" : "count hm_get + hm_add",
+      keys->n, keys->n, dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+int main(int argc, char **argv) {
+  const char *filter = argc > 1 ? argv[1] : NULL;
+  const size_t n = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+  BenchKeys keys = bench_keys_create(n, 0x5eed);
+  if (dz_bench_selected(filter, "hm_add")) {
+    bench_insert(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_add reserved")) {
+    bench_insert_reserved(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_get hit")) {
+    bench_get_hit(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_get_prehashed")) {
+    bench_get_prehashed(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_get miss")) {
+    bench_get_miss(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_add overwrite")) {
+    bench_overwrite(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_delete + hm_add")) {
+    bench_delete_add(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_free")) {
+    bench_free(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_get_many")) {
+    bench_get_many(&keys);
+  }
+  if (dz_bench_selected(filter, "hm_add stop the world")) {
+    bench_max_latency(&keys, false);
+  }
+  if (dz_bench_selected(filter, "hm_add incremental")) {
+    bench_max_latency(&keys, true);
+  }
+  if (dz_bench_selected(filter, "hm_iter") ||
+      dz_bench_selected(filter, "hm_export")) {
+    bench_iterate(&keys);
+  }
+  if (dz_bench_selected(filter, "count hm_get + hm_add")) {
+    bench_count(&keys, false);
+  }
+  if (dz_bench_selected(filter, "count hm_get_or_insert")) {
+    bench_count(&keys, true);
+  }
+  bench_keys_free(&keys);
+  return 0;
+}
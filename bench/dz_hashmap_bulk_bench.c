@@ -0,0 +1,102 @@
+// Bulk build benchmark
+// Builds a map of n uint64_t -> uint64_t pairs with an hm_add loop
+// into a presized map, then with hm_build_bulk on 1, 2, 4, ... up to
+// max_threads threads.
+// Usage: dz_hashmap_bulk_bench [max_threads] [n]
+//  max_threads - largest thread count (default: number of cores)
+//  n           - number of pairs (default 10000000)
+
+#include <unistd.h>
+
+#include "dz_bench.h"
+#include "dz_hashmap.h"
+#include "dz_hashmap_bulk.h"
+
+typedef struct BenchInput {
+  uint64_t *key_data;
+  uint64_t *value_data;
+  const void **keys;
+  const void **values;
+  size_t *sizes;  // Every key and value is 8 bytes
+} BenchInput;
+
+static BenchInput bench_input_create(const size_t n) {
+  BenchInput input;
+  input.key_data = malloc(n * sizeof(uint64_t));
+  input.value_data = malloc(n * sizeof(uint64_t));
+  input.keys = malloc(n * sizeof(void *));
+  input.values = malloc(n * sizeof(void *));
+  input.sizes = malloc(n * sizeof(size_t));
+  uint64_t seed = 0x5eed;
+  for (size_t i = 0; i < n; i++) {
+    input.key_data[i] = dz_bench_rand(&seed);
+    input.value_data[i] = i;
+    input.keys[i] = &input.key_data[i];
+    input.values[i] = &input.value_data[i];
+    input.sizes[i] = sizeof(uint64_t);
+  }
+  return input;
+}
+
+static void bench_input_free(BenchInput *input) {
+  free(input->key_data);
+  free(input->value_data);
+  free(input->keys);
+  free(input->values);
+  free(input->sizes);
+}
+
+// Looks a sample of the keys up, so a broken build doesn't go unseen
+static void bench_check(DzHashmap hm, const BenchInput *input,
+                        const size_t n) {
+  for (size_t i = 0; i < n; i += 1009) {
+    const uint64_t *value =
+        hm_get(hm, &input->key_data[i], sizeof(uint64_t));
+    if (!value || *value != i) {
+      fprintf(stderr, "key %zu missing from the built map\n", i);
+      exit(1);
+    }
+  }
+}
+
+static void bench_add(const BenchInput *input, const size_t n) {
+  const uint64_t start = dz_bench_now_ns();
+  DzHashmap hm = hm_init_with_capacity(n, NULL);
+  for (size_t i = 0; i < n; i++) {
+    hm_add(hm, input->keys[i], sizeof(uint64_t), input->values[i],
+           sizeof(uint64_t), NULL);
+  }
+  dz_bench_report("hm_add (presized)", n, n, dz_bench_now_ns() - start);
+  bench_check(hm, input, n);
+  hm_free(hm);
+}
+
+static void bench_bulk(const BenchInput *input, const size_t n,
+                       const size_t threads) {
+  char name[64];
+  snprintf(name, sizeof(name), "hm_build_bulk threads=%zu", threads);
+  const uint64_t start = dz_bench_now_ns();
+  DzHashmap hm =
+      hm_build_bulk(input->keys, input->sizes, input->values,
+                    input->sizes, n, threads, NULL);
+  dz_bench_report(name, n, n, dz_bench_now_ns() - start);
+  bench_check(hm, input, n);
+  hm_free(hm);
+}
+
+int main(int argc, char **argv) {
+  const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  const size_t max_threads = argc > 1 ? strtoull(argv[1], NULL, 10)
+                                      : (size_t)(cores > 0 ? cores : 1);
+  const size_t n = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+  BenchInput input = bench_input_create(n);
+  bench_add(&input, n);
+  for (size_t threads = 1; threads <= max_threads;
+       threads = threads < max_threads && threads * 2 > max_threads
+                     ? max_threads
+                     : threads * 2) {
+    bench_bulk(&input, n, threads);
+  }
+  bench_input_free(&input);
+  return 0;
+}
@@ -0,0 +1,192 @@
+// Cache benchmark under a Zipfian key distribution
+// Replays the same stream of lookups against DzHmCache and against
+// an exact LRU cache built by hand out of a DzHashmap and a linked
+// list, which is how caches were built before DzHmCache. Every miss
+// is followed by a put, like a read-through cache.
+// Usage: dz_hashmap_cache_bench [keys] [ops] [zipf_s]
+//  keys   - number of distinct keys (default 1000000)
+//  ops    - number of lookups (default 5000000)
+//  zipf_s - skew of the distribution (default 0.99)
+
+#include <math.h>
+
+#include "dz_bench.h"
+#include "dz_hashmap.h"
+#include "dz_hashmap_cache.h"
+
+#define BENCH_VALUE_SIZE 32
+
+// Draws ops ranks in [0, keys) with P(rank) proportional to
+// 1 / (rank + 1)^s, and turns them into scattered keys
+static uint64_t *bench_zipf_stream(const size_t keys, const size_t ops,
+                                   const double s) {
+  double *cdf = malloc(keys * sizeof(double));
+  double total = 0;
+  for (size_t i = 0; i < keys; i++) {
+    total += 1.0 / pow((double)(i + 1), s);
+    cdf[i] = total;
+  }
+  uint64_t *stream = malloc(ops * sizeof(uint64_t));
+  uint64_t seed = 0x21bf;
+  for (size_t i = 0; i < ops; i++) {
+    const double u =
+        (double)(dz_bench_rand(&seed) >> 11) / (1ull << 53) * total;
+    size_t low = 0;
+    size_t high = keys - 1;
+    while (low < high) {
+      const size_t mid = low + (high - low) / 2;
+      if (cdf[mid] < u) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    stream[i] = low * 0x9e3779b97f4a7c15ull;
+  }
+  free(cdf);
+  return stream;
+}
+
+// Exact LRU: the map holds the index of each key's node, and the
+// nodes form a doubly linked list, most recently used first
+typedef struct BenchLruNode {
+  uint64_t key;
+  size_t prev;
+  size_t next;
+  char value[BENCH_VALUE_SIZE];
+} BenchLruNode;
+
+typedef struct BenchLru {
+  DzHashmap index;
+  BenchLruNode *nodes;
+  size_t capacity;
+  size_t count;
+  size_t head;  // Most recently used, or capacity if empty
+  size_t tail;  // Least recently used
+} BenchLru;
+
+static void bench_lru_unlink(BenchLru *lru, const size_t node) {
+  BenchLruNode *n = &lru->nodes[node];
+  if (n->prev != lru->capacity) {
+    lru->nodes[n->prev].next = n->next;
+  } else {
+    lru->head = n->next;
+  }
+  if (n->next != lru->capacity) {
+    lru->nodes[n->next].prev = n->prev;
+  } else {
+    lru->tail = n->prev;
+  }
+}
+
+static void bench_lru_push_front(BenchLru *lru, const size_t node) {
+  lru->nodes[node].prev = lru->capacity;
+  lru->nodes[node].next = lru->head;
+  if (lru->head != lru->capacity) {
+    lru->nodes[lru->head].prev = node;
+  } else {
+    lru->tail = node;
+  }
+  lru->head = node;
+}
+
+static const char *bench_lru_get(BenchLru *lru, const uint64_t key) {
+  const size_t *node =
+      (const size_t *)hm_get(lru->index, &key, sizeof(key));
+  if (!node) {
+    return NULL;
+  }
+  const size_t found = *node;
+  bench_lru_unlink(lru, found);
+  bench_lru_push_front(lru, found);
+  return lru->nodes[found].value;
+}
+
+static void bench_lru_put(BenchLru *lru, const uint64_t key,
+                          const char *value) {
+  size_t node;
+  if (lru->count < lru->capacity) {
+    node = lru->count++;
+  } else {
+    node = lru->tail;
+    bench_lru_unlink(lru, node);
+    hm_delete(lru->index, &lru->nodes[node].key, sizeof(uint64_t));
+  }
+  lru->nodes[node].key = key;
+  memcpy(lru->nodes[node].value, value, BENCH_VALUE_SIZE);
+  hm_add(lru->index, &key, sizeof(key), &node, sizeof(node), NULL);
+  bench_lru_push_front(lru, node);
+}
+
+static void bench_lru(const uint64_t *stream, const size_t ops,
+                      const size_t capacity) {
+  BenchLru lru = {
+      .index = hm_init_with_capacity(capacity, NULL),
+      .nodes = malloc(capacity * sizeof(BenchLruNode)),
+      .capacity = capacity,
+      .count = 0,
+      .head = capacity,
+      .tail = capacity,
+  };
+  char value[BENCH_VALUE_SIZE] = {0};
+  size_t hits = 0;
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    const char *found = bench_lru_get(&lru, stream[i]);
+    if (found) {
+      hits++;
+      dz_bench_escape(found);
+    } else {
+      bench_lru_put(&lru, stream[i], value);
+    }
+  }
+  const uint64_t elapsed = dz_bench_now_ns() - start;
+  char name[64];
+  snprintf(name, sizeof(name), "LRU by hand   cap=%zu", capacity);
+  dz_bench_report(name, ops, ops, elapsed);
+  printf("  hit rate %.2f%%\n", 100.0 * hits / ops);
+  hm_free(lru.index);
+  free(lru.nodes);
+}
+
+static void bench_cache(const uint64_t *stream, const size_t ops,
+                        const size_t capacity) {
+  DzHmCache cache = hm_cache_init(capacity, 0, NULL);
+  char value[BENCH_VALUE_SIZE] = {0};
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    const void *found =
+        hm_cache_get(cache, &stream[i], sizeof(uint64_t), NULL);
+    if (found) {
+      dz_bench_escape(found);
+    } else {
+      hm_cache_put(cache, &stream[i], sizeof(uint64_t), value,
+                   sizeof(value), NULL);
+    }
+  }
+  const uint64_t elapsed = dz_bench_now_ns() - start;
+  DzHmCacheStats stats;
+  hm_cache_stats(cache, &stats);
+  char name[64];
+  snprintf(name, sizeof(name), "DzHmCache     cap=%zu", capacity);
+  dz_bench_report(name, ops, ops, elapsed);
+  printf("  hit rate %.2f%%, %llu evictions\n", 100.0 * stats.hit_rate,
+         (unsigned long long)stats.evictions);
+  hm_cache_free(cache);
+}
+
+int main(int argc, char **argv) {
+  const size_t keys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  const size_t ops = argc > 2 ? strtoull(argv[2], NULL, 10) : 5000000;
+  const double s = argc > 3 ? strtod(argv[3], NULL) : 0.99;
+  uint64_t *stream = bench_zipf_stream(keys, ops, s);
+  const size_t capacities[] = {keys / 100, keys / 10};
+  for (size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]);
+       i++) {
+    const size_t capacity = capacities[i] ? capacities[i] : 1;
+    bench_lru(stream, ops, capacity);
+    bench_cache(stream, ops, capacity);
+  }
+  free(stream);
+  return 0;
+}
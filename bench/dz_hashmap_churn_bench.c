@@ -0,0 +1,74 @@
+// Hashmap churn benchmark
+// Keeps a map at a steady size while deleting and inserting keys,
+// and reports the probe lengths, tombstones and capacity after each
+// round from hm_stats, along with the cost of lookups that miss.
+// Probe lengths, miss costs and capacity should stay flat.
+// Usage: dz_hashmap_churn_bench [n] [rounds]
+//  n      - number of live keys (default 1000000)
+//  rounds - rounds of replacing every key once (default 10)
+//
+// Groups probed per miss come from the operation counters, so they
+// are only shown when the library is built with DZ_HASHMAP_COUNTERS
+
+#include "dz_bench.h"
+#include "dz_hashmap.h"
+
+// Lookups that miss stop at the first group with an EMPTY slot, so
+// tombstones make them longer
+#define CHURN_MISS_SAMPLES 100000
+
+static void churn_report(const DzHashmap hm, const size_t round,
+                         const uint64_t elapsed_ns,
+                         const size_t ops) {
+  DzHmStats before;
+  hm_stats(hm, &before);
+  // The live keys never have the top bit set
+  uint64_t seed = round;
+  const uint64_t start = dz_bench_now_ns();
+  for (size_t i = 0; i < CHURN_MISS_SAMPLES; i++) {
+    const uint64_t missing = dz_bench_rand(&seed) | (1ull << 63);
+    dz_bench_escape(hm_get(hm, &missing, sizeof(missing)));
+  }
+  const uint64_t miss_ns = dz_bench_now_ns() - start;
+  DzHmStats after;
+  hm_stats(hm, &after);
+  char miss_probe[32] = "n/a";
+  if (after.counters_enabled) {
+    snprintf(miss_probe, sizeof(miss_probe), "%.3f",
+             (double)(after.find_groups - before.find_groups) /
+                 (double)(after.finds - before.finds));
+  }
+  printf(
+      "round %-3zu capacity=%-9zu tombstones=%-9zu hit probe "
+      "avg=%.3f max=%-3zu miss probe avg=%s miss %.2f ns "
+      "rehashes=%-3zu %8.2f ns/op\n",
+      round, after.capacity, after.tombstones, after.avg_probe_length,
+      after.max_probe_length, miss_probe,
+      (double)miss_ns / CHURN_MISS_SAMPLES, after.rehash_count,
+      (double)elapsed_ns / ops);
+}
+
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  const size_t rounds = argc > 2 ? strtoull(argv[2], NULL, 10) : 10;
+  // The live keys are a sliding window [next - n, next) over a
+  // stream of unique integers
+  DzHashmap hm = hm_init(NULL);
+  uint64_t next = 0;
+  for (; next < n; next++) {
+    hm_add(hm, &next, sizeof(next), &next, sizeof(next), NULL);
+  }
+  churn_report(hm, 0, 0, 1);
+  for (size_t round = 1; round <= rounds; round++) {
+    const uint64_t start = dz_bench_now_ns();
+    for (size_t i = 0; i < n; i++, next++) {
+      const uint64_t oldest = next - n;
+      hm_delete(hm, &oldest, sizeof(oldest));
+      hm_add(hm, &next, sizeof(next), &next, sizeof(next), NULL);
+      dz_bench_escape(hm_get(hm, &next, sizeof(next)));
+    }
+    churn_report(hm, round, dz_bench_now_ns() - start, n);
+  }
+  hm_free(hm);
+  return 0;
+}
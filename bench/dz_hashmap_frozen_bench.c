@@ -0,0 +1,65 @@
+// Frozen hashmap benchmark
+// Builds a DzHashmap of n uint64_t -> uint64_t items, freezes it, and
+// compares lookups in the frozen map against hm_get on the original.
+// Also reports the build time and the size of the perfect hash.
+// Usage: dz_hashmap_frozen_bench [n]
+//  n - number of keys (default 1000000)
+
+#include "dz_bench.h"
+#include "dz_hashmap.h"
+#include "dz_hashmap_frozen.h"
+
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  uint64_t *keys = malloc(n * sizeof(uint64_t));
+  uint64_t seed = 0x5eed;
+  DzHashmap hm = hm_init_with_capacity(n, NULL);
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = dz_bench_rand(&seed);
+    hm_add(hm, &keys[i], sizeof(keys[i]), &keys[i], sizeof(keys[i]),
+           NULL);
+  }
+
+  uint64_t start = dz_bench_now_ns();
+  DzHmFrozen frozen = hm_freeze(hm, NULL);
+  const uint64_t build_ns = dz_bench_now_ns() - start;
+  if (!frozen) {
+    fprintf(stderr, "hm_freeze failed\n");
+    return 1;
+  }
+  printf("freeze: %.2f ms, %.2f bits/key, %zu bytes (%.1f bytes/item)\n",
+         build_ns / 1e6, hm_frozen_bits_per_key(frozen),
+         hm_frozen_size_bytes(frozen),
+         (double)hm_frozen_size_bytes(frozen) / (n ? n : 1));
+
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    dz_bench_escape(hm_get(hm, &keys[i], sizeof(keys[i])));
+  }
+  dz_bench_report("hm_get hit", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    dz_bench_escape(
+        hm_frozen_get(frozen, &keys[i], sizeof(keys[i]), NULL));
+  }
+  dz_bench_report("hm_frozen_get hit", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t missing = keys[i] + 1;
+    dz_bench_escape(hm_get(hm, &missing, sizeof(missing)));
+  }
+  dz_bench_report("hm_get miss", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t missing = keys[i] + 1;
+    dz_bench_escape(
+        hm_frozen_get(frozen, &missing, sizeof(missing), NULL));
+  }
+  dz_bench_report("hm_frozen_get miss", n, n,
+                  dz_bench_now_ns() - start);
+
+  hm_frozen_free(frozen);
+  hm_free(hm);
+  free(keys);
+  return 0;
+}
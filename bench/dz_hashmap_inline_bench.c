@@ -0,0 +1,54 @@
+// Hashmap small item benchmark
+// Fills maps with 8 byte keys and 8 byte values, with and without
+// small item mode, and reports the memory used per entry and the
+// latency of looking keys up in a random order.
+// Usage: dz_hashmap_inline_bench [n...]
+//  n - map sizes to run (default 1000000 10000000)
+
+#include <malloc.h>
+
+#include "dz_bench.h"
+#include "dz_hashmap.h"
+
+static size_t bench_heap_bytes(void) {
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+static void bench_run(const size_t n, const bool inline_small) {
+  const size_t heap_before = bench_heap_bytes();
+  DzHashmap hm = hm_init(NULL);
+  hm_set_inline_small_items(hm, inline_small);
+  uint64_t start = dz_bench_now_ns();
+  for (uint64_t key = 0; key < n; key++) {
+    const uint64_t value = key * 3;
+    hm_add(hm, &key, sizeof(key), &value, sizeof(value), NULL);
+  }
+  const uint64_t add_ns = dz_bench_now_ns() - start;
+  const size_t heap_bytes = bench_heap_bytes() - heap_before;
+  uint64_t seed = 42;
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t key = dz_bench_rand(&seed) % n;
+    dz_bench_escape(hm_get(hm, &key, sizeof(key)));
+  }
+  const uint64_t get_ns = dz_bench_now_ns() - start;
+  const char *mode = inline_small ? "inline" : "slab";
+  printf("%-7s n=%-10zu %7.1f bytes/entry  add %7.2f ns/op  "
+         "get %7.2f ns/op\n",
+         mode, n, (double)heap_bytes / n, (double)add_ns / n,
+         (double)get_ns / n);
+  hm_free(hm);
+}
+
+int main(int argc, char **argv) {
+  const size_t default_sizes[] = {1000000, 10000000};
+  const size_t runs = argc > 1 ? (size_t)argc - 1 : 2;
+  for (size_t i = 0; i < runs; i++) {
+    const size_t n = argc > 1 ? strtoull(argv[i + 1], NULL, 10)
+                              : default_sizes[i];
+    bench_run(n, false);
+    bench_run(n, true);
+  }
+  return 0;
+}
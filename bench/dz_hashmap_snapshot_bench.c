@@ -0,0 +1,76 @@
+// Hashmap snapshot benchmark
+// Compares getting a ready-to-use map at startup by rebuilding it
+// with hm_add, against mapping a snapshot saved with hm_save.
+// Usage: dz_hashmap_snapshot_bench [n] [path]
+//  n    - number of keys (default 1000000)
+//  path - where to write the snapshot (default
+//         /tmp/dz_hashmap_snapshot_bench.snap), removed at the end
+
+#include <unistd.h>
+
+#include "dz_bench.h"
+#include "dz_hashmap_snapshot.h"
+
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  const char *path =
+      argc > 2 ? argv[2] : "/tmp/dz_hashmap_snapshot_bench.snap";
+  char key[32];
+
+  uint64_t start = dz_bench_now_ns();
+  DzHashmap hm = hm_init(NULL);
+  for (size_t i = 0; i < n; i++) {
+    const size_t keysize =
+        (size_t)snprintf(key, sizeof(key), "route:%zu", i) + 1;
+    hm_add(hm, key, keysize, &i, sizeof(i), NULL);
+  }
+  dz_bench_report("rebuild with hm_add", n, n,
+                  dz_bench_now_ns() - start);
+
+  DzHmError error = DzHmError_None;
+  start = dz_bench_now_ns();
+  hm_save(hm, path, &error);
+  dz_bench_report("hm_save", n, n, dz_bench_now_ns() - start);
+  if (hm_has_error(&error)) {
+    printf("hm_save failed: %s\n", hm_error_get_failure_str(error));
+    hm_free(hm);
+    return 1;
+  }
+
+  start = dz_bench_now_ns();
+  DzHmSnapshot snapshot = hm_open_mmap(path, false, &error);
+  dz_bench_report("hm_open_mmap", n, 1, dz_bench_now_ns() - start);
+  hm_snapshot_close(snapshot);
+
+  start = dz_bench_now_ns();
+  snapshot = hm_open_mmap(path, true, &error);
+  dz_bench_report("hm_open_mmap + checksum", n, 1,
+                  dz_bench_now_ns() - start);
+
+  uint64_t seed = 42;
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    const size_t keysize =
+        (size_t)snprintf(key, sizeof(key), "route:%zu",
+                         (size_t)(dz_bench_rand(&seed) % n)) +
+        1;
+    dz_bench_escape(hm_get(hm, key, keysize));
+  }
+  dz_bench_report("hm_get", n, n, dz_bench_now_ns() - start);
+
+  seed = 42;
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    const size_t keysize =
+        (size_t)snprintf(key, sizeof(key), "route:%zu",
+                         (size_t)(dz_bench_rand(&seed) % n)) +
+        1;
+    dz_bench_escape(hm_snapshot_get(snapshot, key, keysize, NULL));
+  }
+  dz_bench_report("hm_snapshot_get", n, n, dz_bench_now_ns() - start);
+
+  hm_snapshot_close(snapshot);
+  hm_free(hm);
+  unlink(path);
+  return 0;
+}
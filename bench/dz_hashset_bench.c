@@ -0,0 +1,85 @@
+// Hashset benchmark
+// Compares DzHashset against the old way of building a set, a
+// DzHashmap storing a placeholder "1" value with every key. Reports
+// time and heap bytes per key, for uint64_t keys.
+// Usage: dz_hashset_bench [n]
+//  n - number of keys (default 1000000)
+
+#include <malloc.h>
+
+#include "dz_bench.h"
+#include "dz_hashmap.h"
+#include "dz_hashset.h"
+
+// Bytes in use from malloc, including blocks big enough to get
+// their own mapping
+static size_t bench_heap_bytes(void) {
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+static void bench_map_as_set(const uint64_t *keys, const size_t n) {
+  const size_t heap = bench_heap_bytes();
+  uint64_t start = dz_bench_now_ns();
+  DzHashmap hm = hm_init(NULL);
+  for (size_t i = 0; i < n; i++) {
+    hm_add(hm, &keys[i], sizeof(keys[i]), "1", 2, NULL);
+  }
+  dz_bench_report("hm_add with \"1\"", n, n, dz_bench_now_ns() - start);
+  printf("  %.1f heap bytes/key\n",
+         (double)(bench_heap_bytes() - heap) / n);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    dz_bench_escape(hm_get(hm, &keys[i], sizeof(keys[i])));
+  }
+  dz_bench_report("hm_get hit", n, n, dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+static void bench_set(const uint64_t *keys, const size_t n) {
+  const size_t heap = bench_heap_bytes();
+  uint64_t start = dz_bench_now_ns();
+  DzHashset set = hs_init(NULL);
+  for (size_t i = 0; i < n; i++) {
+    hs_insert(set, &keys[i], sizeof(keys[i]), NULL);
+  }
+  dz_bench_report("hs_insert", n, n, dz_bench_now_ns() - start);
+  printf("  %.1f heap bytes/key\n",
+         (double)(bench_heap_bytes() - heap) / n);
+  start = dz_bench_now_ns();
+  size_t found = 0;
+  for (size_t i = 0; i < n; i++) {
+    found += hs_contains(set, &keys[i], sizeof(keys[i]));
+  }
+  dz_bench_escape(&found);
+  dz_bench_report("hs_contains hit", n, n, dz_bench_now_ns() - start);
+
+  // Half of the keys again, plus as many new ones
+  DzHashset other = hs_init(NULL);
+  for (size_t i = n / 2; i < n + n / 2; i++) {
+    const uint64_t key = i < n ? keys[i] : keys[i - n] + 1;
+    hs_insert(other, &key, sizeof(key), NULL);
+  }
+  start = dz_bench_now_ns();
+  hs_union(other, set, NULL);
+  dz_bench_report("hs_union", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  hs_intersect(other, set);
+  dz_bench_report("hs_intersect", hs_count(other), hs_count(other),
+                  dz_bench_now_ns() - start);
+  hs_free(other);
+  hs_free(set);
+}
+
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  uint64_t *keys = malloc(n * sizeof(uint64_t));
+  uint64_t seed = 0x5e7;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = dz_bench_rand(&seed) & ~1ull;
+  }
+  bench_map_as_set(keys, n);
+  bench_set(keys, n);
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Typed hashmap benchmark
+// Compares a uint64_t -> uint32_t map made with DZ_HASHMAP_DEFINE
+// against DzHashmap storing the same keys and values as bytes.
+// Usage: dz_typed_hashmap_bench [n]
+//  n - number of keys (default 1000000)
+
+#include "dz_bench.h"
+#include "dz_hashmap.h"
+#include "dz_typed_hashmap.h"
+
+DZ_HASHMAP_DEFINE(BenchU64Map, uint64_t, uint32_t, dz_hash_u64,
+                  dz_eq_scalar)
+
+static uint64_t *bench_keys_create(const size_t n) {
+  uint64_t *keys = malloc(n * sizeof(uint64_t));
+  uint64_t seed = 0x5eed;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = dz_bench_rand(&seed);
+  }
+  return keys;
+}
+
+static void bench_generic(const uint64_t *keys, const size_t n) {
+  uint64_t start = dz_bench_now_ns();
+  DzHashmap hm = hm_init(NULL);
+  for (size_t i = 0; i < n; i++) {
+    const uint32_t value = (uint32_t)i;
+    hm_add(hm, &keys[i], sizeof(keys[i]), &value, sizeof(value),
+           NULL);
+  }
+  dz_bench_report("DzHashmap add", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    dz_bench_escape(hm_get(hm, &keys[i], sizeof(keys[i])));
+  }
+  dz_bench_report("DzHashmap get hit", n, n,
+                  dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t missing = keys[i] + 1;
+    dz_bench_escape(hm_get(hm, &missing, sizeof(missing)));
+  }
+  dz_bench_report("DzHashmap get miss", n, n,
+                  dz_bench_now_ns() - start);
+  hm_free(hm);
+}
+
+static void bench_typed(const uint64_t *keys, const size_t n) {
+  uint64_t start = dz_bench_now_ns();
+  BenchU64Map map = {0};
+  for (size_t i = 0; i < n; i++) {
+    BenchU64Map_put(&map, keys[i], (uint32_t)i);
+  }
+  dz_bench_report("typed add", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    dz_bench_escape(BenchU64Map_get(&map, keys[i]));
+  }
+  dz_bench_report("typed get hit", n, n, dz_bench_now_ns() - start);
+  start = dz_bench_now_ns();
+  for (size_t i = 0; i < n; i++) {
+    dz_bench_escape(BenchU64Map_get(&map, keys[i] + 1));
+  }
+  dz_bench_report("typed get miss", n, n, dz_bench_now_ns() - start);
+  BenchU64Map_free(&map);
+}
+
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  uint64_t *keys = bench_keys_create(n);
+  bench_generic(keys, n);
+  bench_typed(keys, n);
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Pluggable allocators for the containers
+// Usage:
+//  A DZAllocator is a small table of functions, plus a pointer that
+//  is passed back to every one of them. Containers created with an
+//  allocator (dz_arrinit_ex, hm_init_ex, dz_slab_init_ex) get all of
+//  their memory from it, and keep a pointer to it, so the allocator
+//  must outlive them. A NULL allocator means malloc and free.
+//
+//  realloc and free are given the size the block was allocated with,
+//  which allocators that don't track sizes themselves (like arenas)
+//  need. Blocks must be aligned to 16 bytes.
+//
+//  dz_arena_allocator (in dz_arena.h) allocates from a DZArena, so a
+//  container used for a single request can be thrown away along with
+//  the arena, in O(1), without freeing it.
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct DZAllocator {
+  // Returns size bytes, or NULL if memory ran out
+  void *(*alloc)(void *user_data, size_t size);
+  // Grows or shrinks block from old_size to new_size bytes, keeping
+  // its contents. Returns NULL if memory ran out, leaving block as is
+  void *(*realloc)(void *user_data, void *block, size_t old_size,
+                   size_t new_size);
+  void (*free)(void *user_data, void *block, size_t size);
+  void *user_data;
+} DZAllocator;
+
+// malloc, realloc and free, behind the DZAllocator interface. Passing
+// NULL instead does the same, without the indirect calls
+extern const DZAllocator DZ_SYSTEM_ALLOCATOR;
+
+// Implementation Details:
+// Used by the containers, with a NULL allocator going straight to
+// the C library. Zeroed memory comes from calloc when possible, which
+// gets big blocks as fresh zero pages instead of clearing them
+
+static inline void *dz_impl_alloc(const DZAllocator *allocator,
+                                  const size_t size) {
+  return allocator ? allocator->alloc(allocator->user_data, size)
+                   : malloc(size);
+}
+
+static inline void *dz_impl_alloc_zeroed(const DZAllocator *allocator,
+                                         const size_t size) {
+  if (!allocator) {
+    return calloc(1, size);
+  }
+  void *block = allocator->alloc(allocator->user_data, size);
+  if (block) {
+    memset(block, 0, size);
+  }
+  return block;
+}
+
+static inline void *dz_impl_realloc(const DZAllocator *allocator,
+                                    void *block, const size_t old_size,
+                                    const size_t new_size) {
+  return allocator ? allocator->realloc(allocator->user_data, block,
+                                        old_size, new_size)
+                   : realloc(block, new_size);
+}
+
+static inline void dz_impl_free(const DZAllocator *allocator,
+                                void *block, const size_t size) {
+  if (allocator) {
+    allocator->free(allocator->user_data, block, size);
+  } else {
+    free(block);
+  }
+}
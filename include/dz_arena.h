@@ -10,6 +10,8 @@
 
 #include <stdlib.h>
 
+#include "dz_allocator.h"
+
 typedef enum DzArenaError {
   DzArenaError_NONE,
   DzArenaError_MALLOC,  // Could not MALLOC
@@ -46,3 +48,13 @@ extern void dz_arena_clear(DZArena *arena);
 // the allocated memory
 // For safety, it also initializes the bytes to 0
 extern void *dz_arena_alloc(DZArena *arena, size_t n_bytes);
+
+// Allocator that hands out memory from arena, for containers that
+// only live as long as its contents (see dz_allocator.h). Blocks are
+// aligned to 16 bytes. Only the newest block is given back on free,
+// and it grows in place on realloc. Everything else is reclaimed by
+// dz_arena_clear or dz_arena_free, which also invalidate every
+// container using the allocator. Allocations past max_size fail,
+// without putting the arena in an error state.
+// The allocator points to arena, which must stay where it is.
+extern DZAllocator dz_arena_allocator(DZArena *arena);
@@ -7,11 +7,40 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "dz_allocator.h"
 #include "dz_debug.h"
 
-extern const size_t DZ_ARR_RESIZE_UP;
+extern const size_t DZ_ARR_RESIZE_UP;  // Growth of the default policy
 extern const size_t DZ_ARR_INIT_CAPACITY;
 
+// How an array grows and shrinks. Every array has its own, set with
+// dz_arrset_policy, and starts out with DZ_ARR_DEFAULT_POLICY.
+// Shrinking at a lower fill than it shrinks to (shrink_at greater
+// than shrink_by) leaves room on both sides after a shrink, so a
+// stack going back and forth over a boundary doesn't reallocate on
+// every push and pop. Arrays never shrink below DZ_ARR_INIT_CAPACITY.
+typedef struct DZArrayPolicy {
+  float growth_factor;  // Capacity is multiplied by this when full.
+                        // Must be over 1
+  uint8_t shrink_at;    // Shrinks when less than 1/shrink_at of the
+                        // capacity is used. 0 never shrinks
+  uint8_t shrink_by;    // Capacity is divided by this when shrinking.
+                        // At least 2, and at most shrink_at
+} DZArrayPolicy;
+
+// Doubles when full, and halves when less than a quarter is used
+extern const DZArrayPolicy DZ_ARR_DEFAULT_POLICY;
+// Doubles when full, and keeps its memory until freed
+extern const DZArrayPolicy DZ_ARR_NEVER_SHRINK;
+
+// Reallocations of an array since it was created, from dz_arrstats
+typedef struct DZArrayStats {
+  size_t reallocs;       // Times the capacity changed
+  size_t bytes_moved;    // Bytes copied by the reallocations that had
+                         // to move the array
+  size_t failed_allocs;  // Times the allocator was out of memory
+} DZArrayStats;
+
 // Used to define an array.
 // Usage Example:
 //  DZArray(int) array;
@@ -20,30 +49,86 @@ extern const size_t DZ_ARR_INIT_CAPACITY;
 //  dz_arrfree(array)
 #define DZArray(T) T *
 
+// Initializes the NULL array a to get its memory from allocator (see
+// dz_allocator.h) instead of malloc. The allocator must outlive a.
+// When the allocator runs out of memory, a is left as it was: a NULL
+// array stays NULL, and items that did not fit are not added, which
+// dz_arrstats(a).failed_allocs counts
+#define dz_arrinit_ex(a, allocator)                                    \
+  dz_impl_arr_init_ex((void **)(&a), sizeof(*a), DZ_ARR_INIT_CAPACITY, \
+                      allocator)
+
+// Initializes the NULL array a with room for exactly capacity items,
+// instead of DZ_ARR_INIT_CAPACITY. Saves memory on arrays that only
+// ever hold a few items
+#define dz_arrinit_cap(a, capacity) \
+  dz_impl_arr_init_ex((void **)(&a), sizeof(*a), capacity, NULL)
+
+// Makes room for capacity items in total, so that pushing up to that
+// many never reallocates. Never shrinks a. a can be a NULL array
+#define dz_arrreserve(a, capacity) \
+  dz_impl_arr_reserve((void **)(&a), sizeof(*a), capacity)
+
+// Shrinks the capacity of a down to its length
+#define dz_arrshrink_to_fit(a) \
+  ((!a) ? (void)0 : dz_impl_arr_shrink_to_fit((void **)(&a), sizeof(*a)))
+
+// Sets the length of a to length. New items are zeroed. Growing only
+// reallocates when length is over the capacity, and shrinking keeps
+// the capacity. a can be a NULL array
+#define dz_arrresize(a, length) \
+  dz_impl_arr_resize((void **)(&a), sizeof(*a), length)
+
+// Sets the growth and shrink policy of a, a DZArrayPolicy. A NULL
+// array is initialized first
+#define dz_arrset_policy(a, policy) \
+  dz_impl_arr_set_policy((void **)(&a), sizeof(*a), policy)
+
+// Gets the DZArrayStats of a. All zero for a NULL array
+#define dz_arrstats(a) dz_impl_arr_stats((a) ? dz_array_header(a) : NULL)
+
 // Frees the array a
 #define dz_arrfree(a) \
-  ((!a) ? (void)0 : dz_impl_arr_free(dz_array_header(a)))
+  ((!a) ? (void)0 : dz_impl_arr_free(dz_array_header(a), sizeof(*a)))
 
 // Gets the length of the array a
 #define dz_arrlen(a) ((!a) ? 0 : dz_array_header(a)->length)
 
 // Returns the last item in the array, and removes it
-#define dz_arrpop(a)                                        \
-  (DZ_ASSERT(a), DZ_ASSERT(dz_array_header(a)->length),     \
-   dz_impl_arr_maybe_shrink(dz_array_header(a), sizeof(*a), \
-                            (void **)&a),                   \
-   dz_array_header(a)->length--, a[dz_array_header(a)->length])
+#define dz_arrpop(a)                                                       \
+  ({                                                                       \
+    DZ_ASSERT(a);                                                          \
+    DZ_ASSERT(dz_array_header(a)->length);                                 \
+    dz_impl_arr_maybe_shrink(dz_array_header(a), sizeof(*a), (void **)&a); \
+    a[--dz_array_header(a)->length];                                       \
+  })
 
 // Pushes an item into a. a can be a NULL pointer
+// Only calls into the library when a is NULL or full
 #define dz_arrpush(a, item)                                  \
   do {                                                       \
     if (!a) {                                                \
       dz_impl_arr_init((void **)(&a), sizeof(*a));           \
-    } else {                                                 \
+    } else if (dz_array_header(a)->length >=                 \
+               dz_array_header(a)->capacity) {               \
       dz_impl_arr_maybe_grow(dz_array_header(a), sizeof(*a), \
                              (void **)&a);                   \
     }                                                        \
-    a[dz_array_header(a)->length++] = item;                  \
+    if (a && dz_array_header(a)->length <                    \
+                 dz_array_header(a)->capacity) {             \
+      a[dz_array_header(a)->length++] = item;                \
+    }                                                        \
+  } while (0)
+
+// Appends the n items at items to a, with a single copy. items must
+// point to items of the same type as a, and not into a itself. a can
+// be a NULL array
+#define dz_arrpush_n(a, items, n)                                     \
+  do {                                                                \
+    DZ_STATIC_ASSERT(sizeof(*a) == sizeof(*(items)),                  \
+                     "In dz_arrpush_n: The items to push and the "    \
+                     "items in the DzArray must have the same size"); \
+    dz_impl_arr_push_n((void **)(&a), sizeof(*a), items, n);          \
   } while (0)
 
 // Prints the contents of the array
@@ -71,6 +156,34 @@ extern const size_t DZ_ARR_INIT_CAPACITY;
         : dz_impl_arr_remove(dz_array_header(a), index, sizeof(*a), \
                              (void **)&a))
 
+// Removes the n items from index `index` on, and moves the rest of the
+// array down to fill the space up, with a single copy. Shrinks at
+// most once
+// O(n) time
+#define dz_arrremove_range(a, index, n) \
+  ((!a) ? (void)0                       \
+        : dz_impl_arr_remove_range((void **)&a, sizeof(*a), index, n))
+
+// Removes every item of a for which pred(&item) is true, keeping the
+// rest in order. pred can be a function or a macro. Every item kept is
+// copied at most once
+// O(n) time
+#define dz_arrremove_if(a, pred)                                      \
+  do {                                                                \
+    const size_t dz_arr_length_ = dz_arrlen(a);                       \
+    size_t dz_arr_kept_ = 0;                                          \
+    for (size_t dz_arr_i_ = 0; dz_arr_i_ < dz_arr_length_;            \
+         dz_arr_i_++) {                                               \
+      if (!pred(&(a)[dz_arr_i_])) {                                   \
+        (a)[dz_arr_kept_++] = (a)[dz_arr_i_];                         \
+      }                                                               \
+    }                                                                 \
+    if (dz_arr_kept_ < dz_arr_length_) {                              \
+      dz_impl_arr_remove_range((void **)&a, sizeof(*a), dz_arr_kept_, \
+                               dz_arr_length_ - dz_arr_kept_);        \
+    }                                                                 \
+  } while (0)
+
 // Removes the item at index `index` by replacing it with the last
 // element in the array Works in O(1) time, but does not preserve
 // ordering of the array
@@ -81,29 +194,69 @@ extern const size_t DZ_ARR_INIT_CAPACITY;
 
 // Inserts an item into the index `index`, and shift the rest
 // of the array to accomodate
-#define dz_arrinsert(a, index, item)                      \
-  do {                                                    \
-    DZ_ASSERT(a);                                         \
-    dz_impl_arr_shift_at_index(dz_array_header(a), index, \
-                               sizeof(*a), (void **)&a);  \
-    a[index] = item;                                      \
+#define dz_arrinsert(a, index, item)                           \
+  do {                                                         \
+    DZ_ASSERT(a);                                              \
+    if (dz_impl_arr_shift_at_index(dz_array_header(a), index,  \
+                                   sizeof(*a), (void **)&a)) { \
+      a[index] = item;                                         \
+    }                                                          \
   } while (0);
 
+// Inserts the n items at items into a at index `index`, and moves the
+// rest of the array up with a single copy. Grows at most once. items
+// must point to items of the same type as a, and not into a itself.
+// a can be a NULL array when index is 0
+// O(n) time
+#define dz_arrinsert_n(a, index, items, n)                              \
+  do {                                                                  \
+    DZ_STATIC_ASSERT(sizeof(*a) == sizeof(*(items)),                    \
+                     "In dz_arrinsert_n: The items to insert and the "  \
+                     "items in the DzArray must have the same size");   \
+    dz_impl_arr_insert_n((void **)(&a), sizeof(*a), index, items, n);   \
+  } while (0)
+
 // Returns the index of the item stored at item_addr.
 // NOTE: item_addr must be a valid address
-// Uses memcmp under the hood to compare the value stored at
-// item_addr, and the items in the array
+// Compares the value stored at item_addr and the items in the array
+// byte for byte, like memcmp. Items of 1, 2, 4 or 8 bytes are
+// compared many at a time with SIMD instructions
 // If the item is not found, returns -1.
-#define dz_arrindexof(a, item_addr)                                 \
-  (DZ_STATIC_ASSERT(                                                \
-       sizeof(*a) == sizeof(*item_addr),                            \
-       "In dz_addrindexof: The size of the item to find and the "   \
-       "size of the items in the DzArray must match."),             \
-   (!a || !item_addr)                                               \
-       ? -1                                                         \
-       : dz_impl_arr_indexof(dz_array_header(a), (void *)item_addr, \
-                             sizeof(*a), sizeof(*item_addr),        \
-                             (void **)&a))
+#define dz_arrindexof(a, item_addr)                                         \
+  ({                                                                        \
+    DZ_STATIC_ASSERT(sizeof(*a) == sizeof(*item_addr),                      \
+                     "In dz_addrindexof: The size of the item to find and " \
+                     "the size of the items in the DzArray must match.");   \
+    (!a) ? -1                                                               \
+         : dz_impl_arr_indexof(dz_array_header(a), (void *)item_addr,       \
+                               sizeof(*a), sizeof(*item_addr),              \
+                               (void **)&a);                                \
+  })
+
+// Returns whether a holds an item equal to the one at item_addr
+#define dz_arrcontains(a, item_addr) (dz_arrindexof(a, item_addr) != -1)
+
+// Returns how many items of a are equal to the one at item_addr
+#define dz_arrcount(a, item_addr)                                         \
+  ({                                                                      \
+    DZ_STATIC_ASSERT(sizeof(*a) == sizeof(*item_addr),                    \
+                     "In dz_arrcount: The size of the item to count and " \
+                     "the size of the items in the DzArray must match."); \
+    (!a) ? (size_t)0                                                      \
+         : dz_impl_arr_count(dz_array_header(a), (const void *)item_addr, \
+                             sizeof(*a));                                 \
+  })
+
+// Looks each of the n items at items up in a, and writes the index of
+// its first match, or -1, to the n ssize_t at indexes
+#define dz_arrindexof_many(a, items, n, indexes)                        \
+  do {                                                                  \
+    DZ_STATIC_ASSERT(sizeof(*a) == sizeof(*(items)),                    \
+                     "In dz_arrindexof_many: The items to find and the " \
+                     "items in the DzArray must have the same size");   \
+    dz_impl_arr_indexof_many((a) ? dz_array_header(a) : NULL, items,    \
+                             sizeof(*a), n, indexes);                   \
+  } while (0)
 
 #define dz_arrclear(a) \
   (dz_array_header(a)->length = 0)
@@ -113,34 +266,85 @@ extern const size_t DZ_ARR_INIT_CAPACITY;
 // Used to store information about the array
 // The user of the API is given a pointer that points to the
 // first memory location after the structure for data.
-typedef struct DZArrayHeader {
+// Aligned so that the items after it are aligned like malloc's
+typedef struct __attribute__((aligned(16))) DZArrayHeader {
   size_t length;
   size_t capacity;
+  const DZAllocator *allocator;  // NULL for malloc
+  DZArrayPolicy policy;
+  DZArrayStats stats;
 } DZArrayHeader;
 
 #define dz_array_header(a) (&((DZArrayHeader *)a)[-1])
 
 extern void dz_impl_arr_init(void **arr_ref, size_t item_size);
+extern void dz_impl_arr_init_ex(void **arr_ref, size_t item_size,
+                                size_t capacity,
+                                const DZAllocator *allocator);
+extern void dz_impl_arr_reserve(void **arr_ref, size_t element_size,
+                                size_t capacity);
+extern void dz_impl_arr_set_policy(void **arr_ref, size_t element_size,
+                                   DZArrayPolicy policy);
+extern DZArrayStats dz_impl_arr_stats(const DZArrayHeader *header);
+extern void dz_impl_arr_shrink_to_fit(void **arr_ref,
+                                      size_t element_size);
+extern void dz_impl_arr_push_n(void **arr_ref, size_t element_size,
+                               const void *items, size_t n);
+extern void dz_impl_arr_resize(void **arr_ref, size_t element_size,
+                               size_t length);
 extern void dz_impl_arr_maybe_grow(DZArrayHeader *header,
                                    size_t element_size,
                                    void **arr_ptr);
 extern void dz_impl_arr_maybe_shrink(DZArrayHeader *header,
                                      size_t element_size,
                                      void **arr_ptr);
-extern void dz_impl_arr_free(DZArrayHeader *arr);
+extern void dz_impl_arr_free(DZArrayHeader *arr, size_t element_size);
 extern void dz_impl_arr_remove(DZArrayHeader *header,
                                size_t index_to_remove,
                                size_t element_size, void **arr_ptr);
+extern void dz_impl_arr_remove_range(void **arr_ref,
+                                     size_t element_size, size_t index,
+                                     size_t n);
+extern void dz_impl_arr_insert_n(void **arr_ref, size_t element_size,
+                                 size_t index, const void *items,
+                                 size_t n);
 extern void dz_impl_arr_remove_and_replace(DZArrayHeader *header,
                                            size_t index_to_remove,
                                            size_t element_size,
                                            void **arr_ptr);
-extern void dz_impl_arr_shift_at_index(DZArrayHeader *header,
+extern bool dz_impl_arr_shift_at_index(DZArrayHeader *header,
                                        size_t index_to_add,
                                        size_t element_size,
                                        void **arr_ptr);
 extern void dz_impl_arrprint(void *arr, const char *format,
                              size_t element_size);
+extern size_t dz_impl_arr_count(DZArrayHeader *header,
+                                const void *item_to_count,
+                                size_t element_size);
+extern void dz_impl_arr_indexof_many(DZArrayHeader *header,
+                                     const void *items_to_find,
+                                     size_t element_size, size_t n,
+                                     ssize_t *indexes);
+
+// Search kernels, in dz_array_search.c. Return n when nothing matches
+extern size_t dz_impl_arr_find(const void *items, size_t n,
+                               const void *item, size_t width);
+extern size_t dz_impl_arr_count_of(const void *items, size_t n,
+                                   const void *item, size_t width);
+
+// The instructions the search kernels use. The best the CPU supports
+// is picked when the library is loaded. Setting it is only meant for
+// tests and benchmarks, and must not race with a search
+typedef enum DZArraySearchIsa {
+  DZ_ARR_SEARCH_SCALAR,
+  DZ_ARR_SEARCH_SSE2,
+  DZ_ARR_SEARCH_AVX2,
+} DZArraySearchIsa;
+
+// Returns false, changing nothing, if the CPU lacks isa
+extern bool dz_impl_arr_search_set_isa(DZArraySearchIsa isa);
+extern DZArraySearchIsa dz_impl_arr_search_isa(void);
+
 extern ssize_t dz_impl_arr_indexof(DZArrayHeader *header,
                                    void *item_to_find_addr,
                                    size_t array_element_size,
@@ -0,0 +1,250 @@
+#pragma once
+
+// Sorting and binary search for DZArrays
+// Usage:
+//  dz_arrsort sorts with an introsort that is written out in place for
+//  the item type, so the comparison is inlined instead of being called
+//  through a pointer like qsort's. less is a function or a macro that
+//  takes pointers to two items, and returns whether the first goes
+//  before the second:
+//   #define INT_LESS(x, y) (*(x) < *(y))
+//   dz_arrsort(array, INT_LESS);
+//  dz_arrlower_bound and dz_arrbsearch search an array sorted with
+//  the same less.
+//
+//  dz_arrradix_sort sorts arrays of integers, and dz_arrradix_sort_by
+//  arrays of structs by an integer field, a byte of the key at a time.
+//  It takes O(n) time, and a scratch copy of the array from the
+//  allocator of the array. When that can't be allocated, the array is
+//  left unsorted and the radix sorts return false.
+
+#include <stddef.h>
+
+#include "dz_array.h"
+
+// Sorts a in place, so that less(&a[i + 1], &a[i]) is false for every
+// i. Not stable. O(n log n) time in the worst case
+#define dz_arrsort(a, less)                                           \
+  do {                                                                \
+    if (dz_arrlen(a) > 1) {                                           \
+      DZ_IMPL_ARR_INTROSORT(__typeof__(*(a)), a, dz_arrlen(a), less); \
+    }                                                                 \
+  } while (0)
+
+// Returns the index of the first item of the sorted array a that is
+// not less than the one at item_addr, or the length of a if there is
+// none. O(log n) time
+#define dz_arrlower_bound(a, item_addr, less)                      \
+  ({                                                               \
+    const __typeof__(*(a)) *dz_lb_base_ = (a);                     \
+    size_t dz_lb_n_ = dz_arrlen(a);                                \
+    size_t dz_lb_index_ = 0;                                       \
+    if (dz_lb_n_) {                                                \
+      /* Halves the range without branching on the comparison */   \
+      while (dz_lb_n_ > 1) {                                       \
+        const size_t dz_lb_half_ = dz_lb_n_ / 2;                   \
+        dz_lb_base_ = less(&dz_lb_base_[dz_lb_half_], (item_addr)) \
+                          ? dz_lb_base_ + dz_lb_half_              \
+                          : dz_lb_base_;                           \
+        dz_lb_n_ -= dz_lb_half_;                                   \
+      }                                                            \
+      dz_lb_index_ = (size_t)(dz_lb_base_ - (a)) +                 \
+                     (less(dz_lb_base_, (item_addr)) ? 1 : 0);     \
+    }                                                              \
+    dz_lb_index_;                                                  \
+  })
+
+// Returns the index of an item of the sorted array a equal to the one
+// at item_addr (neither is less than the other), or -1 if there is
+// none. O(log n) time
+#define dz_arrbsearch(a, item_addr, less)                              \
+  ({                                                                   \
+    const size_t dz_bs_index_ = dz_arrlower_bound(a, item_addr, less); \
+    (dz_bs_index_ < dz_arrlen(a) &&                                    \
+     !less((item_addr), &(a)[dz_bs_index_]))                           \
+        ? (ssize_t)dz_bs_index_                                        \
+        : (ssize_t)-1;                                                 \
+  })
+
+// Sorts the array of integers a in ascending order. Stable. O(n) time.
+// Returns false, leaving a as it was, if the scratch copy could not be
+// allocated
+#define dz_arrradix_sort(a)                                              \
+  ({                                                                     \
+    DZ_IMPL_ARR_ASSERT_INTEGER(__typeof__(*(a)));                        \
+    dz_impl_arr_radix_sort((void **)&(a), sizeof(*(a)), 0, sizeof(*(a)), \
+                           DZ_IMPL_ARR_IS_SIGNED(__typeof__(*(a))));     \
+  })
+
+// Sorts the array of structs a by their integer field, in ascending
+// order. Stable, so sorting by one field and then by another orders by
+// the second, then by the first. O(n) time. Returns false, leaving a
+// as it was, if the scratch copy could not be allocated
+#define dz_arrradix_sort_by(a, field)                                      \
+  ({                                                                       \
+    DZ_IMPL_ARR_ASSERT_INTEGER(__typeof__((a)->field));                    \
+    dz_impl_arr_radix_sort((void **)&(a), sizeof(*(a)),                    \
+                           offsetof(__typeof__(*(a)), field),              \
+                           sizeof((a)->field),                             \
+                           DZ_IMPL_ARR_IS_SIGNED(__typeof__((a)->field))); \
+  })
+
+// Implementation Details:
+
+// Ranges of at most this many items are insertion sorted
+#define DZ_ARR_SORT_INSERTION_MAX 16
+
+// Fails to compile unless T is an integer type. Radix sorting the bits
+// of a float in integer order would misplace the negative ones
+#define DZ_IMPL_ARR_ASSERT_INTEGER(T) \
+  DZ_STATIC_ASSERT((T)1.5 == 1, "Radix sort keys must be integers")
+
+// Whether the integer type T is signed. Comparing against 1 instead of
+// 0 keeps -Wtype-limits quiet for unsigned types
+#define DZ_IMPL_ARR_IS_SIGNED(T) ((T)-1 < (T)1)
+
+// Swaps the items of type T at x and y
+#define DZ_IMPL_ARR_SWAP(T, x, y) \
+  do {                            \
+    T dz_swap_tmp_ = *(x);        \
+    *(x) = *(y);                  \
+    *(y) = dz_swap_tmp_;          \
+  } while (0)
+
+// Insertion sorts the n items of type T at base
+#define DZ_IMPL_ARR_INSERTION_SORT(T, base, n, less)                         \
+  do {                                                                       \
+    T *const dz_is_base_ = (base);                                           \
+    for (size_t dz_is_i_ = 1; dz_is_i_ < (n); dz_is_i_++) {                  \
+      T dz_is_item_ = dz_is_base_[dz_is_i_];                                 \
+      size_t dz_is_j_ = dz_is_i_;                                            \
+      for (; dz_is_j_ > 0 && less(&dz_is_item_, &dz_is_base_[dz_is_j_ - 1]); \
+           dz_is_j_--) {                                                     \
+        dz_is_base_[dz_is_j_] = dz_is_base_[dz_is_j_ - 1];                   \
+      }                                                                      \
+      dz_is_base_[dz_is_j_] = dz_is_item_;                                   \
+    }                                                                        \
+  } while (0)
+
+// Heapsorts the n items of type T at base. Introsort falls back on it
+// for ranges that partition badly, which bounds the worst case
+#define DZ_IMPL_ARR_HEAPSORT(T, base, n, less)                              \
+  do {                                                                      \
+    T *const dz_hs_base_ = (base);                                          \
+    const size_t dz_hs_n_ = (n);                                            \
+    for (size_t dz_hs_end_ = dz_hs_n_, dz_hs_start_ = dz_hs_n_ / 2;         \
+         dz_hs_end_ > 1;) {                                                 \
+      /* Builds the max heap first, then moves its top to the end */        \
+      size_t dz_hs_root_;                                                   \
+      if (dz_hs_start_ > 0) {                                               \
+        dz_hs_root_ = --dz_hs_start_;                                       \
+      } else {                                                              \
+        dz_hs_end_--;                                                       \
+        DZ_IMPL_ARR_SWAP(T, &dz_hs_base_[0], &dz_hs_base_[dz_hs_end_]);     \
+        dz_hs_root_ = 0;                                                    \
+      }                                                                     \
+      for (size_t dz_hs_child_ = 2 * dz_hs_root_ + 1;                       \
+           dz_hs_child_ < dz_hs_end_;                                       \
+           dz_hs_child_ = 2 * dz_hs_root_ + 1) {                            \
+        if (dz_hs_child_ + 1 < dz_hs_end_ &&                                \
+            less(&dz_hs_base_[dz_hs_child_],                                \
+                 &dz_hs_base_[dz_hs_child_ + 1])) {                         \
+          dz_hs_child_++;                                                   \
+        }                                                                   \
+        if (!less(&dz_hs_base_[dz_hs_root_], &dz_hs_base_[dz_hs_child_])) { \
+          break;                                                            \
+        }                                                                   \
+        DZ_IMPL_ARR_SWAP(T, &dz_hs_base_[dz_hs_root_],                      \
+                         &dz_hs_base_[dz_hs_child_]);                       \
+        dz_hs_root_ = dz_hs_child_;                                         \
+      }                                                                     \
+    }                                                                       \
+  } while (0)
+
+// Quicksort with a median of three pivot, insertion sort for short
+// ranges, and heapsort for ranges that recurse more than 2 log2(n)
+// deep. The larger side of every partition goes on an explicit stack
+// and the smaller one is sorted first, so the stack never holds more
+// than log2(n) ranges
+#define DZ_IMPL_ARR_INTROSORT(T, base, n, less)                         \
+  do {                                                                  \
+    T *const dz_qs_base_ = (base);                                      \
+    struct {                                                            \
+      size_t lo, hi;                                                    \
+      unsigned depth;                                                   \
+    } dz_qs_stack_[64];                                                 \
+    const size_t dz_qs_n_ = (n);                                        \
+    dz_qs_stack_[0].lo = 0;                                             \
+    dz_qs_stack_[0].hi = dz_qs_n_;                                      \
+    dz_qs_stack_[0].depth = 2 * (63 - __builtin_clzll(dz_qs_n_));       \
+    size_t dz_qs_top_ = 1;                                              \
+    while (dz_qs_top_) {                                                \
+      dz_qs_top_--;                                                     \
+      size_t dz_qs_lo_ = dz_qs_stack_[dz_qs_top_].lo;                   \
+      size_t dz_qs_hi_ = dz_qs_stack_[dz_qs_top_].hi;                   \
+      unsigned dz_qs_depth_ = dz_qs_stack_[dz_qs_top_].depth;           \
+      while (dz_qs_hi_ - dz_qs_lo_ > DZ_ARR_SORT_INSERTION_MAX) {       \
+        if (!dz_qs_depth_) {                                            \
+          DZ_IMPL_ARR_HEAPSORT(T, &dz_qs_base_[dz_qs_lo_],              \
+                               dz_qs_hi_ - dz_qs_lo_, less);            \
+          dz_qs_lo_ = dz_qs_hi_;                                        \
+          break;                                                        \
+        }                                                               \
+        dz_qs_depth_--;                                                 \
+        /* Orders the first, middle and last items, which also stops */ \
+        /* both scans below from running off the range */               \
+        T *const dz_qs_first_ = &dz_qs_base_[dz_qs_lo_];                \
+        T *const dz_qs_mid_ =                                           \
+            &dz_qs_base_[dz_qs_lo_ + (dz_qs_hi_ - dz_qs_lo_) / 2];      \
+        T *const dz_qs_last_ = &dz_qs_base_[dz_qs_hi_ - 1];             \
+        if (less(dz_qs_mid_, dz_qs_first_)) {                           \
+          DZ_IMPL_ARR_SWAP(T, dz_qs_mid_, dz_qs_first_);                \
+        }                                                               \
+        if (less(dz_qs_last_, dz_qs_mid_)) {                            \
+          DZ_IMPL_ARR_SWAP(T, dz_qs_last_, dz_qs_mid_);                 \
+          if (less(dz_qs_mid_, dz_qs_first_)) {                         \
+            DZ_IMPL_ARR_SWAP(T, dz_qs_mid_, dz_qs_first_);              \
+          }                                                             \
+        }                                                               \
+        const T dz_qs_pivot_ = *dz_qs_mid_;                             \
+        size_t dz_qs_i_ = dz_qs_lo_;                                    \
+        size_t dz_qs_j_ = dz_qs_hi_ - 1;                                \
+        for (;;) {                                                      \
+          while (less(&dz_qs_base_[dz_qs_i_], &dz_qs_pivot_)) {         \
+            dz_qs_i_++;                                                 \
+          }                                                             \
+          while (less(&dz_qs_pivot_, &dz_qs_base_[dz_qs_j_])) {         \
+            dz_qs_j_--;                                                 \
+          }                                                             \
+          if (dz_qs_i_ >= dz_qs_j_) {                                   \
+            break;                                                      \
+          }                                                             \
+          DZ_IMPL_ARR_SWAP(T, &dz_qs_base_[dz_qs_i_],                   \
+                           &dz_qs_base_[dz_qs_j_]);                     \
+          dz_qs_i_++;                                                   \
+          dz_qs_j_--;                                                   \
+        }                                                               \
+        /* [lo, i) holds no item above the pivot, [i, hi) none below */ \
+        if (dz_qs_i_ - dz_qs_lo_ < dz_qs_hi_ - dz_qs_i_) {              \
+          dz_qs_stack_[dz_qs_top_].lo = dz_qs_i_;                       \
+          dz_qs_stack_[dz_qs_top_].hi = dz_qs_hi_;                      \
+          dz_qs_hi_ = dz_qs_i_;                                         \
+        } else {                                                        \
+          dz_qs_stack_[dz_qs_top_].lo = dz_qs_lo_;                      \
+          dz_qs_stack_[dz_qs_top_].hi = dz_qs_i_;                       \
+          dz_qs_lo_ = dz_qs_i_;                                         \
+        }                                                               \
+        dz_qs_stack_[dz_qs_top_].depth = dz_qs_depth_;                  \
+        dz_qs_top_++;                                                   \
+      }                                                                 \
+      DZ_IMPL_ARR_INSERTION_SORT(T, &dz_qs_base_[dz_qs_lo_],            \
+                                 dz_qs_hi_ - dz_qs_lo_, less);          \
+    }                                                                   \
+  } while (0)
+
+// Sorts the items of *arr_ref by the key_size byte integer at
+// key_offset in every item. key_size must be 1, 2, 4 or 8. Returns
+// false, changing nothing, if the scratch copy could not be allocated
+extern bool dz_impl_arr_radix_sort(void **arr_ref, size_t element_size,
+                                   size_t key_offset, size_t key_size,
+                                   bool key_signed);
@@ -0,0 +1,69 @@
+#pragma once
+
+// Thread safe hashmap, built out of independently locked DzHashmaps
+// Usage:
+//  Keys are spread over shards by the top bits of their hash, and
+//  each shard is a DzHashmap behind its own reader-writer lock.
+//  Lookups only take the read lock, so any number of threads can read
+//  a shard at once, and writers only block the one shard they touch.
+//
+//  Values can change as soon as a lock is dropped, so lookups copy
+//  the value out instead of returning a pointer into the map.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "dz_hashmap.h"
+
+extern const size_t CHM_DEFAULT_SHARD_COUNT;
+typedef struct DzConcurrentHashmapInstance *DzConcurrentHashmap;
+
+// Initializes a concurrent hashmap with shard_count shards, rounded
+// up to a power of two. If shard_count is 0, uses a default of
+// CHM_DEFAULT_SHARD_COUNT. More shards means less contention between
+// writers. Caller must free the hashmap using chm_free
+extern DzConcurrentHashmap chm_init(size_t shard_count,
+                                    DzHmError *error);
+
+// Frees a concurrent hashmap. No other thread may be using it
+extern void chm_free(DzConcurrentHashmap chm);
+
+// Copies the value stored with key into value_out, which can hold
+// value_capacity bytes. Returns the size of the value, or 0 if
+// nothing is stored with key. If the value doesn't fit, nothing is
+// copied, and the returned size tells how much room is needed
+extern size_t chm_get(DzConcurrentHashmap chm, const void *key,
+                      size_t keysize, void *value_out,
+                      size_t value_capacity);
+
+// Version of chm_get for strings. Copies the value into value_out,
+// including the terminator
+extern size_t chm_get_str(DzConcurrentHashmap chm, const char *key,
+                          char *value_out, size_t value_capacity);
+
+// Returns true if a value is stored with key
+extern bool chm_contains(DzConcurrentHashmap chm, const void *key,
+                         size_t keysize);
+
+// Adds a new key-value pair to the hashmap, or overwrites the value
+// of an existing key. The key and value are copied in
+extern void chm_add(DzConcurrentHashmap chm, const void *key,
+                    size_t keysize, const void *value,
+                    size_t valuesize, DzHmError *error);
+
+// A version of chm_add specifically for string keys and values
+extern void chm_add_str(DzConcurrentHashmap chm, const char *key,
+                        const char *value, DzHmError *error);
+
+// Deletes a key-value pair from the hashmap. If nothing is stored
+// with key, this is a no-op
+extern void chm_delete(DzConcurrentHashmap chm, const void *key,
+                       size_t keysize);
+
+// Version of chm_delete for string key-value pairs
+extern void chm_delete_str(DzConcurrentHashmap chm, const char *key);
+
+// Gets the count of items stored in the hashmap. Other threads may
+// change it while the shards are being counted, so it is only exact
+// when no writer is running
+extern size_t chm_count(DzConcurrentHashmap chm);
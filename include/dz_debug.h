@@ -82,11 +82,6 @@ extern bool mem_eq(const void *s1, const void *s2, size_t s1_size, size_t s2_siz
 #define DZ_ASSERT(...) \
   DZ_EXPAND_MACRO(     \
       DZ_INTERNAL_ASSERT_GET_MACRO(__VA_ARGS__)(_, __VA_ARGS__))
-// Asserts a constant condition at compile time 
-// Arguments: 
-//  - Condition: The constant, compile time condition to assert 
-//  - Message: The message to display to the user
-#define DZ_STATIC_ASSERT(cond, msg) ({ static_assert(cond, msg); 0; })
 // Internal macro impl
 #define DZ_INTERNAL_ASSERT_WITH_MSG(type, check, ...) \
   dz_impl_assert_msg(__FILE__, __func__, __LINE__,    \
@@ -101,7 +96,17 @@ extern bool mem_eq(const void *s1, const void *s2, size_t s1_size, size_t s2_siz
       __VA_ARGS__, DZ_INTERNAL_ASSERT_WITH_MSG,      \
       DZ_INTERNAL_ASSERT_NO_MSG))
 #else
-#define DZ_ASSERT(...)
+#define DZ_ASSERT(...) ((void)0)
+#endif
+
+// Asserts a constant condition at compile time 
+// Arguments: 
+//  - Condition: The constant, compile time condition to assert 
+//  - Message: The message to display to the user
+#ifdef __cplusplus
+#define DZ_STATIC_ASSERT(cond, msg) ({ static_assert(cond, msg); 0; })
+#else
+#define DZ_STATIC_ASSERT(cond, msg) ({ _Static_assert(cond, msg); 0; })
 #endif
 
 // Implementation Details
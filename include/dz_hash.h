@@ -0,0 +1,26 @@
+#pragma once
+
+// Fast, keyed 64-bit hashing for arbitrary byte strings.
+// Reads the input a word at a time and folds it with 64x64->128 bit
+// multiplies. The seed keys the hash, so tables that pick a random
+// seed per instance are protected against hash flooding attacks.
+//
+// NOT cryptographically secure: use it for hash tables, not for
+// signatures or MACs.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hashes len bytes starting at data, keyed with seed.
+// data may be unaligned. data may be NULL if len is 0.
+extern uint64_t dz_hash_bytes(const void *data, size_t len,
+                              uint64_t seed);
+
+// Hashes a single 64 bit integer, keyed with seed. Much cheaper than
+// dz_hash_bytes on the same 8 bytes, for maps keyed by integers
+static inline uint64_t dz_hash_u64(const uint64_t key,
+                                   const uint64_t seed) {
+  const __uint128_t r = (__uint128_t)(key ^ seed ^ 0xa0761d6478bd642full) *
+                        0xe7037ed1a0b428dbull;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
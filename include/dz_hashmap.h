@@ -1,19 +1,33 @@
 #pragma once
 
 // Hashmap implementation for strings.
-// Open addressed, double hashed
+// Open addressed, with a flat slot array probed 16 slots at a time
+// through a parallel array of 7 bit hash fingerprints (SSE2 when
+// available, scalar otherwise)
 
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "dz_allocator.h"
+
 extern const size_t HM_INIT_CAPACITY;
+extern const double HM_DEFAULT_MAX_LOAD_FACTOR;
 typedef struct DzHashmapInstance *DzHashmap;
 
+// Hash of a key, as computed by hm_hash. Only meaningful to the
+// hashmap it was computed for, since every hashmap salts its hashes
+typedef uint64_t DzHmHash;
+
 typedef enum DzHmError {
-  DzHmError_None,    // No error
-  DzHmError_Memory,  // Error with memory allocation
+  DzHmError_None,       // No error
+  DzHmError_Memory,     // Error with memory allocation
+  DzHmError_Argument,   // Invalid argument
+  DzHmError_Io,         // Could not read or write a file
+  DzHmError_Format,     // File is not a valid hashmap snapshot
+  DzHmError_Collision,  // Keys share a 64 bit hash, so no perfect
+                        // hash function exists for them
 
   DzHmError_Count
 } DzHmError;
@@ -25,25 +39,102 @@ extern bool hm_has_error(DzHmError *error_ref);
 // Caller must free the hashmap using hm_free
 extern DzHashmap hm_init(DzHmError *error);
 
+// Initializes a Hashmap that can hold capacity items before it
+// needs to resize
+// Caller must free the hashmap using hm_free
+extern DzHashmap hm_init_with_capacity(size_t capacity,
+                                       DzHmError *error);
+
+// Version of hm_init_with_capacity that gets all of its memory (the
+// table, the key and value bytes, and the hashmap itself) from
+// allocator, instead of malloc. See dz_allocator.h. The allocator must
+// outlive the hashmap. A NULL allocator means malloc
+extern DzHashmap hm_init_ex(size_t capacity,
+                            const DZAllocator *allocator,
+                            DzHmError *error);
+
 // Frees a hashmap
 extern void hm_free(DzHashmap hm);
 
 // Get the value of the hashmap stored with key. If nothing is found,
 // returns NULL
+// The returned pointer stays valid until key is overwritten or
+// deleted. In small item mode, see hm_set_inline_small_items
 extern const void *hm_get(DzHashmap hm, const void *key, const size_t keysize);
 
+// Version of hm_get that also stores the size of the value in
+// valuesize, if the key is found
+extern const void *hm_get_with_size(DzHashmap hm, const void *key,
+                                    size_t keysize, size_t *valuesize);
+
 // Version of hm_get for strings 
 // Assumes that key value pairs are strings
 extern const char *hm_get_str(DzHashmap hm, const char *key);
 
+// Hashes key the way hm does. Hashing a key that is used over and
+// over once, and passing the hash to the _prehashed functions, skips
+// rehashing it on every call
+extern DzHmHash hm_hash(DzHashmap hm, const void *key, size_t keysize);
+
+// Version of hm_hash for strings. Hashes the terminator too, like the
+// other _str functions
+extern DzHmHash hm_hash_str(DzHashmap hm, const char *key);
+
+// Version of hm_get that takes the hash of key from hm_hash
+extern const void *hm_get_prehashed(DzHashmap hm, const void *key,
+                                    size_t keysize, DzHmHash hash);
+
+// Gets the hashmap's own copy of key, or NULL if key isn't found.
+// The returned pointer stays valid until key is deleted, or like
+// hm_get in small item mode
+extern const void *hm_get_key_prehashed(DzHashmap hm, const void *key,
+                                        size_t keysize, DzHmHash hash);
+
+// Looks up n keys at once, and stores the value of keys[i] (or NULL)
+// in out_values[i]. Same results as calling hm_get in a loop, but the
+// keys are processed in small batches that overlap their memory
+// accesses, which is much faster on tables bigger than the cache.
+extern void hm_get_many(DzHashmap hm, const void *const keys[],
+                        const size_t keysizes[], size_t n,
+                        const void *out_values[]);
+
+// Version of hm_get_many for strings
+extern void hm_get_many_str(DzHashmap hm, const char *const keys[],
+                            size_t n, const char *out_values[]);
+
 // Adds a new key-value pair to the hashmap. The key and value are
-// copied in, so memory management is not needed
+// copied in, so memory management is not needed. Keys and values
+// can each be up to 2 GB
 extern void hm_add(DzHashmap hm, const void *key, size_t keysize, const void *value, size_t valuesize,
             DzHmError *error);
 
 // A version of hm_add specifically for string keys and values
 extern void hm_add_str(DzHashmap hm, const char *key, const char *value, DzHmError *error);
 
+// Version of hm_add that takes the hash of key from hm_hash
+extern void hm_add_prehashed(DzHashmap hm, const void *key,
+                             size_t keysize, DzHmHash hash,
+                             const void *value, size_t valuesize,
+                             DzHmError *error);
+
+// Gets a writable pointer to the value of key, adding key with a
+// zeroed value of valuesize bytes first if it isn't there. Sets
+// inserted (unless NULL) to whether key was added. Hashes and probes
+// once, so counting loops can do ++*(uint64_t *)hm_get_or_insert(...)
+// instead of hm_get followed by hm_add. If key is already there, its
+// value is returned as is, whatever its size. Returns NULL on failure.
+// The pointer is valid for as long as one returned by hm_get
+extern void *hm_get_or_insert(DzHashmap hm, const void *key,
+                              size_t keysize, size_t valuesize,
+                              bool *inserted, DzHmError *error);
+
+// Overwrites the value of key, if key is in the hashmap. A value of
+// the same size is copied over the old one in place, without
+// allocating. Returns false if key isn't in the hashmap, or on failure
+extern bool hm_update(DzHashmap hm, const void *key, size_t keysize,
+                      const void *value, size_t valuesize,
+                      DzHmError *error);
+
 // Deletes a a key-value pair from the hashmap based on a key value.
 // If a corresponding value is not stored, then this is a no-op
 extern void hm_delete(DzHashmap hm, const void *key, size_t keysize);
@@ -51,5 +142,129 @@ extern void hm_delete(DzHashmap hm, const void *key, size_t keysize);
 // Version of hm_delete for string key-value pairs
 extern void hm_delete_str(DzHashmap hm, const char *key);
 
+// Version of hm_delete that takes the hash of key from hm_hash
+extern void hm_delete_prehashed(DzHashmap hm, const void *key,
+                                size_t keysize, DzHmHash hash);
+
 // Gets the count of items stored in the hashmap
 extern size_t hm_count(DzHashmap hm);
+
+// Makes sure the hashmap can hold n items without resizing.
+// The table grows geometrically on its own, so this is only needed
+// to avoid the intermediate resizes when the final size is known.
+extern void hm_reserve(DzHashmap hm, size_t n, DzHmError *error);
+
+// Sets the fraction of slots that can be used before the table
+// grows. Must be between 0 and 1 (exclusive). Lower values use more
+// memory for shorter probes. Defaults to HM_DEFAULT_MAX_LOAD_FACTOR
+extern void hm_set_max_load_factor(DzHashmap hm,
+                                   double max_load_factor,
+                                   DzHmError *error);
+
+// Gets the max load factor of the hashmap
+extern double hm_get_max_load_factor(DzHashmap hm);
+
+// Turns small item mode on or off (off by default).
+// When on, items whose key and value add up to 16 bytes or less
+// (such as an 8 byte key and an 8 byte ID) are stored inside the
+// table instead of in a separate block. This saves memory and a
+// cache miss on every lookup of a small item, but the item moves
+// whenever the table does. So pointers returned by hm_get
+// for small items are only valid until the next hm_add, hm_delete,
+// hm_reserve or hm_set_max_load_factor, or any call at all while an
+// incremental resize is in progress.
+// Only changes how items added from now on are stored
+extern void hm_set_inline_small_items(DzHashmap hm, bool inline_small);
+
+// Turns incremental resizing on or off (off by default).
+// When on, growing the table doesn't move every item at once. The
+// old table is kept alongside the new one, and every later hm_get,
+// hm_add and hm_delete moves a few of its items over. This caps the
+// work of any single operation, at the cost of checking both tables
+// while a resize is in progress. Tombstones left by hm_delete are
+// dropped the same way, by moving into a new table of the same size.
+// hm_reserve still resizes at once.
+extern void hm_set_incremental_resize(DzHashmap hm,
+                                      bool incremental);
+
+// Iteration
+// Usage:
+//  DzHmIter it = hm_iter_begin(hm);
+//  while (hm_iter_next(&it)) {
+//    use(it.key, it.keysize, it.value, it.valuesize);
+//  }
+// Visits every item once, in table order, by scanning the slots
+// front to back and skipping 16 unused slots at a time. The hashmap
+// must not be changed until the iteration is over, but it can still
+// be read.
+typedef struct DzHmIter {
+  DzHashmap hm;
+  size_t index;  // Next slot to look at
+  // The current item, set by hm_iter_next
+  const void *key;
+  size_t keysize;
+  const void *value;
+  size_t valuesize;
+} DzHmIter;
+
+// Starts an iteration over hm. Finishes any incremental resize in
+// progress, so that every item is in the one table
+extern DzHmIter hm_iter_begin(DzHashmap hm);
+
+// Moves it to the next item. Returns false once every item has been
+// visited
+extern bool hm_iter_next(DzHmIter *it);
+
+// A key or value exported by hm_export. Points into the hashmap, and
+// stays valid for as long as a pointer returned by hm_get
+typedef struct DzHmSpan {
+  const void *data;
+  size_t size;
+} DzHmSpan;
+
+// Appends every key of hm to the DZArray(DzHmSpan) *keys_arr, and the
+// matching value to *values_arr, so keys_arr[i] goes with
+// values_arr[i]. Either can be NULL to skip it, and the arrays can
+// start out as NULL arrays. Each array is grown once, before the
+// single pass over the table. Returns the number of items exported
+extern size_t hm_export(DzHashmap hm, DzHmSpan **keys_arr,
+                        DzHmSpan **values_arr);
+
+// Buckets of DzHmStats.probe_histogram
+#define HM_STATS_PROBE_BUCKETS 8
+
+// Snapshot of the state of a hashmap, filled in by hm_stats.
+// Probe lengths are in groups of 16 slots: an item found in the first
+// group its key hashes to has a probe length of 1.
+typedef struct DzHmStats {
+  size_t capacity;    // Slots in the table (both tables while an
+                      // incremental resize is in progress)
+  size_t count;       // Live items
+  size_t tombstones;  // Slots marked DELETED
+  double load_factor;  // (count + tombstones) / capacity
+  double avg_probe_length;
+  size_t max_probe_length;
+  // Items by probe length: probe_histogram[i] counts the items with
+  // a probe length of i + 1. The last bucket also counts the longer
+  // ones
+  size_t probe_histogram[HM_STATS_PROBE_BUCKETS];
+  size_t resize_count;   // Times the table was moved to a new size
+  size_t rehash_count;   // Times tombstones were dropped without
+                         // growing the table
+  uint64_t rehash_ns;    // Time spent in both. Incremental resizes
+                         // only count the allocation of the new table
+  size_t key_bytes;       // Total size of the keys
+  size_t value_bytes;     // Total size of the values
+  size_t metadata_bytes;  // Control bytes, slots and the map itself
+  // Operation counters, only recorded when the library is built with
+  // DZ_HM_COUNTERS (CMake option DZ_HASHMAP_COUNTERS). Zero otherwise.
+  // Cheap enough to leave on: a few increments per operation.
+  bool counters_enabled;
+  uint64_t finds;        // Key searches done by get, add and delete
+  uint64_t find_hits;    // Searches that found their key
+  uint64_t find_groups;  // Groups visited by all searches
+} DzHmStats;
+
+// Fills out with the statistics of hm. Walks the whole table, so it
+// takes time proportional to its capacity
+extern void hm_stats(DzHashmap hm, DzHmStats *out);
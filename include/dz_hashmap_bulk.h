@@ -0,0 +1,34 @@
+#pragma once
+
+// Parallel bulk loading of a DzHashmap from arrays of keys and values
+// Usage:
+//  hm_build_bulk builds a normal DzHashmap out of n key/value pairs at
+//  once, using several threads. The keys are hashed in parallel, split
+//  into partitions by the table group they hash to, and each thread
+//  fills the groups of its own partitions of a table that is already
+//  big enough for every item, so no locks are taken and the table
+//  never resizes. The few items whose probe sequence runs past the end
+//  of their partition are added afterwards, on the calling thread.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "dz_hashmap.h"
+
+// Builds a hashmap holding keys[i] -> values[i] for every i below n,
+// with keys[i] keysizes[i] bytes long, and values[i] valuesizes[i]
+// bytes long. A NULL values[i] is stored as valuesizes[i] zero bytes,
+// and values itself can be NULL to zero-fill every value.
+// When a key is given more than once, the last value wins, as if the
+// pairs were added with hm_add in order. Keys and values are copied in.
+// Uses nthreads threads, including the calling one. If nthreads is 0,
+// uses one per core. Small inputs use fewer threads.
+// Returns NULL on failure, with error set to DzHmError_Argument if a
+// pair would be rejected by hm_add: a NULL key, a keysize of 0, or a
+// key or value over the size limit of the slots (INT32_MAX bytes).
+// Caller must free the hashmap using hm_free
+extern DzHashmap hm_build_bulk(const void *const keys[],
+                               const size_t keysizes[],
+                               const void *const values[],
+                               const size_t valuesizes[], size_t n,
+                               size_t nthreads, DzHmError *error);
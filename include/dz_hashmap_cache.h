@@ -0,0 +1,84 @@
+#pragma once
+
+// Bounded cache built on DzHashmap
+// Usage:
+//  A DzHmCache holds at most max_entries items, or max_bytes bytes of
+//  keys and values, or both. Adding an item past the limit evicts
+//  others with the CLOCK policy: a hand sweeps the table, and evicts
+//  the first item that hasn't been read since the last sweep. The
+//  "read since" bit lives in the hashmap slot itself, so there is no
+//  list to maintain, and a hit costs the same as hm_get.
+//
+//  Eviction is O(1) amortized: each slot passed over has its bit
+//  cleared, so the hand never goes round more than twice.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dz_hashmap.h"
+
+typedef struct DzHmCacheInstance *DzHmCache;
+
+// Called for every item evicted to make room, just before it's
+// removed. Not called for hm_cache_delete, overwrites or hm_cache_free
+typedef void (*DzHmCacheEvictFn)(const void *key, size_t keysize,
+                                 const void *value, size_t valuesize,
+                                 void *user);
+
+typedef struct DzHmCacheStats {
+  size_t count;  // Items in the cache
+  size_t bytes;  // Bytes of keys and values in the cache
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  double hit_rate;  // hits / (hits + misses), or 0 before any get
+} DzHmCacheStats;
+
+// Initializes a cache that holds at most max_entries items and
+// max_bytes bytes of keys and values. 0 means no limit, but at least
+// one limit must be set.
+// Caller must free the cache using hm_cache_free
+extern DzHmCache hm_cache_init(size_t max_entries, size_t max_bytes,
+                               DzHmError *error);
+
+// Frees a cache, without calling the eviction callback
+extern void hm_cache_free(DzHmCache cache);
+
+// Sets the function called on evictions, and the user pointer passed
+// to it. NULL turns it off
+extern void hm_cache_set_evict_callback(DzHmCache cache,
+                                        DzHmCacheEvictFn evict,
+                                        void *user);
+
+// Gets the value stored with key and marks it as recently used, or
+// returns NULL on a miss. Also stores the size of the value in
+// valuesize on a hit, unless it is NULL.
+// The returned pointer stays valid until the next hm_cache_put or
+// hm_cache_delete
+extern const void *hm_cache_get(DzHmCache cache, const void *key,
+                                size_t keysize, size_t *valuesize);
+
+// Version of hm_cache_get for strings
+extern const char *hm_cache_get_str(DzHmCache cache, const char *key);
+
+// Adds key and value to the cache, or overwrites the value of key,
+// evicting other items if the cache would go over its limits.
+// Fails with DzHmError_Argument if the item alone is over max_bytes
+extern void hm_cache_put(DzHmCache cache, const void *key,
+                         size_t keysize, const void *value,
+                         size_t valuesize, DzHmError *error);
+
+// Version of hm_cache_put for strings
+extern void hm_cache_put_str(DzHmCache cache, const char *key,
+                             const char *value, DzHmError *error);
+
+// Removes key from the cache. No-op if it isn't there
+extern void hm_cache_delete(DzHmCache cache, const void *key,
+                            size_t keysize);
+
+// Gets the count of items in the cache
+extern size_t hm_cache_count(DzHmCache cache);
+
+// Fills out with the counters of the cache
+extern void hm_cache_stats(DzHmCache cache, DzHmCacheStats *out);
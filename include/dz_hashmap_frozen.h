@@ -0,0 +1,50 @@
+#pragma once
+
+// Frozen hashmaps, for tables that are built once and then only read
+// Usage:
+//  hm_freeze copies every item of a DzHashmap into an immutable map,
+//  indexed by a minimal perfect hash function: every key of the map
+//  hashes to its own slot, and there are exactly as many slots as
+//  keys. A lookup reads one small "pilot" number, computes the slot,
+//  and compares the key stored there, with no probing at all.
+//  The whole map is a single allocation.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "dz_hashmap.h"
+
+typedef struct DzHmFrozenInstance *DzHmFrozen;
+
+// Builds a frozen copy of hm. hm is not changed, and can be freed
+// afterwards. Returns NULL on failure, with error set to
+// DzHmError_Collision if some keys still had the same 64 bit hash
+// after every salt tried.
+// The build cost per key grows with the size of the map, as the last
+// keys placed search a nearly full table: about 600 ns per key at 250K
+// keys, and 1 us at 8M.
+// Caller must free the frozen map using hm_frozen_free
+extern DzHmFrozen hm_freeze(DzHashmap hm, DzHmError *error);
+
+// Frees a frozen map
+extern void hm_frozen_free(DzHmFrozen frozen);
+
+// Get the value stored with key, or NULL if nothing is found. Also
+// stores the size of the value in valuesize, unless it is NULL.
+// The returned pointer stays valid until the frozen map is freed
+extern const void *hm_frozen_get(DzHmFrozen frozen, const void *key,
+                                 size_t keysize, size_t *valuesize);
+
+// Version of hm_frozen_get for strings
+extern const char *hm_frozen_get_str(DzHmFrozen frozen,
+                                     const char *key);
+
+// Gets the count of items stored in the frozen map
+extern size_t hm_frozen_count(DzHmFrozen frozen);
+
+// Gets the size of the frozen map's allocation, in bytes
+extern size_t hm_frozen_size_bytes(DzHmFrozen frozen);
+
+// Gets the size of the perfect hash function alone (the pilots), in
+// bits per key
+extern double hm_frozen_bits_per_key(DzHmFrozen frozen);
@@ -0,0 +1,114 @@
+#pragma once
+
+// Control byte groups and probing, shared by the hashmap types
+// Internal header: tables built on it are a flat array of slots plus
+// a parallel array of one byte control values. A control byte is
+// EMPTY, DELETED, or the low 7 bits of the hash (H2) of the key in
+// that slot with the top bit set. Tables are probed HM_GROUP_WIDTH
+// control bytes at a time, and must have a power of two multiple of
+// HM_GROUP_WIDTH slots, with the control bytes aligned to 16 bytes.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dz_debug.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define HM_GROUP_WIDTH 16
+
+static const int8_t HM_CTRL_EMPTY = 0x00;
+static const int8_t HM_CTRL_DELETED = 0x01;
+
+// Group matching
+// Each function returns a bitmask with bit i set if control byte i
+// of the group matches
+
+#if defined(__SSE2__)
+
+static inline uint32_t hm_group_match(const int8_t *group,
+                                      const int8_t h2) {
+  const __m128i ctrl = _mm_load_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+}
+
+// Full slots are the only control bytes with the top bit set
+static inline uint32_t hm_group_match_empty_or_deleted(
+    const int8_t *group) {
+  const __m128i ctrl = _mm_load_si128((const __m128i *)group);
+  return ~(uint32_t)_mm_movemask_epi8(ctrl) & 0xFFFF;
+}
+
+#else
+
+static inline uint32_t hm_group_match(const int8_t *group,
+                                      const int8_t h2) {
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < HM_GROUP_WIDTH; i++) {
+    mask |= (uint32_t)(group[i] == h2) << i;
+  }
+  return mask;
+}
+
+static inline uint32_t hm_group_match_empty_or_deleted(
+    const int8_t *group) {
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < HM_GROUP_WIDTH; i++) {
+    mask |= (uint32_t)(group[i] >= 0) << i;
+  }
+  return mask;
+}
+
+#endif
+
+static inline uint32_t hm_group_match_empty(const int8_t *group) {
+  return hm_group_match(group, HM_CTRL_EMPTY);
+}
+
+static inline uint32_t hm_group_match_full(const int8_t *group) {
+  return ~hm_group_match_empty_or_deleted(group) &
+         ((1u << HM_GROUP_WIDTH) - 1);
+}
+
+static inline size_t hm_mask_first(const uint32_t mask) {
+  DZ_ASSERT(mask);
+  return (size_t)__builtin_ctz(mask);
+}
+
+// Fingerprints and probing
+
+static inline int8_t hm_hash_h2(const uint64_t hash) {
+  return (int8_t)(0x80 | (hash & 0x7F));
+}
+
+static inline bool hm_ctrl_is_full(const int8_t ctrl) {
+  return ctrl < 0;
+}
+
+// Position in the probe sequence. Groups are visited with a
+// triangular stride, which visits every group exactly once when
+// the number of groups is a power of two.
+typedef struct DzHmProbe {
+  size_t group;
+  size_t stride;
+  size_t group_mask;
+} DzHmProbe;
+
+static inline DzHmProbe hm_internal_probe_start(
+    const uint64_t hash, const size_t capacity) {
+  const size_t group_mask = capacity / HM_GROUP_WIDTH - 1;
+  DzHmProbe probe;
+  probe.group = (size_t)(hash >> 7) & group_mask;
+  probe.stride = 0;
+  probe.group_mask = group_mask;
+  return probe;
+}
+
+static inline void hm_internal_probe_next(DzHmProbe *probe) {
+  probe->stride++;
+  probe->group = (probe->group + probe->stride) & probe->group_mask;
+}
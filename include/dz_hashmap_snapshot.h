@@ -0,0 +1,54 @@
+#pragma once
+
+// Read-only hashmap snapshots that are memory mapped instead of loaded
+// Usage:
+//  hm_save writes a DzHashmap to a file, as a ready-to-probe table
+//  that holds offsets instead of pointers. hm_open_mmap maps that file
+//  and looks keys up directly in the mapped pages, so opening takes
+//  the same time for any size of file, and every process that maps
+//  the same file shares one copy of it in the page cache.
+//
+//  Files are written in the byte order of the machine, and can only
+//  be opened on machines with the same byte order.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "dz_hashmap.h"
+
+// Version of the file format written by hm_save
+extern const uint32_t HM_SNAPSHOT_VERSION;
+typedef struct DzHmSnapshotInstance *DzHmSnapshot;
+
+// Writes every item of hm to the file at path, replacing it. The file
+// is written under a temporary name next to path and renamed over it
+// once complete, so snapshots of path that are open keep reading the
+// old file, and path never holds a partial one
+extern void hm_save(DzHashmap hm, const char *path, DzHmError *error);
+
+// Maps the snapshot at path. The header is always checked. If
+// verify_checksum is set, every byte of the file is read once to check
+// its checksum, which costs time proportional to the file size.
+// Without it, a damaged file can make lookups read out of bounds, so
+// only skip it for files this machine wrote itself.
+// Returns NULL on failure. Must be closed using hm_snapshot_close
+extern DzHmSnapshot hm_open_mmap(const char *path, bool verify_checksum,
+                                 DzHmError *error);
+
+// Unmaps a snapshot
+extern void hm_snapshot_close(DzHmSnapshot snapshot);
+
+// Get the value stored with key, or NULL if nothing is found. Also
+// stores the size of the value in valuesize, unless it is NULL.
+// The returned pointer points into the mapped file, and stays valid
+// until the snapshot is closed
+extern const void *hm_snapshot_get(DzHmSnapshot snapshot,
+                                   const void *key, size_t keysize,
+                                   size_t *valuesize);
+
+// Version of hm_snapshot_get for strings
+extern const char *hm_snapshot_get_str(DzHmSnapshot snapshot,
+                                       const char *key);
+
+// Gets the count of items stored in the snapshot
+extern size_t hm_snapshot_count(DzHmSnapshot snapshot);
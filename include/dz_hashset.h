@@ -0,0 +1,62 @@
+#pragma once
+
+// Hash set of byte string keys
+// Usage:
+//  Same table and probing as DzHashmap, but items are keys only: no
+//  value is stored or allocated. Keys of 16 bytes or less are stored
+//  in the table itself, so sets of integers or short IDs don't
+//  allocate per key at all.
+//
+//  hs_union and hs_intersect walk the slots of a table in order,
+//  instead of looking every key up through the public API.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "dz_hashmap.h"
+
+typedef struct DzHashsetInstance *DzHashset;
+
+// Initializes a set
+// Caller must free the set using hs_free
+extern DzHashset hs_init(DzHmError *error);
+
+// Initializes a set that can hold capacity keys before it needs to
+// resize
+// Caller must free the set using hs_free
+extern DzHashset hs_init_with_capacity(size_t capacity,
+                                       DzHmError *error);
+
+// Frees a set
+extern void hs_free(DzHashset set);
+
+// Adds key to the set. Returns true if it was added, false if it was
+// already there or on failure
+extern bool hs_insert(DzHashset set, const void *key, size_t keysize,
+                      DzHmError *error);
+
+// Version of hs_insert for strings
+extern bool hs_insert_str(DzHashset set, const char *key,
+                          DzHmError *error);
+
+// Returns true if key is in the set
+extern bool hs_contains(DzHashset set, const void *key,
+                        size_t keysize);
+
+// Version of hs_contains for strings
+extern bool hs_contains_str(DzHashset set, const char *key);
+
+// Removes key from the set. Returns true if it was there
+extern bool hs_remove(DzHashset set, const void *key, size_t keysize);
+
+// Version of hs_remove for strings
+extern bool hs_remove_str(DzHashset set, const char *key);
+
+// Gets the count of keys in the set
+extern size_t hs_count(DzHashset set);
+
+// Adds every key of other to set
+extern void hs_union(DzHashset set, DzHashset other, DzHmError *error);
+
+// Removes every key of set that isn't in other
+extern void hs_intersect(DzHashset set, DzHashset other);
@@ -0,0 +1,35 @@
+#pragma once
+
+// String interning, built on DzHashmap
+// Usage:
+//  dz_intern returns the interner's own copy of a string. Interning
+//  equal strings always returns the same pointer, so interned strings
+//  can be compared with == instead of strcmp, and every repeat of a
+//  string shares one copy of its bytes.
+//  Interned strings stay valid until the interner is freed.
+
+#include <stdlib.h>
+
+#include "dz_hashmap.h"
+
+typedef struct DZInterner {
+  DzHashmap strings;  // Keys are the interned strings
+} DZInterner;
+
+// Initializes an interner. Must be freed using dz_interner_free
+extern DZInterner dz_interner_init(DzHmError *error);
+
+// Frees the interner, and every string interned in it
+extern void dz_interner_free(DZInterner *interner);
+
+// Returns the interned copy of str, interning it if needed.
+// Returns NULL if memory could not be allocated
+extern const char *dz_intern(DZInterner *interner, const char *str,
+                             DzHmError *error);
+
+// Returns the interned copy of str, or NULL if it was never interned
+extern const char *dz_intern_find(DZInterner *interner,
+                                  const char *str);
+
+// Gets the number of distinct strings interned
+extern size_t dz_interner_count(DZInterner *interner);
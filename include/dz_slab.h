@@ -0,0 +1,69 @@
+#pragma once
+
+// Slab allocator implementation
+// Usage:
+//  Allocate blocks with dz_slab_alloc, and give them back with
+//  dz_slab_dealloc, passing the same size. Blocks are carved out of
+//  big chunks, and freed blocks are kept on a free list per size
+//  class, so a slab that has warmed up does not call malloc or free
+//  at all. dz_slab_free releases every block at once.
+//
+//  Blocks bigger than DZ_SLAB_MAX_BLOCK_SIZE are allocated one by
+//  one, but are still tracked by the slab and released with it.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "dz_allocator.h"
+
+#define DZ_SLAB_CLASS_COUNT 20
+
+typedef struct DZSlabChunk DZSlabChunk;
+typedef struct DZSlabLargeBlock DZSlabLargeBlock;
+typedef struct DZSlabFreeBlock DZSlabFreeBlock;
+
+typedef struct DZSlab {
+  size_t chunk_size;
+  DZSlabChunk *chunks;  // Every chunk, newest first
+  char *cursor;         // Next unused byte of the newest chunk
+  size_t remaining;     // Unused bytes left after cursor
+  DZSlabLargeBlock *large_blocks;
+  DZSlabFreeBlock *free_lists[DZ_SLAB_CLASS_COUNT];
+  const DZAllocator *allocator;  // Of chunks and large blocks
+} DZSlab;
+
+extern const size_t DZ_SLAB_DEFAULT_CHUNK_SIZE;  // 64 KB
+extern const size_t DZ_SLAB_MAX_BLOCK_SIZE;      // 4 KB
+
+// Initializes a slab. If chunk_size is 0, uses a default of
+// DZ_SLAB_DEFAULT_CHUNK_SIZE. Must be freed using dz_slab_free
+extern DZSlab dz_slab_init(size_t chunk_size);
+
+// Version of dz_slab_init that gets chunks and large blocks from
+// allocator (see dz_allocator.h) instead of malloc. NULL means malloc
+extern DZSlab dz_slab_init_ex(size_t chunk_size,
+                              const DZAllocator *allocator);
+
+// Frees ALL memory inside the slab
+extern void dz_slab_free(DZSlab *slab);
+
+// Allocates n_bytes bytes inside the slab, and returns a pointer to
+// the allocated memory, aligned to 16 bytes. The memory is NOT
+// zeroed. Returns NULL if memory could not be allocated.
+extern void *dz_slab_alloc(DZSlab *slab, size_t n_bytes);
+
+// Gives a block back to the slab. n_bytes must be the size the block
+// was allocated with
+extern void dz_slab_dealloc(DZSlab *slab, void *block,
+                            size_t n_bytes);
+
+// Moves every block of src, allocated or free, into dst, and leaves
+// src empty. Both must use the same allocator. Blocks allocated from
+// src are given back to dst from then on. Lets threads fill private
+// slabs that end up in one owner
+extern void dz_slab_merge(DZSlab *dst, DZSlab *src);
+
+// Returns true if blocks of size a and size b are interchangeable,
+// meaning a block allocated with one size can be used to hold the
+// other
+extern bool dz_slab_same_class(size_t a, size_t b);
@@ -0,0 +1,235 @@
+#pragma once
+
+// Typed hashmaps for fixed size keys and values, generated by macro
+// Keys and values are stored inline in the table, and the hash and
+// compare functions are known at compile time, so they get inlined
+// into the probe loop. Uses the same control byte groups as DzHashmap.
+//
+// Usage Example:
+//  DZ_HASHMAP_DEFINE(U64Map, uint64_t, uint32_t, dz_hash_u64,
+//                    dz_eq_scalar)
+//
+//  U64Map map = {0};  // A zeroed map is an empty map
+//  U64Map_put(&map, 42, 7);
+//  uint32_t *value = U64Map_get(&map, 42);
+//  U64Map_free(&map);
+//
+// hashfn is called as hashfn(key, seed) and must return a uint64_t.
+// eqfn is called as eqfn(a, b) and must return true for equal keys.
+// Both can be functions or function-like macros.
+//
+// Generates, for a map called name:
+//  name_init(m, n)    - Initializes m to hold n items without resizing
+//  name_free(m)       - Frees the memory of m, leaving it empty
+//  name_get(m, key)   - Pointer to the value of key, or NULL. Stays
+//                       valid until the next put or delete
+//  name_contains(m, key)
+//  name_put(m, key, value) - Adds or overwrites key. Returns false if
+//                            memory could not be allocated
+//  name_delete(m, key) - Returns true if key was removed
+//  name_count(m)
+//  name_reserve(m, n)  - Makes sure m holds n items without resizing
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dz_hash.h"
+#include "dz_hashmap_group.h"
+
+// Equality for keys that can be compared with ==
+#define dz_eq_scalar(a, b) ((a) == (b))
+
+// Equality for NUL terminated string keys
+#define dz_eq_str(a, b) (strcmp((a), (b)) == 0)
+
+// Hash for NUL terminated string keys
+static inline uint64_t dz_hash_str(const char *key,
+                                   const uint64_t seed) {
+  return dz_hash_bytes(key, strlen(key), seed);
+}
+
+// Number of used slots (items and tombstones) at which a table of
+// capacity slots must grow: 7/8 of it, leaving an EMPTY slot
+static inline size_t dz_impl_thm_growth_limit(const size_t capacity) {
+  return capacity - capacity / 8;
+}
+
+// Smallest table capacity that holds n items
+static inline size_t dz_impl_thm_capacity_for(const size_t n) {
+  size_t capacity = HM_GROUP_WIDTH;
+  while (dz_impl_thm_growth_limit(capacity) <= n) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+#define DZ_HASHMAP_DEFINE(name, KeyT, ValT, hashfn, eqfn)              \
+  typedef struct name {                                                \
+    int8_t *ctrl; /* capacity control bytes, then keys, then values */ \
+    KeyT *keys;                                                        \
+    ValT *values;                                                      \
+    size_t capacity;                                                   \
+    size_t count;                                                      \
+    size_t tombstones;                                                 \
+    size_t growth_limit;                                               \
+    uint64_t seed;                                                     \
+  } name;                                                              \
+                                                                       \
+  static inline size_t name##_find(const name *m, KeyT key,            \
+                                   const uint64_t hash) {              \
+    const int8_t h2 = hm_hash_h2(hash);                                \
+    DzHmProbe probe = hm_internal_probe_start(hash, m->capacity);      \
+    while (true) {                                                     \
+      const size_t base = probe.group * HM_GROUP_WIDTH;                \
+      const int8_t *group = &m->ctrl[base];                            \
+      for (uint32_t mask = hm_group_match(group, h2); mask;            \
+           mask &= mask - 1) {                                         \
+        const size_t index = base + hm_mask_first(mask);               \
+        if (eqfn(m->keys[index], key)) {                               \
+          return index;                                                \
+        }                                                              \
+      }                                                                \
+      if (hm_group_match_empty(group)) {                               \
+        return m->capacity;                                            \
+      }                                                                \
+      hm_internal_probe_next(&probe);                                  \
+    }                                                                  \
+  }                                                                    \
+                                                                       \
+  static inline size_t name##_find_free(const name *m,                 \
+                                        const uint64_t hash) {         \
+    DzHmProbe probe = hm_internal_probe_start(hash, m->capacity);      \
+    while (true) {                                                     \
+      const size_t base = probe.group * HM_GROUP_WIDTH;                \
+      const uint32_t mask =                                            \
+          hm_group_match_empty_or_deleted(&m->ctrl[base]);             \
+      if (mask) {                                                      \
+        return base + hm_mask_first(mask);                             \
+      }                                                                \
+      hm_internal_probe_next(&probe);                                  \
+    }                                                                  \
+  }                                                                    \
+                                                                       \
+  /* Moves every item into a fresh table of capacity slots, dropping   \
+     the tombstones */                                                 \
+  static inline bool name##_resize(name *m, const size_t capacity) {   \
+    DZ_ASSERT(capacity % HM_GROUP_WIDTH == 0);                         \
+    char *block = (char *)calloc(                                      \
+        1, capacity * (1 + sizeof(KeyT) + sizeof(ValT)));              \
+    if (!block) {                                                      \
+      return false;                                                    \
+    }                                                                  \
+    name next;                                                         \
+    next.ctrl = (int8_t *)block;                                       \
+    next.keys = (KeyT *)(block + capacity);                            \
+    next.values = (ValT *)(block + capacity * (1 + sizeof(KeyT)));     \
+    next.capacity = capacity;                                          \
+    next.count = m->count;                                             \
+    next.tombstones = 0;                                               \
+    next.growth_limit = dz_impl_thm_growth_limit(capacity);            \
+    next.seed = m->seed;                                               \
+    if (!m->ctrl) {                                                    \
+      arc4random_buf(&next.seed, sizeof(next.seed));                   \
+    }                                                                  \
+    for (size_t i = 0; i < m->capacity; i++) {                         \
+      if (!hm_ctrl_is_full(m->ctrl[i])) {                              \
+        continue;                                                      \
+      }                                                                \
+      const uint64_t hash = hashfn(m->keys[i], next.seed);             \
+      const size_t index = name##_find_free(&next, hash);              \
+      next.ctrl[index] = hm_hash_h2(hash);                             \
+      next.keys[index] = m->keys[i];                                   \
+      next.values[index] = m->values[i];                               \
+    }                                                                  \
+    free(m->ctrl);                                                     \
+    *m = next;                                                         \
+    return true;                                                       \
+  }                                                                    \
+                                                                       \
+  static inline bool name##_reserve(name *m, const size_t n) {         \
+    const size_t capacity = dz_impl_thm_capacity_for(n);               \
+    if (capacity <= m->capacity) {                                     \
+      return true;                                                     \
+    }                                                                  \
+    return name##_resize(m, capacity);                                 \
+  }                                                                    \
+                                                                       \
+  static inline bool name##_init(name *m, const size_t n) {            \
+    memset(m, 0, sizeof(*m));                                          \
+    return name##_resize(m, dz_impl_thm_capacity_for(n));              \
+  }                                                                    \
+                                                                       \
+  static inline void name##_free(name *m) {                            \
+    free(m->ctrl);                                                     \
+    memset(m, 0, sizeof(*m));                                          \
+  }                                                                    \
+                                                                       \
+  static inline size_t name##_count(const name *m) {                   \
+    return m->count;                                                   \
+  }                                                                    \
+                                                                       \
+  static inline ValT *name##_get(const name *m, KeyT key) {            \
+    if (!m->count) {                                                   \
+      return NULL;                                                     \
+    }                                                                  \
+    const size_t index = name##_find(m, key, hashfn(key, m->seed));    \
+    return index == m->capacity ? NULL : &m->values[index];            \
+  }                                                                    \
+                                                                       \
+  static inline bool name##_contains(const name *m, KeyT key) {        \
+    return name##_get(m, key) != NULL;                                 \
+  }                                                                    \
+                                                                       \
+  static inline bool name##_put(name *m, KeyT key,                     \
+                                ValT value) {                          \
+    if (m->ctrl) {                                                     \
+      const size_t index = name##_find(m, key, hashfn(key, m->seed));  \
+      if (index != m->capacity) {                                      \
+        m->values[index] = value;                                      \
+        return true;                                                   \
+      }                                                                \
+    }                                                                  \
+    if (m->count + m->tombstones >= m->growth_limit) {                 \
+      /* Mostly tombstones: rehash at the same size to drop them */    \
+      const size_t capacity =                                          \
+          (m->count * 4 <= m->growth_limit * 3 && m->capacity)         \
+              ? m->capacity                                            \
+              : dz_impl_thm_capacity_for(m->count + 1);                \
+      if (!name##_resize(m, capacity)) {                               \
+        return false;                                                  \
+      }                                                                \
+    }                                                                  \
+    const uint64_t hash = hashfn(key, m->seed);                        \
+    const size_t index = name##_find_free(m, hash);                    \
+    if (m->ctrl[index] == HM_CTRL_DELETED) {                           \
+      m->tombstones--;                                                 \
+    }                                                                  \
+    m->ctrl[index] = hm_hash_h2(hash);                                 \
+    m->keys[index] = key;                                              \
+    m->values[index] = value;                                          \
+    m->count++;                                                        \
+    return true;                                                       \
+  }                                                                    \
+                                                                       \
+  static inline bool name##_delete(name *m, KeyT key) {                \
+    if (!m->count) {                                                   \
+      return false;                                                    \
+    }                                                                  \
+    const size_t index = name##_find(m, key, hashfn(key, m->seed));    \
+    if (index == m->capacity) {                                        \
+      return false;                                                    \
+    }                                                                  \
+    /* Same as hm_delete: no probe went past a group with an EMPTY     \
+       slot, so the slot can be emptied without a tombstone */         \
+    const size_t group = index - index % HM_GROUP_WIDTH;               \
+    if (hm_group_match_empty(&m->ctrl[group])) {                       \
+      m->ctrl[index] = HM_CTRL_EMPTY;                                  \
+    } else {                                                           \
+      m->ctrl[index] = HM_CTRL_DELETED;                                \
+      m->tombstones++;                                                 \
+    }                                                                  \
+    m->count--;                                                        \
+    return true;                                                       \
+  }
@@ -0,0 +1,28 @@
+#include "dz_allocator.h"
+
+static void *dz_system_alloc(void *user_data, const size_t size) {
+  (void)user_data;
+  return malloc(size);
+}
+
+static void *dz_system_realloc(void *user_data, void *block,
+                               const size_t old_size,
+                               const size_t new_size) {
+  (void)user_data;
+  (void)old_size;
+  return realloc(block, new_size);
+}
+
+static void dz_system_free(void *user_data, void *block,
+                           const size_t size) {
+  (void)user_data;
+  (void)size;
+  free(block);
+}
+
+const DZAllocator DZ_SYSTEM_ALLOCATOR = {
+    .alloc = dz_system_alloc,
+    .realloc = dz_system_realloc,
+    .free = dz_system_free,
+    .user_data = NULL,
+};
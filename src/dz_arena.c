@@ -7,6 +7,9 @@
 
 const size_t DZ_ARENA_DEFAULT_MAX_SIZE = 1000000;  // 1MB
 
+// Alignment of the blocks of dz_arena_allocator
+#define DZ_ARENA_ALIGN 16
+
 DZArena dz_arena_init(const size_t max_size) {
   size_t size_to_allocate =
       (max_size == 0) ? DZ_ARENA_DEFAULT_MAX_SIZE : max_size;
@@ -61,3 +64,66 @@ void *dz_arena_alloc(DZArena *arena, const size_t n_bytes) {
   memset(address, 0, n_bytes);
   return address;
 }
+
+// Allocations of dz_arena_allocator don't need zeroing, and must be
+// aligned
+static void *dz_arena_allocator_alloc(void *user_data,
+                                      const size_t size) {
+  DZArena *arena = (DZArena *)user_data;
+  const size_t start = (arena->first_empty_byte + DZ_ARENA_ALIGN - 1) &
+                       ~(size_t)(DZ_ARENA_ALIGN - 1);
+  if (arena->error || start > arena->max_size ||
+      size > arena->max_size - start) {
+    return NULL;
+  }
+  arena->first_empty_byte = start + size;
+  return arena->data + start;
+}
+
+// Whether block is the newest allocation of arena, size bytes long
+static bool dz_arena_is_newest(const DZArena *arena, const void *block,
+                               const size_t size) {
+  return (const char *)block + size ==
+         arena->data + arena->first_empty_byte;
+}
+
+static void *dz_arena_allocator_realloc(void *user_data, void *block,
+                                        const size_t old_size,
+                                        const size_t new_size) {
+  DZArena *arena = (DZArena *)user_data;
+  if (!block) {
+    return dz_arena_allocator_alloc(arena, new_size);
+  }
+  if (dz_arena_is_newest(arena, block, old_size)) {
+    const size_t start = (size_t)((char *)block - arena->data);
+    if (new_size > arena->max_size - start) {
+      return NULL;
+    }
+    arena->first_empty_byte = start + new_size;
+    return block;
+  }
+  void *moved = dz_arena_allocator_alloc(arena, new_size);
+  if (moved) {
+    memcpy(moved, block, min(old_size, new_size));
+  }
+  return moved;
+}
+
+static void dz_arena_allocator_free(void *user_data, void *block,
+                                    const size_t size) {
+  DZArena *arena = (DZArena *)user_data;
+  if (block && dz_arena_is_newest(arena, block, size)) {
+    arena->first_empty_byte = (size_t)((char *)block - arena->data);
+  }
+}
+
+DZAllocator dz_arena_allocator(DZArena *arena) {
+  DZ_ASSERT(arena);
+  DZAllocator allocator = {
+      .alloc = dz_arena_allocator_alloc,
+      .realloc = dz_arena_allocator_realloc,
+      .free = dz_arena_allocator_free,
+      .user_data = arena,
+  };
+  return allocator;
+}
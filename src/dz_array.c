@@ -5,9 +5,19 @@
 #include <string.h>
 
 const size_t DZ_ARR_RESIZE_UP = 2;
-const size_t DZ_ARR_RESIZE_DOWN = 2;
 const size_t DZ_ARR_INIT_CAPACITY = 50;
 
+const DZArrayPolicy DZ_ARR_DEFAULT_POLICY = {
+    .growth_factor = 2.0f,
+    .shrink_at = 4,
+    .shrink_by = 2,
+};
+const DZArrayPolicy DZ_ARR_NEVER_SHRINK = {
+    .growth_factor = 2.0f,
+    .shrink_at = 0,
+    .shrink_by = 2,
+};
+
 static inline size_t imax(size_t a, size_t b) {
   return (a > b) ? a : b;
 }
@@ -22,51 +32,199 @@ static inline uint8_t *dz_arr_get_ptr_from_header(
   return (uint8_t *)&header[1];
 }
 
+// Bytes of the allocation of an array of capacity items
+static inline size_t dz_arr_alloc_size(size_t element_size,
+                                       size_t capacity) {
+  return sizeof(DZArrayHeader) + element_size * capacity;
+}
+
 void dz_impl_arr_init(void **arr_ref, size_t item_size) {
+  dz_impl_arr_init_ex(arr_ref, item_size, DZ_ARR_INIT_CAPACITY, NULL);
+}
+
+void dz_impl_arr_init_ex(void **arr_ref, size_t item_size,
+                         size_t capacity, const DZAllocator *allocator) {
   dz_assert(arr_ref != NULL);
   dz_assert(*arr_ref == NULL);  // Should initialize a null array
-  DZArrayHeader *header = (DZArrayHeader *)malloc(
-      sizeof(DZArrayHeader) + item_size * DZ_ARR_INIT_CAPACITY);
-  header->capacity = DZ_ARR_INIT_CAPACITY;
+  DZArrayHeader *header = (DZArrayHeader *)dz_impl_alloc(
+      allocator, dz_arr_alloc_size(item_size, capacity));
+  if (!header) {
+    return;  // *arr_ref stays NULL
+  }
+  header->capacity = capacity;
   header->length = 0;
+  header->allocator = allocator;
+  header->policy = DZ_ARR_DEFAULT_POLICY;
+  header->stats = (DZArrayStats){0};
   *arr_ref = dz_arr_get_ptr_from_header(header);
 }
 
-static void dz_arr_resize(DZArrayHeader *header, size_t element_size,
+// Returns false, leaving the array as it was, if the allocator is out
+// of memory
+static bool dz_arr_resize(DZArrayHeader *header, size_t element_size,
                           void **arr_ptr, size_t new_capacity) {
-  header->capacity = new_capacity;
-  DZArrayHeader *new_header = (DZArrayHeader *)realloc(
-      header, sizeof(DZArrayHeader) + new_capacity * element_size);
+  const size_t old_size =
+      dz_arr_alloc_size(element_size, header->capacity);
+  const size_t new_size = dz_arr_alloc_size(element_size, new_capacity);
+  const uintptr_t old_address = (uintptr_t)header;
+  DZArrayHeader *new_header = (DZArrayHeader *)dz_impl_realloc(
+      header->allocator, header, old_size, new_size);
+  if (!new_header) {
+    header->stats.failed_allocs++;
+    return false;
+  }
+  new_header->capacity = new_capacity;
+  new_header->stats.reallocs++;
+  if ((uintptr_t)new_header != old_address) {
+    new_header->stats.bytes_moved +=
+        old_size < new_size ? old_size : new_size;
+  }
   *arr_ptr = dz_arr_get_ptr_from_header(new_header);
+  return true;
+}
+
+// Makes room for capacity items in total, so that pushing up to
+// capacity items never reallocates. *arr_ref can be a NULL array
+void dz_impl_arr_reserve(void **arr_ref, size_t element_size,
+                         size_t capacity) {
+  dz_assert(arr_ref != NULL);
+  if (!*arr_ref) {
+    dz_impl_arr_init_ex(arr_ref, element_size, capacity, NULL);
+    return;
+  }
+  DZArrayHeader *header = dz_array_header(*arr_ref);
+  if (capacity > header->capacity) {
+    dz_arr_resize(header, element_size, arr_ref, capacity);
+  }
+}
+
+// Grows by the growth factor of the array, but always to at least
+// needed items, which also gets arrays with a capacity of 0 going.
+// Returns false if there is no room for needed items
+static bool dz_arr_grow_to(void **arr_ref, size_t element_size,
+                           size_t needed) {
+  DZArrayHeader *header = dz_array_header(*arr_ref);
+  if (needed <= header->capacity) {
+    return true;
+  }
+  const size_t grown =
+      (size_t)(header->capacity * header->policy.growth_factor);
+  return dz_arr_resize(header, element_size, arr_ref,
+                       imax(grown, needed));
+}
+
+void dz_impl_arr_set_policy(void **arr_ref, size_t element_size,
+                            DZArrayPolicy policy) {
+  dz_assert(arr_ref != NULL);
+  DZ_ASSERT(policy.growth_factor > 1, "Arrays must grow when full");
+  // Shrinking to less than the length would drop items
+  DZ_ASSERT(!policy.shrink_at ||
+                (policy.shrink_by >= 2 &&
+                 policy.shrink_at >= policy.shrink_by),
+            "Arrays must not shrink below their length");
+  if (!*arr_ref) {
+    dz_impl_arr_init(arr_ref, element_size);
+  }
+  if (*arr_ref) {
+    dz_array_header(*arr_ref)->policy = policy;
+  }
+}
+
+DZArrayStats dz_impl_arr_stats(const DZArrayHeader *header) {
+  if (!header) {
+    const DZArrayStats none = {0, 0, 0};
+    return none;
+  }
+  return header->stats;
 }
 
 void dz_impl_arr_maybe_grow(DZArrayHeader *header,
                             size_t element_size, void **arr_ptr) {
   if (header->length >= header->capacity) {
-    const size_t new_capacity = header->capacity * DZ_ARR_RESIZE_UP;
-    dz_arr_resize(header, element_size, arr_ptr, new_capacity);
+    dz_arr_grow_to(arr_ptr, element_size, header->length + 1);
+  }
+}
+
+void dz_impl_arr_shrink_to_fit(void **arr_ref, size_t element_size) {
+  DZArrayHeader *header = dz_array_header(*arr_ref);
+  if (header->capacity > header->length) {
+    dz_arr_resize(header, element_size, arr_ref, header->length);
+  }
+}
+
+void dz_impl_arr_push_n(void **arr_ref, size_t element_size,
+                        const void *items, size_t n) {
+  dz_assert(arr_ref != NULL);
+  if (!*arr_ref) {
+    dz_impl_arr_init_ex(arr_ref, element_size,
+                        imax(n, DZ_ARR_INIT_CAPACITY), NULL);
   }
+  if (!*arr_ref || !dz_arr_grow_to(arr_ref, element_size,
+                                   dz_array_header(*arr_ref)->length +
+                                       n)) {
+    return;
+  }
+  DZArrayHeader *header = dz_array_header(*arr_ref);
+  if (n) {
+    memcpy(dz_arr_get_ptr_from_header(header) +
+               header->length * element_size,
+           items, n * element_size);
+  }
+  header->length += n;
+}
+
+void dz_impl_arr_resize(void **arr_ref, size_t element_size,
+                        size_t length) {
+  dz_assert(arr_ref != NULL);
+  if (!*arr_ref) {
+    dz_impl_arr_init_ex(arr_ref, element_size,
+                        imax(length, DZ_ARR_INIT_CAPACITY), NULL);
+  }
+  if (!*arr_ref) {
+    return;
+  }
+  DZArrayHeader *header = dz_array_header(*arr_ref);
+  if (length > header->length) {
+    if (!dz_arr_grow_to(arr_ref, element_size, length)) {
+      return;
+    }
+    header = dz_array_header(*arr_ref);
+    memset(dz_arr_get_ptr_from_header(header) +
+               header->length * element_size,
+           0, (length - header->length) * element_size);
+  }
+  header->length = length;
 }
 
 void dz_impl_arr_maybe_shrink(DZArrayHeader *header,
                               size_t element_size, void **arr_ptr) {
-  size_t shrunk_capacity = imax(header->capacity / DZ_ARR_RESIZE_DOWN,
-                                DZ_ARR_INIT_CAPACITY);
-  if (header->length < shrunk_capacity &&
-      header->capacity > DZ_ARR_INIT_CAPACITY) {
-    dz_arr_resize(header, element_size, arr_ptr, shrunk_capacity);
+  const DZArrayPolicy policy = header->policy;
+  if (!policy.shrink_at || header->capacity <= DZ_ARR_INIT_CAPACITY ||
+      header->length >= header->capacity / policy.shrink_at) {
+    return;
   }
+  const size_t shrunk_capacity = imax(
+      header->capacity / policy.shrink_by, DZ_ARR_INIT_CAPACITY);
+  dz_arr_resize(header, element_size, arr_ptr, shrunk_capacity);
 }
 
 void dz_impl_arr_remove(DZArrayHeader *header, size_t index_to_remove,
                         size_t element_size, void **arr_ptr) {
-  uint8_t *array_bytes = (uint8_t *)*arr_ptr;
-  for (size_t i = index_to_remove; i < header->length; i++) {
-    memmove(&array_bytes[i * element_size],
-            &array_bytes[(i + 1) * element_size], element_size);
-  }
-  header->length--;
-  dz_impl_arr_maybe_shrink(header, element_size, arr_ptr);
+  dz_assert(dz_array_header(*arr_ptr) == header);
+  dz_impl_arr_remove_range(arr_ptr, element_size, index_to_remove, 1);
+}
+
+void dz_impl_arr_remove_range(void **arr_ref, size_t element_size,
+                              size_t index, size_t n) {
+  DZArrayHeader *header = dz_array_header(*arr_ref);
+  DZ_ASSERT(n <= header->length && index <= header->length - n,
+            "Removing past the end of the array");
+  uint8_t *array_bytes = (uint8_t *)*arr_ref;
+  memmove(&array_bytes[index * element_size],
+          &array_bytes[(index + n) * element_size],
+          (header->length - index - n) * element_size);
+  header->length -= n;
+  dz_impl_arr_maybe_shrink(header, element_size, arr_ref);
 }
 
 void dz_impl_arr_remove_and_replace(DZArrayHeader *header,
@@ -79,37 +237,91 @@ void dz_impl_arr_remove_and_replace(DZArrayHeader *header,
          &array_bytes[header->length * element_size], element_size);
 }
 
-void dz_impl_arr_shift_at_index(DZArrayHeader *header,
+// Moves the items from index on n places up, growing at most once, and
+// adds n to the length. Leaves the n items from index as they were.
+// Returns false, changing nothing, if the array could not grow
+static bool dz_arr_open_gap(void **arr_ref, size_t element_size,
+                            size_t index, size_t n) {
+  const size_t length = dz_array_header(*arr_ref)->length;
+  DZ_ASSERT(index <= length, "Inserting past the end of the array");
+  if (!dz_arr_grow_to(arr_ref, element_size, length + n)) {
+    return false;
+  }
+  uint8_t *array_bytes = (uint8_t *)*arr_ref;
+  memmove(&array_bytes[(index + n) * element_size],
+          &array_bytes[index * element_size],
+          (length - index) * element_size);
+  dz_array_header(*arr_ref)->length = length + n;
+  return true;
+}
+
+bool dz_impl_arr_shift_at_index(DZArrayHeader *header,
                                 size_t index_to_add,
                                 size_t element_size, void **arr_ptr) {
   dz_assert(*arr_ptr);
-  dz_assert(index_to_add <= header->length);
-  header->length++;
-  dz_impl_arr_maybe_grow(header, element_size, arr_ptr);
-  uint8_t *array_bytes = (uint8_t *)*arr_ptr;
-  for (size_t i = header->length - 1; i > index_to_add; i--) {
-    memmove(&array_bytes[i * element_size],
-            &array_bytes[(i - 1) * element_size], element_size);
+  dz_assert(dz_array_header(*arr_ptr) == header);
+  return dz_arr_open_gap(arr_ptr, element_size, index_to_add, 1);
+}
+
+void dz_impl_arr_insert_n(void **arr_ref, size_t element_size,
+                          size_t index, const void *items, size_t n) {
+  dz_assert(arr_ref != NULL);
+  if (!*arr_ref) {
+    dz_impl_arr_init_ex(arr_ref, element_size,
+                        imax(n, DZ_ARR_INIT_CAPACITY), NULL);
+  }
+  if (!*arr_ref || !dz_arr_open_gap(arr_ref, element_size, index, n)) {
+    return;
+  }
+  if (n) {
+    memcpy((uint8_t *)*arr_ref + index * element_size, items,
+           n * element_size);
   }
 }
 
-void dz_impl_arr_free(DZArrayHeader *arr) {
+void dz_impl_arr_free(DZArrayHeader *arr, size_t element_size) {
   dz_assert(arr);
-  free(arr);
+  dz_impl_free(arr->allocator, arr,
+               dz_arr_alloc_size(element_size, arr->capacity));
 }
 
 ssize_t dz_impl_arr_indexof(DZArrayHeader *header, void *item_to_find,
                             size_t array_element_size,
                             size_t item_to_find_size,
                             void **arr_ptr) {
-  uint8_t *array_bytes = (uint8_t *)*arr_ptr;
-  for (size_t i = 0; i < header->length; i++) {
-    const int cmp =
-        memcmp(item_to_find, &array_bytes[i * array_element_size],
-               array_element_size);
-    if (cmp == 0) {
-      return i;
-    }
+  if (!item_to_find) {
+    return -1;
+  }
+  const size_t index = dz_impl_arr_find(
+      *arr_ptr, header->length, item_to_find, array_element_size);
+  return index == header->length ? -1 : (ssize_t)index;
+}
+
+size_t dz_impl_arr_count(DZArrayHeader *header,
+                         const void *item_to_count,
+                         size_t element_size) {
+  if (!item_to_count) {
+    return 0;
+  }
+  return dz_impl_arr_count_of(dz_arr_get_ptr_from_header(header),
+                              header->length, item_to_count,
+                              element_size);
+}
+
+void dz_impl_arr_indexof_many(DZArrayHeader *header,
+                              const void *items_to_find,
+                              size_t element_size, size_t n,
+                              ssize_t *indexes) {
+  DZ_ASSERT(!n || (items_to_find && indexes),
+            "Caller must supply the items and room for the indexes");
+  const uint8_t *items = (const uint8_t *)items_to_find;
+  const size_t length = header ? header->length : 0;
+  for (size_t i = 0; i < n; i++) {
+    const size_t index =
+        length ? dz_impl_arr_find(dz_arr_get_ptr_from_header(header),
+                                  length, &items[i * element_size],
+                                  element_size)
+               : 0;
+    indexes[i] = index == length ? -1 : (ssize_t)index;
   }
-  return -1;
 }
@@ -0,0 +1,404 @@
+#include <string.h>
+
+#include "dz_array.h"
+
+// Linear search kernels
+// Items of 1, 2, 4 or 8 bytes are compared a vector at a time: the
+// needle is copied into every lane, compared with a whole vector of
+// items at once, and the byte mask of the result gives the matching
+// lanes. Lanes are compared bit for bit, like memcmp, so floats match
+// when their bits do. Other sizes go through memcmp, one item at a
+// time. The kernels are picked when the library is loaded, from what
+// the CPU supports.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DZ_ARR_SEARCH_X86
+#include <immintrin.h>
+#endif
+
+#define DZ_ARR_ALWAYS_INLINE static inline __attribute__((always_inline))
+
+typedef size_t (*DzArrFind)(const uint8_t *items, size_t n,
+                            const void *item, size_t width);
+typedef size_t (*DzArrCount)(const uint8_t *items, size_t n,
+                             const void *item, size_t width);
+
+// Scalar
+
+DZ_ARR_ALWAYS_INLINE size_t dz_arr_find_from(const uint8_t *items,
+                                             size_t start, size_t n,
+                                             const void *item,
+                                             size_t width) {
+  for (size_t i = start; i < n; i++) {
+    if (!memcmp(&items[i * width], item, width)) {
+      return i;
+    }
+  }
+  return n;
+}
+
+DZ_ARR_ALWAYS_INLINE size_t dz_arr_count_from(const uint8_t *items,
+                                              size_t start, size_t n,
+                                              const void *item,
+                                              size_t width) {
+  size_t count = 0;
+  for (size_t i = start; i < n; i++) {
+    count += !memcmp(&items[i * width], item, width);
+  }
+  return count;
+}
+
+// Calls kernel with width as a constant for the sizes with a vector
+// path, so that every one of them gets its own specialized loop
+#define DZ_ARR_DISPATCH_WIDTH(kernel, items, n, item, width) \
+  switch (width) {                                           \
+    case 1:                                                  \
+      return kernel(items, n, item, 1);                      \
+    case 2:                                                  \
+      return kernel(items, n, item, 2);                      \
+    case 4:                                                  \
+      return kernel(items, n, item, 4);                      \
+    case 8:                                                  \
+      return kernel(items, n, item, 8);                      \
+    default:                                                 \
+      return kernel(items, n, item, width);                  \
+  }
+
+DZ_ARR_ALWAYS_INLINE size_t dz_arr_find_scalar_w(const uint8_t *items,
+                                                 size_t n,
+                                                 const void *item,
+                                                 size_t width) {
+  return dz_arr_find_from(items, 0, n, item, width);
+}
+
+DZ_ARR_ALWAYS_INLINE size_t dz_arr_count_scalar_w(const uint8_t *items,
+                                                  size_t n,
+                                                  const void *item,
+                                                  size_t width) {
+  return dz_arr_count_from(items, 0, n, item, width);
+}
+
+static size_t dz_arr_find_scalar(const uint8_t *items, size_t n,
+                                 const void *item, size_t width) {
+  DZ_ARR_DISPATCH_WIDTH(dz_arr_find_scalar_w, items, n, item, width);
+}
+
+static size_t dz_arr_count_scalar(const uint8_t *items, size_t n,
+                                  const void *item, size_t width) {
+  DZ_ARR_DISPATCH_WIDTH(dz_arr_count_scalar_w, items, n, item, width);
+}
+
+#if defined(DZ_ARR_SEARCH_X86)
+
+// SSE2
+
+__attribute__((target("sse2"))) DZ_ARR_ALWAYS_INLINE __m128i
+dz_arr_splat_sse2(const void *item, size_t width) {
+  switch (width) {
+    case 1: {
+      int8_t lane;
+      memcpy(&lane, item, 1);
+      return _mm_set1_epi8(lane);
+    }
+    case 2: {
+      int16_t lane;
+      memcpy(&lane, item, 2);
+      return _mm_set1_epi16(lane);
+    }
+    case 4: {
+      int32_t lane;
+      memcpy(&lane, item, 4);
+      return _mm_set1_epi32(lane);
+    }
+    default: {
+      int64_t lane;
+      memcpy(&lane, item, 8);
+      return _mm_set1_epi64x(lane);
+    }
+  }
+}
+
+// Lanes equal to the needle are all ones. SSE2 has no 64 bit compare,
+// so 8 byte lanes need both of their 32 bit halves equal
+__attribute__((target("sse2"))) DZ_ARR_ALWAYS_INLINE __m128i
+dz_arr_eq_sse2(const uint8_t *items, __m128i needle, size_t width) {
+  const __m128i vector = _mm_loadu_si128((const __m128i *)items);
+  __m128i eq;
+  switch (width) {
+    case 1:
+      eq = _mm_cmpeq_epi8(vector, needle);
+      break;
+    case 2:
+      eq = _mm_cmpeq_epi16(vector, needle);
+      break;
+    case 4:
+      eq = _mm_cmpeq_epi32(vector, needle);
+      break;
+    default:
+      eq = _mm_cmpeq_epi32(vector, needle);
+      eq = _mm_and_si128(eq,
+                         _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+      break;
+  }
+  return eq;
+}
+
+// Bit i is set if byte i of the items is part of a matching lane
+__attribute__((target("sse2"))) DZ_ARR_ALWAYS_INLINE uint32_t
+dz_arr_match_sse2(const uint8_t *items, __m128i needle, size_t width) {
+  return (uint32_t)_mm_movemask_epi8(
+      dz_arr_eq_sse2(items, needle, width));
+}
+
+__attribute__((target("sse2"))) DZ_ARR_ALWAYS_INLINE size_t
+dz_arr_find_sse2_w(const uint8_t *items, size_t n, const void *item,
+                   size_t width) {
+  if (width != 1 && width != 2 && width != 4 && width != 8) {
+    return dz_arr_find_from(items, 0, n, item, width);
+  }
+  const __m128i needle = dz_arr_splat_sse2(item, width);
+  const size_t per_vector = 16 / width;
+  size_t i = 0;
+  for (; i + per_vector <= n; i += per_vector) {
+    const uint32_t mask =
+        dz_arr_match_sse2(&items[i * width], needle, width);
+    if (mask) {
+      return i + (size_t)__builtin_ctz(mask) / width;
+    }
+  }
+  return dz_arr_find_from(items, i, n, item, width);
+}
+
+// Counts the matching bytes in 8 bit counters, one per byte of the
+// vector, by subtracting the all ones bytes of every compare. The
+// counters are summed before they can overflow
+__attribute__((target("sse2"))) DZ_ARR_ALWAYS_INLINE size_t
+dz_arr_count_sse2_w(const uint8_t *items, size_t n, const void *item,
+                    size_t width) {
+  if (width != 1 && width != 2 && width != 4 && width != 8) {
+    return dz_arr_count_from(items, 0, n, item, width);
+  }
+  const __m128i needle = dz_arr_splat_sse2(item, width);
+  const size_t per_vector = 16 / width;
+  size_t matching_bytes = 0;
+  size_t i = 0;
+  while (i + per_vector <= n) {
+    __m128i counters = _mm_setzero_si128();
+    for (size_t step = 0; step < UINT8_MAX && i + per_vector <= n;
+         step++, i += per_vector) {
+      counters = _mm_sub_epi8(
+          counters, dz_arr_eq_sse2(&items[i * width], needle, width));
+    }
+    const __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+    matching_bytes += (size_t)_mm_cvtsi128_si32(sums) +
+                      (size_t)_mm_extract_epi16(sums, 4);
+  }
+  return matching_bytes / width +
+         dz_arr_count_from(items, i, n, item, width);
+}
+
+__attribute__((target("sse2"))) static size_t dz_arr_find_sse2(
+    const uint8_t *items, size_t n, const void *item, size_t width) {
+  DZ_ARR_DISPATCH_WIDTH(dz_arr_find_sse2_w, items, n, item, width);
+}
+
+__attribute__((target("sse2"))) static size_t dz_arr_count_sse2(
+    const uint8_t *items, size_t n, const void *item, size_t width) {
+  DZ_ARR_DISPATCH_WIDTH(dz_arr_count_sse2_w, items, n, item, width);
+}
+
+// AVX2
+
+__attribute__((target("avx2"))) DZ_ARR_ALWAYS_INLINE __m256i
+dz_arr_splat_avx2(const void *item, size_t width) {
+  switch (width) {
+    case 1: {
+      int8_t lane;
+      memcpy(&lane, item, 1);
+      return _mm256_set1_epi8(lane);
+    }
+    case 2: {
+      int16_t lane;
+      memcpy(&lane, item, 2);
+      return _mm256_set1_epi16(lane);
+    }
+    case 4: {
+      int32_t lane;
+      memcpy(&lane, item, 4);
+      return _mm256_set1_epi32(lane);
+    }
+    default: {
+      int64_t lane;
+      memcpy(&lane, item, 8);
+      return _mm256_set1_epi64x(lane);
+    }
+  }
+}
+
+__attribute__((target("avx2"))) DZ_ARR_ALWAYS_INLINE __m256i
+dz_arr_eq_avx2(const uint8_t *items, __m256i needle, size_t width) {
+  const __m256i vector = _mm256_loadu_si256((const __m256i *)items);
+  __m256i eq;
+  switch (width) {
+    case 1:
+      eq = _mm256_cmpeq_epi8(vector, needle);
+      break;
+    case 2:
+      eq = _mm256_cmpeq_epi16(vector, needle);
+      break;
+    case 4:
+      eq = _mm256_cmpeq_epi32(vector, needle);
+      break;
+    default:
+      eq = _mm256_cmpeq_epi64(vector, needle);
+      break;
+  }
+  return eq;
+}
+
+__attribute__((target("avx2"))) DZ_ARR_ALWAYS_INLINE uint32_t
+dz_arr_match_avx2(const uint8_t *items, __m256i needle, size_t width) {
+  return (uint32_t)_mm256_movemask_epi8(
+      dz_arr_eq_avx2(items, needle, width));
+}
+
+__attribute__((target("avx2"))) DZ_ARR_ALWAYS_INLINE size_t
+dz_arr_find_avx2_w(const uint8_t *items, size_t n, const void *item,
+                   size_t width) {
+  if (width != 1 && width != 2 && width != 4 && width != 8) {
+    return dz_arr_find_from(items, 0, n, item, width);
+  }
+  const __m256i needle = dz_arr_splat_avx2(item, width);
+  const size_t per_vector = 32 / width;
+  size_t i = 0;
+  // Two vectors a step, tested together, keeps two loads in flight
+  for (; i + 2 * per_vector <= n; i += 2 * per_vector) {
+    const uint32_t low =
+        dz_arr_match_avx2(&items[i * width], needle, width);
+    const uint32_t high = dz_arr_match_avx2(
+        &items[(i + per_vector) * width], needle, width);
+    if (low | high) {
+      return low ? i + (size_t)__builtin_ctz(low) / width
+                 : i + per_vector + (size_t)__builtin_ctz(high) / width;
+    }
+  }
+  for (; i + per_vector <= n; i += per_vector) {
+    const uint32_t mask =
+        dz_arr_match_avx2(&items[i * width], needle, width);
+    if (mask) {
+      return i + (size_t)__builtin_ctz(mask) / width;
+    }
+  }
+  return dz_arr_find_from(items, i, n, item, width);
+}
+
+// Same counters as dz_arr_count_sse2_w
+__attribute__((target("avx2"))) DZ_ARR_ALWAYS_INLINE size_t
+dz_arr_count_avx2_w(const uint8_t *items, size_t n, const void *item,
+                    size_t width) {
+  if (width != 1 && width != 2 && width != 4 && width != 8) {
+    return dz_arr_count_from(items, 0, n, item, width);
+  }
+  const __m256i needle = dz_arr_splat_avx2(item, width);
+  const size_t per_vector = 32 / width;
+  size_t matching_bytes = 0;
+  size_t i = 0;
+  while (i + per_vector <= n) {
+    __m256i counters = _mm256_setzero_si256();
+    for (size_t step = 0; step < UINT8_MAX && i + per_vector <= n;
+         step++, i += per_vector) {
+      counters = _mm256_sub_epi8(
+          counters, dz_arr_eq_avx2(&items[i * width], needle, width));
+    }
+    const __m256i sums =
+        _mm256_sad_epu8(counters, _mm256_setzero_si256());
+    const __m128i halves =
+        _mm_add_epi64(_mm256_castsi256_si128(sums),
+                      _mm256_extracti128_si256(sums, 1));
+    matching_bytes += (size_t)_mm_cvtsi128_si32(halves) +
+                      (size_t)_mm_extract_epi16(halves, 4);
+  }
+  return matching_bytes / width +
+         dz_arr_count_from(items, i, n, item, width);
+}
+
+__attribute__((target("avx2"))) static size_t dz_arr_find_avx2(
+    const uint8_t *items, size_t n, const void *item, size_t width) {
+  DZ_ARR_DISPATCH_WIDTH(dz_arr_find_avx2_w, items, n, item, width);
+}
+
+__attribute__((target("avx2"))) static size_t dz_arr_count_avx2(
+    const uint8_t *items, size_t n, const void *item, size_t width) {
+  DZ_ARR_DISPATCH_WIDTH(dz_arr_count_avx2_w, items, n, item, width);
+}
+
+#endif
+
+// Dispatch
+
+static DzArrFind dz_arr_find = dz_arr_find_scalar;
+static DzArrCount dz_arr_count = dz_arr_count_scalar;
+static DZArraySearchIsa dz_arr_search_isa = DZ_ARR_SEARCH_SCALAR;
+
+static bool dz_arr_search_supported(DZArraySearchIsa isa) {
+  switch (isa) {
+    case DZ_ARR_SEARCH_SCALAR:
+      return true;
+#if defined(DZ_ARR_SEARCH_X86)
+    case DZ_ARR_SEARCH_SSE2:
+      return __builtin_cpu_supports("sse2");
+    case DZ_ARR_SEARCH_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+bool dz_impl_arr_search_set_isa(DZArraySearchIsa isa) {
+  if (!dz_arr_search_supported(isa)) {
+    return false;
+  }
+  switch (isa) {
+#if defined(DZ_ARR_SEARCH_X86)
+    case DZ_ARR_SEARCH_SSE2:
+      dz_arr_find = dz_arr_find_sse2;
+      dz_arr_count = dz_arr_count_sse2;
+      break;
+    case DZ_ARR_SEARCH_AVX2:
+      dz_arr_find = dz_arr_find_avx2;
+      dz_arr_count = dz_arr_count_avx2;
+      break;
+#endif
+    default:
+      dz_arr_find = dz_arr_find_scalar;
+      dz_arr_count = dz_arr_count_scalar;
+      break;
+  }
+  dz_arr_search_isa = isa;
+  return true;
+}
+
+DZArraySearchIsa dz_impl_arr_search_isa(void) {
+  return dz_arr_search_isa;
+}
+
+// Runs when the library is loaded, before any thread can search
+__attribute__((constructor)) static void dz_arr_search_init(void) {
+#if defined(DZ_ARR_SEARCH_X86)
+  __builtin_cpu_init();
+#endif
+  if (!dz_impl_arr_search_set_isa(DZ_ARR_SEARCH_AVX2)) {
+    dz_impl_arr_search_set_isa(DZ_ARR_SEARCH_SSE2);
+  }
+}
+
+size_t dz_impl_arr_find(const void *items, size_t n, const void *item,
+                        size_t width) {
+  return dz_arr_find((const uint8_t *)items, n, item, width);
+}
+
+size_t dz_impl_arr_count_of(const void *items, size_t n,
+                            const void *item, size_t width) {
+  return dz_arr_count((const uint8_t *)items, n, item, width);
+}
@@ -0,0 +1,159 @@
+#include "dz_array_sort.h"
+
+#include <string.h>
+
+// LSD radix sort
+// Items are scattered by one byte of their key per pass, from the
+// lowest byte up, between the array and a scratch copy. Every pass is
+// stable, so after the last one the items are ordered by the whole
+// key. The histograms of every byte are counted in a single read of
+// the array, and passes where every item has the same byte are
+// skipped, so small keys in wide integers cost fewer passes. Signed
+// keys have their sign bit flipped, which orders them as unsigned.
+
+#define DZ_ARR_RADIX_BUCKETS 256
+
+#define DZ_ARR_ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// The key of item as an unsigned integer that orders like the key
+DZ_ARR_ALWAYS_INLINE uint64_t dz_arr_radix_key(const uint8_t *item,
+                                               size_t key_offset,
+                                               size_t key_size,
+                                               bool key_signed) {
+  uint64_t key;
+  switch (key_size) {
+    case 1: {
+      uint8_t value;
+      memcpy(&value, &item[key_offset], 1);
+      key = value;
+      break;
+    }
+    case 2: {
+      uint16_t value;
+      memcpy(&value, &item[key_offset], 2);
+      key = value;
+      break;
+    }
+    case 4: {
+      uint32_t value;
+      memcpy(&value, &item[key_offset], 4);
+      key = value;
+      break;
+    }
+    default: {
+      memcpy(&key, &item[key_offset], 8);
+      break;
+    }
+  }
+  return key_signed ? key ^ ((uint64_t)1 << (key_size * 8 - 1)) : key;
+}
+
+// Moves every item of from to its bucket in to, by byte digit of the
+// key. offsets holds where every bucket starts
+DZ_ARR_ALWAYS_INLINE void dz_arr_radix_scatter(
+    const uint8_t *from, uint8_t *to, size_t n, size_t element_size,
+    size_t key_offset, size_t key_size, bool key_signed, size_t digit,
+    size_t *offsets) {
+  for (size_t i = 0; i < n; i++) {
+    const uint8_t *item = &from[i * element_size];
+    const size_t bucket =
+        (dz_arr_radix_key(item, key_offset, key_size, key_signed) >>
+         (digit * 8)) &
+        (DZ_ARR_RADIX_BUCKETS - 1);
+    memcpy(&to[offsets[bucket]++ * element_size], item, element_size);
+  }
+}
+
+// Calls dz_arr_radix_scatter with constant sizes for the common
+// integer arrays, so the key loads and item copies become single
+// moves
+static void dz_arr_radix_pass(const uint8_t *from, uint8_t *to,
+                              size_t n, size_t element_size,
+                              size_t key_offset, size_t key_size,
+                              bool key_signed, size_t digit,
+                              size_t *offsets) {
+  if (!key_offset && element_size == key_size) {
+    switch (key_size) {
+      case 1:
+        dz_arr_radix_scatter(from, to, n, 1, 0, 1, key_signed, digit,
+                             offsets);
+        return;
+      case 2:
+        dz_arr_radix_scatter(from, to, n, 2, 0, 2, key_signed, digit,
+                             offsets);
+        return;
+      case 4:
+        dz_arr_radix_scatter(from, to, n, 4, 0, 4, key_signed, digit,
+                             offsets);
+        return;
+      case 8:
+        dz_arr_radix_scatter(from, to, n, 8, 0, 8, key_signed, digit,
+                             offsets);
+        return;
+    }
+  }
+  dz_arr_radix_scatter(from, to, n, element_size, key_offset, key_size,
+                       key_signed, digit, offsets);
+}
+
+bool dz_impl_arr_radix_sort(void **arr_ref, size_t element_size,
+                            size_t key_offset, size_t key_size,
+                            bool key_signed) {
+  DZ_ASSERT(arr_ref);
+  DZ_ASSERT(key_size == 1 || key_size == 2 || key_size == 4 ||
+                key_size == 8,
+            "Radix sort keys must be 1, 2, 4 or 8 byte integers");
+  DZ_ASSERT(key_offset + key_size <= element_size,
+            "Radix sort keys must be inside the items");
+  const size_t n = dz_arrlen(*arr_ref);
+  if (n < 2) {
+    return true;
+  }
+  DZArrayHeader *header = dz_array_header(*arr_ref);
+  uint8_t *items = (uint8_t *)*arr_ref;
+  size_t counts[8][DZ_ARR_RADIX_BUCKETS];
+  memset(counts, 0, sizeof(counts));
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t key = dz_arr_radix_key(&items[i * element_size],
+                                          key_offset, key_size,
+                                          key_signed);
+    for (size_t digit = 0; digit < key_size; digit++) {
+      counts[digit][(key >> (digit * 8)) & (DZ_ARR_RADIX_BUCKETS - 1)]++;
+    }
+  }
+  uint8_t *scratch = NULL;
+  uint8_t *from = items;
+  for (size_t digit = 0; digit < key_size; digit++) {
+    size_t *offsets = counts[digit];
+    size_t offset = 0;
+    bool single_bucket = false;
+    for (size_t bucket = 0; bucket < DZ_ARR_RADIX_BUCKETS; bucket++) {
+      const size_t count = offsets[bucket];
+      single_bucket |= count == n;
+      offsets[bucket] = offset;
+      offset += count;
+    }
+    if (single_bucket) {
+      continue;
+    }
+    if (!scratch) {
+      scratch = (uint8_t *)dz_impl_alloc(header->allocator,
+                                         n * element_size);
+      if (!scratch) {
+        // No pass has run yet, so the array is as it was
+        return false;
+      }
+    }
+    uint8_t *to = from == items ? scratch : items;
+    dz_arr_radix_pass(from, to, n, element_size, key_offset, key_size,
+                      key_signed, digit, offsets);
+    from = to;
+  }
+  if (from != items) {
+    memcpy(items, from, n * element_size);
+  }
+  if (scratch) {
+    dz_impl_free(header->allocator, scratch, n * element_size);
+  }
+  return true;
+}
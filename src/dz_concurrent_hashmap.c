@@ -0,0 +1,197 @@
+#include "dz_concurrent_hashmap.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dz_debug.h"
+#include "dz_hash.h"
+
+#define CHM_CACHE_LINE 64
+
+const size_t CHM_DEFAULT_SHARD_COUNT = 64;
+
+// Each shard gets its own cache lines, so threads working on
+// neighbouring shards don't fight over the line holding their locks
+typedef struct __attribute__((aligned(CHM_CACHE_LINE))) DzChmShard {
+  pthread_rwlock_t lock;
+  DzHashmap hm;
+} DzChmShard;
+
+typedef struct DzConcurrentHashmapInstance {
+  DzChmShard *shards;
+  size_t shard_count;  // Always a power of two
+  unsigned shard_bits;
+  uint64_t salt;  // Picks shards. Each shard salts its own table
+} DzConcurrentHashmapInstance;
+
+static void chm_error_set(DzHmError *error_ref, DzHmError value) {
+  if (error_ref) {
+    *error_ref = value;
+  }
+}
+
+// The shard maps hash with their own salt, so the top bits used here
+// are independent of where the key ends up inside the shard
+static DzChmShard *chm_shard_for(const DzConcurrentHashmap chm,
+                                 const void *key,
+                                 const size_t keysize) {
+  if (!chm->shard_bits) {
+    return &chm->shards[0];
+  }
+  const uint64_t hash = dz_hash_bytes(key, keysize, chm->salt);
+  return &chm->shards[hash >> (64 - chm->shard_bits)];
+}
+
+static void chm_shards_free(DzChmShard *shards, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    hm_free(shards[i].hm);
+    pthread_rwlock_destroy(&shards[i].lock);
+  }
+  free(shards);
+}
+
+DzConcurrentHashmap chm_init(const size_t shard_count,
+                             DzHmError *error) {
+  chm_error_set(error, DzHmError_None);
+  DzConcurrentHashmap chm = (DzConcurrentHashmap)calloc(
+      1, sizeof(struct DzConcurrentHashmapInstance));
+  DZ_ASSERT(chm, "Malloc on concurrent hashmap failed");
+  if (!chm) {
+    chm_error_set(error, DzHmError_Memory);
+    return NULL;
+  }
+  const size_t wanted =
+      (shard_count == 0) ? CHM_DEFAULT_SHARD_COUNT : shard_count;
+  chm->shard_count = 1;
+  chm->shard_bits = 0;
+  while (chm->shard_count < wanted) {
+    chm->shard_count *= 2;
+    chm->shard_bits++;
+  }
+  void *shards = NULL;
+  if (posix_memalign(&shards, CHM_CACHE_LINE,
+                     chm->shard_count * sizeof(DzChmShard))) {
+    DZ_ASSERT(false, "Malloc on concurrent hashmap shards failed");
+    chm_error_set(error, DzHmError_Memory);
+    free(chm);
+    return NULL;
+  }
+  chm->shards = (DzChmShard *)shards;
+  for (size_t i = 0; i < chm->shard_count; i++) {
+    DzChmShard *shard = &chm->shards[i];
+    shard->hm = hm_init(error);
+    if (!shard->hm) {
+      chm_shards_free(chm->shards, i);
+      free(chm);
+      return NULL;
+    }
+    if (pthread_rwlock_init(&shard->lock, NULL)) {
+      DZ_ASSERT(false, "Could not initialize a shard lock");
+      hm_free(shard->hm);
+      chm_shards_free(chm->shards, i);
+      free(chm);
+      chm_error_set(error, DzHmError_Memory);
+      return NULL;
+    }
+  }
+  arc4random_buf(&chm->salt, sizeof(chm->salt));
+  return chm;
+}
+
+void chm_free(DzConcurrentHashmap chm) {
+  DZ_ASSERT(chm);
+  if (!chm) {
+    return;
+  }
+  chm_shards_free(chm->shards, chm->shard_count);
+  free(chm);
+}
+
+size_t chm_get(DzConcurrentHashmap chm, const void *key,
+               const size_t keysize, void *value_out,
+               const size_t value_capacity) {
+  DZ_ASSERT(chm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  DZ_ASSERT(value_out || !value_capacity,
+            "Caller must supply a buffer for the value");
+  if (!chm || !key || !keysize) {
+    return 0;
+  }
+  DzChmShard *shard = chm_shard_for(chm, key, keysize);
+  size_t valuesize = 0;
+  pthread_rwlock_rdlock(&shard->lock);
+  // Shard maps never resize incrementally, so hm_get only writes the
+  // operation counters of DZ_HM_COUNTERS builds, which are relaxed
+  // atomics, and is safe under a shared lock
+  const void *value =
+      hm_get_with_size(shard->hm, key, keysize, &valuesize);
+  if (value && valuesize <= value_capacity) {
+    memcpy(value_out, value, valuesize);
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  return value ? valuesize : 0;
+}
+
+size_t chm_get_str(DzConcurrentHashmap chm, const char *key,
+                   char *value_out, const size_t value_capacity) {
+  return chm_get(chm, key, strlen(key) + 1, value_out,
+                 value_capacity);
+}
+
+bool chm_contains(DzConcurrentHashmap chm, const void *key,
+                  const size_t keysize) {
+  return chm_get(chm, key, keysize, NULL, 0) != 0;
+}
+
+void chm_add(DzConcurrentHashmap chm, const void *key,
+             const size_t keysize, const void *value,
+             const size_t valuesize, DzHmError *error) {
+  DZ_ASSERT(chm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!chm || !key || !keysize) {
+    chm_error_set(error, DzHmError_Argument);
+    return;
+  }
+  DzChmShard *shard = chm_shard_for(chm, key, keysize);
+  pthread_rwlock_wrlock(&shard->lock);
+  hm_add(shard->hm, key, keysize, value, valuesize, error);
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+void chm_add_str(DzConcurrentHashmap chm, const char *key,
+                 const char *value, DzHmError *error) {
+  chm_add(chm, key, strlen(key) + 1, value, strlen(value) + 1, error);
+}
+
+void chm_delete(DzConcurrentHashmap chm, const void *key,
+                const size_t keysize) {
+  DZ_ASSERT(chm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!chm || !key || !keysize) {
+    return;
+  }
+  DzChmShard *shard = chm_shard_for(chm, key, keysize);
+  pthread_rwlock_wrlock(&shard->lock);
+  hm_delete(shard->hm, key, keysize);
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+void chm_delete_str(DzConcurrentHashmap chm, const char *key) {
+  chm_delete(chm, key, strlen(key) + 1);
+}
+
+size_t chm_count(DzConcurrentHashmap chm) {
+  DZ_ASSERT(chm, "Caller must supply a hashmap");
+  if (!chm) {
+    return 0;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < chm->shard_count; i++) {
+    DzChmShard *shard = &chm->shards[i];
+    pthread_rwlock_rdlock(&shard->lock);
+    count += hm_count(shard->hm);
+    pthread_rwlock_unlock(&shard->lock);
+  }
+  return count;
+}
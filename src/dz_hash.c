@@ -0,0 +1,81 @@
+#include "dz_hash.h"
+
+#include <string.h>
+
+// Odd constants with a good mix of set bits
+static const uint64_t DZ_HASH_K0 = 0xa0761d6478bd642full;
+static const uint64_t DZ_HASH_K1 = 0xe7037ed1a0b428dbull;
+static const uint64_t DZ_HASH_K2 = 0x8ebc6af09c88c6e3ull;
+
+static inline uint64_t dz_hash_read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t dz_hash_read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Multiplies a and b into 128 bits, and folds the halves together
+static inline uint64_t dz_hash_mix(const uint64_t a,
+                                   const uint64_t b) {
+  const __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+uint64_t dz_hash_bytes(const void *data, const size_t len,
+                       uint64_t seed) {
+  const uint8_t *p = (const uint8_t *)data;
+  seed ^= dz_hash_mix(seed ^ DZ_HASH_K0, DZ_HASH_K1);
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (len <= 16) {
+    if (len >= 4) {
+      // Two overlapping 4 byte reads from each end cover every byte
+      const size_t mid = (len >> 3) << 2;
+      a = (dz_hash_read32(p) << 32) | dz_hash_read32(p + mid);
+      b = (dz_hash_read32(p + len - 4) << 32) |
+          dz_hash_read32(p + len - 4 - mid);
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+          p[len - 1];
+    }
+  } else {
+    size_t remaining = len;
+    if (remaining > 48) {
+      // Three independent lanes so the multiplies can overlap
+      uint64_t lane_1 = seed;
+      uint64_t lane_2 = seed;
+      do {
+        seed = dz_hash_mix(dz_hash_read64(p) ^ DZ_HASH_K1,
+                           dz_hash_read64(p + 8) ^ seed);
+        lane_1 = dz_hash_mix(dz_hash_read64(p + 16) ^ DZ_HASH_K2,
+                             dz_hash_read64(p + 24) ^ lane_1);
+        lane_2 = dz_hash_mix(dz_hash_read64(p + 32) ^ DZ_HASH_K0,
+                             dz_hash_read64(p + 40) ^ lane_2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= lane_1 ^ lane_2;
+    }
+    while (remaining > 16) {
+      seed = dz_hash_mix(dz_hash_read64(p) ^ DZ_HASH_K1,
+                         dz_hash_read64(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+    // The last 16 bytes, which may overlap bytes already consumed
+    a = dz_hash_read64(p + remaining - 16);
+    b = dz_hash_read64(p + remaining - 8);
+  }
+  a ^= DZ_HASH_K1;
+  b ^= seed;
+  const __uint128_t r = (__uint128_t)a * b;
+  a = (uint64_t)r;
+  b = (uint64_t)(r >> 64);
+  return dz_hash_mix(a ^ DZ_HASH_K0 ^ (uint64_t)len,
+                     b ^ DZ_HASH_K1);
+}
@@ -1,38 +1,37 @@
 #include "dz_hashmap.h"
 
 #include <limits.h>
-#include <math.h>
 #include <stdlib.h>
+#include <time.h>
 
+#include "dz_array.h"
 #include "dz_debug.h"
+#include "dz_hash.h"
+#include "dz_hashmap_group.h"
+#include "dz_hashmap_internal.h"
+#include "dz_slab.h"
 
-typedef struct DzHashmapItem {
-  char *key;
-  char *value;
-  size_t keysize;
-  size_t valuesize;
-} DzHashmapItem;
-
-typedef struct DzHashmapInstance {
-  DzHashmapItem **items;
-  size_t capacity;
-  size_t count;
-  size_t salt;  // Used to prevent hash table attacks
-} DzHashmapInstance;
-
-// 283
-const size_t HM_INIT_CAPACITY = 53;
-// 100008869
-static const size_t HM_PRIME_1 = 100008317;
-static const size_t HM_PRIME_2 = 100008317 + 2;
-static const double HM_RESIZE_UP_THRESHOLD = 0.7;
-static const size_t MAX_KEY_SIZE = SIZE_MAX;
-
-static DzHashmapItem DELETED_ITEM = {.key = NULL, .value = NULL};
+// Old table slots moved by each operation during an incremental
+// resize. One group per operation finishes the move long before the
+// new table can fill up.
+#define HM_MIGRATE_SLOTS_PER_OP HM_GROUP_WIDTH
+// Keys looked up together by hm_get_many. Enough to keep a few dozen
+// cache misses in flight, few enough that the prefetched lines are
+// still in cache when they are used.
+#define HM_GET_MANY_BATCH 16
+
+const size_t HM_INIT_CAPACITY = 64;
+const double HM_DEFAULT_MAX_LOAD_FACTOR = 0.875;
+static const size_t MAX_KEY_SIZE = HM_MAX_KEY_SIZE;
+static const size_t MAX_VALUE_SIZE = HM_MAX_VALUE_SIZE;
 
 static const char *DZ_HM_ERROR_STRINGS[DzHmError_Count] = {
     [DzHmError_None] = "No error",
     [DzHmError_Memory] = "Could not allocate memory",
+    [DzHmError_Argument] = "Invalid argument",
+    [DzHmError_Io] = "Could not read or write file",
+    [DzHmError_Format] = "Not a valid hashmap snapshot",
+    [DzHmError_Collision] = "Keys have the same 64 bit hash",
 };
 
 static void hm_error_set(DzHmError *error_ref, DzHmError value) {
@@ -41,56 +40,174 @@ static void hm_error_set(DzHmError *error_ref, DzHmError value) {
   }
 }
 
-static bool is_prime(const size_t x) {
-  if (x <= 2) {
-    return false;
+bool hm_has_error(DzHmError *error_ref) {
+  return error_ref && *error_ref;
+}
+
+const char *hm_error_get_failure_str(DzHmError error_enum) {
+  return DZ_HM_ERROR_STRINGS[error_enum];
+}
+
+static inline uint64_t hm_internal_hash(const DzHashmap hm,
+                                        const void *key,
+                                        const size_t keysize) {
+  return dz_hash_bytes(key, keysize, hm->salt);
+}
+
+// Returns the index of the slot holding key in the table made of
+// ctrl and slots, or capacity if the key is not in the table
+static size_t hm_table_find(const int8_t *ctrl,
+                            const DzHashmapSlot *slots,
+                            const size_t capacity, const void *key,
+                            const size_t keysize, const uint64_t hash,
+                            DzHmCounters *counters) {
+  const int8_t h2 = hm_hash_h2(hash);
+  DzHmProbe probe = hm_internal_probe_start(hash, capacity);
+  HM_COUNTER_ADD(counters, finds, 1);
+  while (true) {
+    const size_t base = probe.group * HM_GROUP_WIDTH;
+    const int8_t *group = &ctrl[base];
+    HM_COUNTER_ADD(counters, find_groups, 1);
+    for (uint32_t mask = hm_group_match(group, h2); mask;
+         mask &= mask - 1) {
+      const size_t index = base + hm_mask_first(mask);
+      if (hm_slot_key_eq(&slots[index], hash, key, keysize)) {
+        HM_COUNTER_ADD(counters, find_hits, 1);
+        return index;
+      }
+    }
+    if (hm_group_match_empty(group)) {
+      return capacity;
+    }
+    hm_internal_probe_next(&probe);
   }
-  if (x % 2 == 0) {
-    return false;
+}
+
+// Returns the index of the slot holding key in the current table, or
+// capacity if the key is not in it
+static size_t hm_internal_find(const DzHashmap hm, const void *key,
+                               const size_t keysize,
+                               const uint64_t hash) {
+  return hm_table_find(hm->ctrl, hm->slots, hm->capacity, key,
+                       keysize, hash, &hm->counters);
+}
+
+// Returns the index of the slot holding key in the old table of an
+// incremental resize, or old_capacity if it isn't there
+static size_t hm_internal_find_old(const DzHashmap hm,
+                                   const void *key,
+                                   const size_t keysize,
+                                   const uint64_t hash) {
+  if (!hm->old_ctrl) {
+    return hm->old_capacity;
   }
-  for (size_t i = 3; i < (size_t)floor(sqrt(x)); i++) {
-    if (x % i == 0) {
-      return false;
+  return hm_table_find(hm->old_ctrl, hm->old_slots, hm->old_capacity,
+                       key, keysize, hash, &hm->counters);
+}
+
+// Returns the index of the first EMPTY or DELETED slot in the probe
+// sequence of hash. The table must not be full.
+static size_t hm_internal_find_free(const int8_t *ctrl,
+                                    const size_t capacity,
+                                    const uint64_t hash) {
+  DzHmProbe probe = hm_internal_probe_start(hash, capacity);
+  while (true) {
+    const size_t base = probe.group * HM_GROUP_WIDTH;
+    const uint32_t mask =
+        hm_group_match_empty_or_deleted(&ctrl[base]);
+    if (mask) {
+      return base + hm_mask_first(mask);
     }
+    hm_internal_probe_next(&probe);
   }
-  return true;
 }
 
-static size_t prime_find_next(size_t x) {
-  if (x <= 1) {
-    return 2;
+// Rounds capacity up to a power of two that holds at least one group
+static size_t hm_capacity_normalize(const size_t capacity) {
+  size_t result = HM_GROUP_WIDTH;
+  while (result < capacity) {
+    result *= 2;
   }
-  x++;
-  while (!is_prime(x)) {
-    x++;
+  return result;
+}
+
+// Number of used slots (items and tombstones) at which a table of
+// capacity slots must grow. Always leaves at least one EMPTY slot,
+// which is what terminates probing.
+static size_t hm_growth_limit(const size_t capacity,
+                              const double max_load_factor) {
+  const size_t limit = (size_t)(capacity * max_load_factor);
+  return max(min(limit, capacity - 1), 1);
+}
+
+// Smallest table capacity that holds n items under max_load_factor
+static size_t hm_capacity_for_items(const size_t n,
+                                    const double max_load_factor) {
+  size_t capacity = hm_capacity_normalize(0);
+  while (hm_growth_limit(capacity, max_load_factor) <= n) {
+    capacity *= 2;
   }
-  return x;
+  return capacity;
 }
 
-bool hm_has_error(DzHmError *error_ref) {
-  return error_ref && *error_ref;
+// Bytes of the block holding the control bytes and slots of a table
+static size_t hm_table_size(const size_t capacity) {
+  return capacity + capacity * sizeof(DzHashmapSlot);
 }
 
-const char *hm_error_get_failure_str(DzHmError error_enum) {
-  return DZ_HM_ERROR_STRINGS[error_enum];
+// Allocates control bytes and slots for capacity items in one block.
+// The control bytes come first, so they stay aligned for SIMD loads.
+// With the default allocator, the block comes from calloc, which hands
+// out big blocks as fresh zero pages, so allocating even a huge table
+// takes constant time.
+static bool hm_table_alloc(const DzHashmap hm, const size_t capacity,
+                           int8_t **ctrl_out,
+                           DzHashmapSlot **slots_out) {
+  DZ_ASSERT(capacity % HM_GROUP_WIDTH == 0);
+  char *block = (char *)dz_impl_alloc_zeroed(hm->allocator,
+                                             hm_table_size(capacity));
+  DZ_ASSERT(block, "Malloc failed on hashmap table");
+  if (!block) {
+    return false;
+  }
+  DZ_ASSERT((uintptr_t)block % HM_GROUP_WIDTH == 0,
+            "Control bytes must be aligned for group loads");
+  *ctrl_out = (int8_t *)block;
+  *slots_out = (DzHashmapSlot *)(block + capacity);
+  return true;
 }
 
-DzHashmap hm_init_with_capacity(const size_t capacity,
-                                DzHmError *error) {
-  DzHashmap hm =
-      (DzHashmap)calloc(1, sizeof(struct DzHashmapInstance));
+// Frees a table allocated by hm_table_alloc. ctrl is the start of the
+// block holding the slots too
+static void hm_table_free(const DzHashmap hm, int8_t *ctrl,
+                          const size_t capacity) {
+  if (ctrl) {
+    dz_impl_free(hm->allocator, ctrl, hm_table_size(capacity));
+  }
+}
+
+// Initializes a hashmap with a table of exactly capacity slots
+static DzHashmap hm_init_with_table_capacity(
+    const size_t capacity, const DZAllocator *allocator,
+    DzHmError *error) {
+  DzHashmap hm = (DzHashmap)dz_impl_alloc_zeroed(
+      allocator, sizeof(struct DzHashmapInstance));
   DZ_ASSERT(hm, "Malloc on hashmap failed");
   if (!hm) {
     hm_error_set(error, DzHmError_Memory);
     return NULL;
   }
   hm->count = 0;
-  hm->capacity = capacity;
-  hm->items =
-      (DzHashmapItem **)calloc(hm->capacity, (sizeof *hm->items));
-  DZ_ASSERT(hm->items, "Malloc failed on hashmap items");
-  if (!hm->items) {
+  hm->tombstones = 0;
+  hm->capacity = hm_capacity_normalize(capacity);
+  hm->max_load_factor = HM_DEFAULT_MAX_LOAD_FACTOR;
+  hm->allocator = allocator;
+  hm->slab = dz_slab_init_ex(0, allocator);
+  hm->growth_limit =
+      hm_growth_limit(hm->capacity, hm->max_load_factor);
+  if (!hm_table_alloc(hm, hm->capacity, &hm->ctrl, &hm->slots)) {
     hm_error_set(error, DzHmError_Memory);
+    dz_impl_free(allocator, hm, sizeof(struct DzHashmapInstance));
     return NULL;
   }
   // Cryptographically secure salt
@@ -99,20 +216,99 @@ DzHashmap hm_init_with_capacity(const size_t capacity,
 }
 
 DzHashmap hm_init(DzHmError *error) {
-  return hm_init_with_capacity(HM_INIT_CAPACITY, error);
+  return hm_init_with_table_capacity(HM_INIT_CAPACITY, NULL, error);
 }
 
-static void hm_item_free(DzHashmapItem *item) {
-  if (!item || item == &DELETED_ITEM) {
-    return;
+DzHashmap hm_init_with_capacity(const size_t capacity,
+                                DzHmError *error) {
+  return hm_init_ex(capacity, NULL, error);
+}
+
+DzHashmap hm_init_ex(const size_t capacity,
+                     const DZAllocator *allocator, DzHmError *error) {
+  return hm_init_with_table_capacity(
+      hm_capacity_for_items(capacity, HM_DEFAULT_MAX_LOAD_FACTOR),
+      allocator, error);
+}
+
+static void hm_slot_free(DZSlab *slab, DzHashmapSlot *slot) {
+  if (!slot->is_inline && slot->data) {
+    dz_slab_dealloc(slab, slot->data,
+                    slot->keysize + slot->valuesize);
   }
-  if (item->key) {
-    free(item->key);
+  slot->data = NULL;
+  slot->is_inline = false;
+}
+
+static inline bool hm_item_fits_inline(const bool inline_small,
+                                       const size_t keysize,
+                                       const size_t valuesize) {
+  return inline_small && keysize + valuesize <= HM_INLINE_SIZE;
+}
+
+// A NULL value is written as valuesize zero bytes
+static void hm_slot_write(DzHashmapSlot *slot, const uint64_t hash,
+                          const void *key, const size_t keysize,
+                          const void *value, const size_t valuesize) {
+  char *bytes = hm_slot_bytes(slot);
+  memcpy(bytes, key, keysize);
+  if (value) {
+    memcpy(bytes + keysize, value, valuesize);
+  } else {
+    memset(bytes + keysize, 0, valuesize);
   }
-  if (item->value) {
-    free(item->value);
+  slot->hash = hash;
+  slot->keysize = (uint32_t)keysize;
+  slot->valuesize = (uint32_t)valuesize;
+  slot->referenced = false;
+}
+
+bool hm_internal_slot_set(DZSlab *slab, DzHashmapSlot *slot,
+                          const bool inline_small, const uint64_t hash,
+                          const void *key, const size_t keysize,
+                          const void *value, const size_t valuesize) {
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (hm_item_fits_inline(inline_small, keysize, valuesize)) {
+    slot->is_inline = true;
+  } else {
+    char *data = (char *)dz_slab_alloc(slab, keysize + valuesize);
+    DZ_ASSERT(data, "Could not allocate memory");
+    if (!data) {
+      return false;
+    }
+    slot->is_inline = false;
+    slot->data = data;
   }
-  free(item);
+  hm_slot_write(slot, hash, key, keysize, value, valuesize);
+  return true;
+}
+
+// The storage is reused when the new contents fit in it the same way
+// (inline, or in the same slab size class), so overwriting a value
+// with one of a similar size never allocates
+bool hm_internal_slot_replace(DZSlab *slab, DzHashmapSlot *slot,
+                              const bool inline_small,
+                              const uint64_t hash, const void *key,
+                              const size_t keysize, const void *value,
+                              const size_t valuesize) {
+  const bool fits_inline =
+      hm_item_fits_inline(inline_small, keysize, valuesize);
+  if (slot->is_inline
+          ? fits_inline
+          : !fits_inline &&
+                dz_slab_same_class(slot->keysize + slot->valuesize,
+                                   keysize + valuesize)) {
+    hm_slot_write(slot, hash, key, keysize, value, valuesize);
+    return true;
+  }
+  DzHashmapSlot replacement;
+  if (!hm_internal_slot_set(slab, &replacement, inline_small, hash,
+                            key, keysize, value, valuesize)) {
+    return false;
+  }
+  hm_slot_free(slab, slot);
+  *slot = replacement;
+  return true;
 }
 
 void hm_free(DzHashmap hm) {
@@ -120,199 +316,647 @@ void hm_free(DzHashmap hm) {
   if (!hm) {
     return;
   }
-  for (size_t i = 0; i < hm->capacity; i++) {
-    DzHashmapItem *item = hm->items[i];
-    if (item && item != &DELETED_ITEM) {
-      hm_item_free(item);
+  // Every key and value lives in the slab
+  dz_slab_free(&hm->slab);
+  hm_table_free(hm, hm->ctrl, hm->capacity);
+  hm_table_free(hm, hm->old_ctrl, hm->old_capacity);
+  dz_impl_free(hm->allocator, hm, sizeof(struct DzHashmapInstance));
+}
+
+// Moves the next few items of the old table into the current one,
+// and frees the old table once it is empty
+static void hm_migrate_step(DzHashmap hm) {
+  const size_t end = min(hm->migrate_index + HM_MIGRATE_SLOTS_PER_OP,
+                         hm->old_capacity);
+  for (size_t i = hm->migrate_index; i < end; i++) {
+    if (!hm_ctrl_is_full(hm->old_ctrl[i])) {
+      continue;
+    }
+    const DzHashmapSlot *old_slot = &hm->old_slots[i];
+    const size_t index =
+        hm_internal_find_free(hm->ctrl, hm->capacity, old_slot->hash);
+    if (hm->ctrl[index] == HM_CTRL_DELETED) {
+      hm->tombstones--;
     }
+    hm->ctrl[index] = hm_hash_h2(old_slot->hash);
+    hm->slots[index] = *old_slot;
+    hm->old_count--;
+  }
+  hm->migrate_index = end;
+  if (hm->migrate_index == hm->old_capacity) {
+    DZ_ASSERT(hm->old_count == 0);
+    hm_table_free(hm, hm->old_ctrl, hm->old_capacity);
+    hm->old_ctrl = NULL;
+    hm->old_slots = NULL;
+    hm->old_capacity = 0;
+    hm->migrate_index = 0;
   }
-  if (hm->items) {
-    free(hm->items);
+}
+
+// Finishes an incremental resize, if one is in progress
+static void hm_finish_migration(DzHashmap hm) {
+  while (hm->old_ctrl) {
+    hm_migrate_step(hm);
   }
-  free(hm);
-  hm = NULL;
 }
 
-static DzHashmapItem *hm_item_create(const void *key,
-                                     const void *value,
-                                     const size_t keysize,
-                                     const size_t valuesize) {
+DzHashmapSlot *hm_internal_get_slot(DzHashmap hm, const void *key,
+                                    const size_t keysize,
+                                    const uint64_t hash) {
+  if (hm->old_ctrl) {
+    hm_migrate_step(hm);
+  }
+  const size_t index = hm_internal_find(hm, key, keysize, hash);
+  if (index != hm->capacity) {
+    return &hm->slots[index];
+  }
+  const size_t old_index =
+      hm_internal_find_old(hm, key, keysize, hash);
+  if (old_index != hm->old_capacity) {
+    return &hm->old_slots[old_index];
+  }
+  return NULL;
+}
+
+DzHmHash hm_hash(DzHashmap hm, const void *key, const size_t keysize) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(key || !keysize, "Caller must supply a key");
+  if (!hm) {
+    return 0;
+  }
+  return hm_internal_hash(hm, key, keysize);
+}
+
+DzHmHash hm_hash_str(DzHashmap hm, const char *key) {
+  return hm_hash(hm, key, strlen(key) + 1);
+}
+
+const void *hm_get_prehashed(DzHashmap hm, const void *key,
+                             const size_t keysize,
+                             const DzHmHash hash) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
   DZ_ASSERT(key, "Caller must supply a key");
-  DZ_ASSERT(value, "Caller must supply a value");
-  if (!key || !value || !keysize || !valuesize) {
+  DZ_ASSERT(!hm || !key || hash == hm_internal_hash(hm, key, keysize),
+            "Hash must come from hm_hash on the same hashmap");
+  if (!hm || !key || !keysize) {
     return NULL;
   }
-  DzHashmapItem *item =
-      (DzHashmapItem *)calloc(1, sizeof(DzHashmapItem));
-  item->key = (char *)calloc(keysize, sizeof(char));
-  DZ_ASSERT(item->key, "Could not calloc memory");
-  memcpy(item->key, key, keysize);
-  item->value = (char *)calloc(valuesize, sizeof(char));
-  DZ_ASSERT(item->value, "Could not calloc memory");
-  memcpy(item->value, value, valuesize);
-  item->valuesize = valuesize;
-  item->keysize = keysize;
-  return item;
-}
-
-static size_t hm_internal_hash(const void *str, const size_t str_len,
-                               const size_t a,
-                               const size_t bucket_count,
-                               const size_t attempt, size_t salt) {
-  DZ_ASSERT(str);
-  const char *str_bytes = (const char *)str;
-  size_t hash = attempt + salt;
-  for (size_t i = 0; i < str_len; i++) {
-    hash += pow(a, str_len - (i + 1)) * str_bytes[i];
-  }
-  return hash % bucket_count;
-}
-
-static size_t hm_internal_get_index_hash(const void *str,
-                                         const size_t str_len,
-                                         const size_t bucket_count,
-                                         const size_t attempt,
-                                         const size_t salt) {
-  DZ_ASSERT(str);
-  const size_t hash_a = hm_internal_hash(str, str_len, HM_PRIME_1,
-                                         bucket_count, attempt, salt);
-  const size_t hash_b = hm_internal_hash(str, str_len, HM_PRIME_2,
-                                         bucket_count, attempt, salt);
-  return (hash_a + (attempt * (hash_b + 1))) % bucket_count;
+  const DzHashmapSlot *slot =
+      hm_internal_get_slot(hm, key, keysize, hash);
+  return slot ? hm_slot_bytes(slot) + slot->keysize : NULL;
 }
 
-const void *hm_get(DzHashmap hm, const void *key,
-                   const size_t keysize) {
+const void *hm_get_key_prehashed(DzHashmap hm, const void *key,
+                                 const size_t keysize,
+                                 const DzHmHash hash) {
   DZ_ASSERT(hm, "Caller must supply a hashmap");
   DZ_ASSERT(key, "Caller must supply a key");
+  DZ_ASSERT(!hm || !key || hash == hm_internal_hash(hm, key, keysize),
+            "Hash must come from hm_hash on the same hashmap");
   if (!hm || !key || !keysize) {
     return NULL;
   }
-  size_t index = hm_internal_get_index_hash(
-      key, keysize, hm->capacity, 0, hm->salt);
-  DzHashmapItem *current_item = hm->items[index];
-  size_t i = 1;
-  while (current_item != NULL) {
-    if (current_item != &DELETED_ITEM &&
-        mem_eq(current_item->key, key, current_item->keysize,
-               keysize)) {
-      return current_item->value;
+  const DzHashmapSlot *slot =
+      hm_internal_get_slot(hm, key, keysize, hash);
+  return slot ? hm_slot_bytes(slot) : NULL;
+}
+
+const void *hm_get_with_size(DzHashmap hm, const void *key,
+                             const size_t keysize,
+                             size_t *valuesize) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!hm || !key || !keysize) {
+    return NULL;
+  }
+  const DzHashmapSlot *slot = hm_internal_get_slot(
+      hm, key, keysize, hm_internal_hash(hm, key, keysize));
+  if (!slot) {
+    return NULL;
+  }
+  if (valuesize) {
+    *valuesize = slot->valuesize;
+  }
+  return hm_slot_bytes(slot) + slot->keysize;
+}
+
+const void *hm_get(DzHashmap hm, const void *key,
+                   const size_t keysize) {
+  return hm_get_with_size(hm, key, keysize, NULL);
+}
+
+// Looks up one batch of at most HM_GET_MANY_BATCH keys. Each pass
+// does one step for every key and prefetches what the next pass
+// needs, so the cache misses of different keys overlap instead of
+// being waited on one after the other:
+//  1. Hash every key, prefetch its first control group
+//  2. Match the fingerprint, prefetch the first candidate slot
+//  3. Prefetch the key bytes the candidate slot points to, unless
+//     they are stored in the slot
+//  4. Compare keys. Keys that aren't settled by their first group
+//     fall back to a regular probe
+static void hm_get_batch(DzHashmap hm, const void *const keys[],
+                         const size_t keysizes[], const size_t n,
+                         const void *out_values[]) {
+  uint64_t hashes[HM_GET_MANY_BATCH];
+  size_t bases[HM_GET_MANY_BATCH];
+  uint32_t candidates[HM_GET_MANY_BATCH];
+  for (size_t i = 0; i < n; i++) {
+    hashes[i] = hm_internal_hash(hm, keys[i], keysizes[i]);
+    bases[i] = hm_internal_probe_start(hashes[i], hm->capacity).group *
+               HM_GROUP_WIDTH;
+    __builtin_prefetch(&hm->ctrl[bases[i]]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    candidates[i] =
+        hm_group_match(&hm->ctrl[bases[i]], hm_hash_h2(hashes[i]));
+    if (candidates[i]) {
+      __builtin_prefetch(
+          &hm->slots[bases[i] + hm_mask_first(candidates[i])]);
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (candidates[i]) {
+      const DzHashmapSlot *slot =
+          &hm->slots[bases[i] + hm_mask_first(candidates[i])];
+      if (!slot->is_inline) {
+        __builtin_prefetch(slot->data);
+      }
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    out_values[i] = NULL;
+    bool settled = false;
+    for (uint32_t mask = candidates[i]; mask; mask &= mask - 1) {
+      const DzHashmapSlot *slot =
+          &hm->slots[bases[i] + hm_mask_first(mask)];
+      if (hm_slot_key_eq(slot, hashes[i], keys[i], keysizes[i])) {
+        out_values[i] = hm_slot_bytes(slot) + slot->keysize;
+        settled = true;
+        break;
+      }
+    }
+    if (settled || hm_group_match_empty(&hm->ctrl[bases[i]])) {
+      HM_COUNTER_ADD(&hm->counters, finds, 1);
+      HM_COUNTER_ADD(&hm->counters, find_groups, 1);
+      HM_COUNTER_ADD(&hm->counters, find_hits, settled);
+      continue;
+    }
+    const size_t index =
+        hm_internal_find(hm, keys[i], keysizes[i], hashes[i]);
+    if (index != hm->capacity) {
+      const DzHashmapSlot *slot = &hm->slots[index];
+      out_values[i] = hm_slot_bytes(slot) + slot->keysize;
     }
-    index = hm_internal_get_index_hash(key, keysize, hm->capacity, i,
-                                       hm->salt);
-    current_item = hm->items[index];
-    i++;
   }
-  return NULL;
 }
 
-void hm_resize(DzHashmap hm, const size_t new_size,
-               DzHmError *error) {
+void hm_get_many(DzHashmap hm, const void *const keys[],
+                 const size_t keysizes[], const size_t n,
+                 const void *out_values[]) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(keys || !n, "Caller must supply keys");
+  DZ_ASSERT(keysizes || !n, "Caller must supply key sizes");
+  DZ_ASSERT(out_values || !n, "Caller must supply an output array");
+  if (!hm || !keys || !keysizes || !out_values) {
+    return;
+  }
+  // Keys can be in either table during an incremental resize
+  if (hm->old_ctrl) {
+    for (size_t i = 0; i < n; i++) {
+      out_values[i] = hm_get(hm, keys[i], keysizes[i]);
+    }
+    return;
+  }
+  for (size_t start = 0; start < n; start += HM_GET_MANY_BATCH) {
+    hm_get_batch(hm, &keys[start], &keysizes[start],
+                 min(n - start, (size_t)HM_GET_MANY_BATCH),
+                 &out_values[start]);
+  }
+}
+
+static uint64_t hm_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+// Moves every item into a fresh table of new_size slots. Items keep
+// their key/value allocations, and hashes are not recomputed.
+// Tombstones are dropped in the process. Does nothing if the items
+// would not fit under the growth limit of the new table, since probes
+// need EMPTY slots to end on.
+static void hm_resize(DzHashmap hm, const size_t new_size,
+                      DzHmError *error) {
   DZ_ASSERT(hm, "Caller must supply a hashmap");
-  if (new_size < HM_INIT_CAPACITY) {
+  hm_finish_migration(hm);
+  const size_t new_capacity = hm_capacity_normalize(new_size);
+  if (hm_growth_limit(new_capacity, hm->max_load_factor) <= hm->count) {
     return;
   }
   hm_error_set(error, DzHmError_None);
-  DzHashmap new_hm_buffer = hm_init_with_capacity(new_size, error);
-  if (hm_has_error(error)) {
+  const uint64_t start = hm_now_ns();
+  int8_t *new_ctrl = NULL;
+  DzHashmapSlot *new_slots = NULL;
+  if (!hm_table_alloc(hm, new_capacity, &new_ctrl, &new_slots)) {
+    hm_error_set(error, DzHmError_Memory);
     return;
   }
-  for (size_t i = 0; i < hm->count; i++) {
-    DzHashmapItem *old_item = hm->items[i];
-    if (old_item && old_item != &DELETED_ITEM) {
-      hm_add(new_hm_buffer, old_item->key, old_item->keysize,
-             old_item->value, old_item->valuesize, error);
-      if (hm_has_error(error)) {
-        DZ_ASSERT(!hm_has_error(error),
-                  "There was a problem adding an item");
-        hm_free(new_hm_buffer);
-        return;
-      }
+  for (size_t i = 0; i < hm->capacity; i++) {
+    if (!hm_ctrl_is_full(hm->ctrl[i])) {
+      continue;
     }
+    const DzHashmapSlot *old_slot = &hm->slots[i];
+    const size_t index = hm_internal_find_free(
+        new_ctrl, new_capacity, old_slot->hash);
+    new_ctrl[index] = hm_hash_h2(old_slot->hash);
+    new_slots[index] = *old_slot;
   }
-  DzHashmapItem **old_items = hm->items;
-  hm->items = new_hm_buffer->items;
-  new_hm_buffer->items = old_items;
+  hm_table_free(hm, hm->ctrl, hm->capacity);
+  hm->ctrl = new_ctrl;
+  hm->slots = new_slots;
+  hm->capacity = new_capacity;
+  hm->growth_limit =
+      hm_growth_limit(hm->capacity, hm->max_load_factor);
+  hm->tombstones = 0;
+  hm->resize_count++;
+  hm->rehash_ns += hm_now_ns() - start;
+}
 
-  size_t old_count = hm->count;
-  hm->count = new_hm_buffer->count;
-  new_hm_buffer->count = old_count;
+// Starts an incremental resize into a fresh table of new_size slots.
+// The current table becomes the old table, and its items are moved
+// over by the following operations. A new table of the same size drops
+// the tombstones of the old one, and counts as a rehash.
+// Returns false if the new table could not be allocated
+static bool hm_resize_incremental(DzHashmap hm, const size_t new_size,
+                                  DzHmError *error) {
+  hm_finish_migration(hm);
+  hm_error_set(error, DzHmError_None);
+  const uint64_t start = hm_now_ns();
+  const size_t new_capacity = hm_capacity_normalize(new_size);
+  int8_t *new_ctrl = NULL;
+  DzHashmapSlot *new_slots = NULL;
+  if (!hm_table_alloc(hm, new_capacity, &new_ctrl, &new_slots)) {
+    hm_error_set(error, DzHmError_Memory);
+    return false;
+  }
+  hm->old_ctrl = hm->ctrl;
+  hm->old_slots = hm->slots;
+  hm->old_capacity = hm->capacity;
+  hm->old_count = hm->count;
+  hm->migrate_index = 0;
+  hm->ctrl = new_ctrl;
+  hm->slots = new_slots;
+  hm->capacity = new_capacity;
+  hm->growth_limit =
+      hm_growth_limit(hm->capacity, hm->max_load_factor);
+  hm->tombstones = 0;
+  if (new_capacity == hm->old_capacity) {
+    hm->rehash_count++;
+  } else {
+    hm->resize_count++;
+  }
+  hm->rehash_ns += hm_now_ns() - start;
+  return true;
+}
 
-  size_t old_capacity = hm->capacity;
-  hm->capacity = new_hm_buffer->capacity;
-  new_hm_buffer->capacity = old_capacity;
+// Rehashes the table into itself, dropping every tombstone without
+// allocating. Every item is first marked DELETED, meaning "not placed
+// yet", and every tombstone EMPTY. Items are then moved to the first
+// free slot of their probe sequence, swapping with unplaced items.
+static void hm_rehash_in_place(DzHashmap hm) {
+  const uint64_t start = hm_now_ns();
+  int8_t *ctrl = hm->ctrl;
+  for (size_t i = 0; i < hm->capacity; i++) {
+    ctrl[i] =
+        hm_ctrl_is_full(ctrl[i]) ? HM_CTRL_DELETED : HM_CTRL_EMPTY;
+  }
+  for (size_t i = 0; i < hm->capacity; i++) {
+    if (ctrl[i] != HM_CTRL_DELETED) {
+      continue;
+    }
+    const uint64_t hash = hm->slots[i].hash;
+    const int8_t h2 = hm_hash_h2(hash);
+    const size_t target =
+        hm_internal_find_free(ctrl, hm->capacity, hash);
+    // Slot i is free to this item too, so target is in the same
+    // group or in an earlier group of its probe sequence
+    if (target / HM_GROUP_WIDTH == i / HM_GROUP_WIDTH) {
+      ctrl[i] = h2;
+      continue;
+    }
+    if (ctrl[target] == HM_CTRL_EMPTY) {
+      hm->slots[target] = hm->slots[i];
+      ctrl[target] = h2;
+      ctrl[i] = HM_CTRL_EMPTY;
+      continue;
+    }
+    // target holds an item that is not placed yet. Swap, and place
+    // the swapped item on the next pass over slot i
+    const DzHashmapSlot displaced = hm->slots[target];
+    hm->slots[target] = hm->slots[i];
+    hm->slots[i] = displaced;
+    ctrl[target] = h2;
+    i--;
+  }
+  hm->tombstones = 0;
+  hm->rehash_count++;
+  hm->rehash_ns += hm_now_ns() - start;
+}
 
-  hm_free(new_hm_buffer);
+// Makes room for one more item. When tombstones make up a good part
+// of the used slots, rehashing at the same size gets rid of them
+// without growing. Otherwise the table doubles.
+// Returns false if the table needed to grow, but could not
+static bool hm_make_room(DzHashmap hm, DzHmError *error) {
+  if (hm->count - hm->old_count + hm->tombstones <
+      hm->growth_limit) {
+    return true;
+  }
+  hm_finish_migration(hm);
+  if (hm->count * 4 <= hm->growth_limit * 3) {
+    // An in place rehash walks the whole table at once, so incremental
+    // maps migrate into a fresh table of the same size instead. That
+    // drops the tombstones a group per operation. It needs memory for
+    // a second table until it's done, and without it the map falls
+    // back on the in place rehash.
+    // The migration ends after capacity / HM_MIGRATE_SLOTS_PER_OP
+    // operations, long before the inserts in the meantime could fill
+    // the new table up to its growth limit again
+    if (!hm->incremental ||
+        !hm_resize_incremental(hm, hm->capacity, NULL)) {
+      hm_rehash_in_place(hm);
+    }
+    return true;
+  }
+  const size_t old_capacity = hm->capacity;
+  if (hm->incremental) {
+    hm_resize_incremental(hm, hm->capacity * 2, error);
+  } else {
+    hm_resize(hm, hm->capacity * 2, error);
+  }
+  return hm->capacity != old_capacity;
 }
 
-void hm_add(DzHashmap hm, const void *key, const size_t keysize,
-            const void *value, const size_t valuesize,
-            DzHmError *error) {
+void hm_set_inline_small_items(DzHashmap hm, const bool inline_small) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  if (!hm) {
+    return;
+  }
+  hm->inline_small = inline_small;
+}
+
+void hm_set_incremental_resize(DzHashmap hm, const bool incremental) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  if (!hm) {
+    return;
+  }
+  hm->incremental = incremental;
+  if (!incremental) {
+    hm_finish_migration(hm);
+  }
+}
+
+void hm_reserve(DzHashmap hm, const size_t n, DzHmError *error) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  if (!hm) {
+    hm_error_set(error, DzHmError_Argument);
+    return;
+  }
+  const size_t capacity =
+      hm_capacity_for_items(n, hm->max_load_factor);
+  if (capacity > hm->capacity) {
+    hm_resize(hm, capacity, error);
+  }
+}
+
+void hm_set_max_load_factor(DzHashmap hm,
+                            const double max_load_factor,
+                            DzHmError *error) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(max_load_factor > 0 && max_load_factor < 1,
+            "Load factor must be between 0 and 1");
+  if (!hm || !(max_load_factor > 0 && max_load_factor < 1)) {
+    hm_error_set(error, DzHmError_Argument);
+    return;
+  }
+  hm->max_load_factor = max_load_factor;
+  hm->growth_limit =
+      hm_growth_limit(hm->capacity, hm->max_load_factor);
+  // A lower load factor may mean the table is already over the limit
+  hm_reserve(hm, hm->count + hm->tombstones, error);
+}
+
+double hm_get_max_load_factor(DzHashmap hm) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  if (!hm) {
+    return 0;
+  }
+  return hm->max_load_factor;
+}
+
+DzHashmapSlot *hm_internal_insert(DzHashmap hm, const void *key,
+                                  const size_t keysize,
+                                  const uint64_t hash, const void *value,
+                                  const size_t valuesize,
+                                  DzHmError *error) {
+  // Tombstones lengthen probes just like items do, so they count
+  // towards the load
+  if (!hm_make_room(hm, error)) {
+    return NULL;
+  }
+  const size_t index =
+      hm_internal_find_free(hm->ctrl, hm->capacity, hash);
+  if (!hm_internal_slot_set(&hm->slab, &hm->slots[index],
+                            hm->inline_small, hash, key, keysize, value,
+                            valuesize)) {
+    hm_error_set(error, DzHmError_Memory);
+    return NULL;
+  }
+  if (hm->ctrl[index] == HM_CTRL_DELETED) {
+    hm->tombstones--;
+  }
+  hm->ctrl[index] = hm_hash_h2(hash);
+  hm->count++;
+  return &hm->slots[index];
+}
+
+DzHashmapSlot *hm_internal_put(DzHashmap hm, const void *key,
+                               const size_t keysize, const uint64_t hash,
+                               const void *value, const size_t valuesize,
+                               DzHmError *error) {
+  // Keys that haven't been moved by an incremental resize yet are
+  // updated where they are
+  DzHashmapSlot *existing = hm_internal_get_slot(hm, key, keysize, hash);
+  if (existing) {
+    if (!hm_internal_slot_replace(&hm->slab, existing,
+                                  hm->inline_small, hash, key, keysize,
+                                  value, valuesize)) {
+      hm_error_set(error, DzHmError_Memory);
+      return NULL;
+    }
+    return existing;
+  }
+  return hm_internal_insert(hm, key, keysize, hash, value, valuesize,
+                           error);
+}
+
+void hm_add_prehashed(DzHashmap hm, const void *key,
+                      const size_t keysize, const DzHmHash hash,
+                      const void *value, const size_t valuesize,
+                      DzHmError *error) {
   DZ_ASSERT(hm, "Caller must supply a hashmap");
   DZ_ASSERT(key, "Caller must supply a key");
   DZ_ASSERT(keysize, "Caller must supply a key");
   DZ_ASSERT(value, "Caller must supply a value");
   DZ_ASSERT(valuesize, "Caller must supply a value");
-  DZ_ASSERT(keysize < MAX_KEY_SIZE, "Key is too large");
+  DZ_ASSERT(keysize <= MAX_KEY_SIZE, "Key is too large");
+  DZ_ASSERT(valuesize <= MAX_VALUE_SIZE, "Value is too large");
+  DZ_ASSERT(!hm || !key || hash == hm_internal_hash(hm, key, keysize),
+            "Hash must come from hm_hash on the same hashmap");
   if (!hm || !key || !value || !valuesize || !keysize) {
     hm_error_set(error, DzHmError_Memory);
     return;
   }
-  if (hm->capacity * HM_RESIZE_UP_THRESHOLD <= hm->count) {
-    hm_resize(hm, prime_find_next(hm->capacity), error);
-    if (hm_has_error(error)) {
-      return;
-    }
+  if (keysize > MAX_KEY_SIZE || valuesize > MAX_VALUE_SIZE) {
+    hm_error_set(error, DzHmError_Argument);
+    return;
+  }
+  hm_internal_put(hm, key, keysize, hash, value, valuesize, error);
+}
+
+void hm_add(DzHashmap hm, const void *key, const size_t keysize,
+            const void *value, const size_t valuesize,
+            DzHmError *error) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!hm || !key) {
+    hm_error_set(error, DzHmError_Memory);
+    return;
+  }
+  hm_add_prehashed(hm, key, keysize, hm_internal_hash(hm, key, keysize),
+                   value, valuesize, error);
+}
+
+void *hm_get_or_insert(DzHashmap hm, const void *key,
+                       const size_t keysize, const size_t valuesize,
+                       bool *inserted, DzHmError *error) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  DZ_ASSERT(keysize, "Caller must supply a key");
+  DZ_ASSERT(valuesize, "Caller must supply a value size");
+  DZ_ASSERT(keysize <= MAX_KEY_SIZE, "Key is too large");
+  DZ_ASSERT(valuesize <= MAX_VALUE_SIZE, "Value is too large");
+  if (inserted) {
+    *inserted = false;
   }
-  DzHashmapItem *item =
-      hm_item_create(key, value, keysize, valuesize);
-  size_t index = hm_internal_get_index_hash(
-      key, keysize, hm->capacity, 0, hm->salt);
-  DzHashmapItem *current_item = hm->items[index];
-  size_t i = 1;
-  ssize_t last_index = -1;
-  size_t attempt = 0;
-  while (current_item != NULL && current_item != &DELETED_ITEM) {
-    if (mem_eq(current_item->key, key, current_item->keysize,
-               keysize)) {
-      hm_item_free(current_item);
-      hm->items[index] = item;
-      return;
+  if (!hm || !key || !keysize || !valuesize) {
+    hm_error_set(error, DzHmError_Argument);
+    return NULL;
+  }
+  if (keysize > MAX_KEY_SIZE || valuesize > MAX_VALUE_SIZE) {
+    hm_error_set(error, DzHmError_Argument);
+    return NULL;
+  }
+  hm_error_set(error, DzHmError_None);
+  const uint64_t hash = hm_internal_hash(hm, key, keysize);
+  DzHashmapSlot *slot = hm_internal_get_slot(hm, key, keysize, hash);
+  if (!slot) {
+    slot = hm_internal_insert(hm, key, keysize, hash, NULL, valuesize,
+                              error);
+    if (!slot) {
+      return NULL;
+    }
+    if (inserted) {
+      *inserted = true;
     }
-    index = hm_internal_get_index_hash(key, keysize, hm->capacity, i,
-                                       hm->salt);
-    last_index = index;
-    current_item = hm->items[index];
-    i++;
   }
-  hm->items[index] = item;
-  hm->count++;
+  return hm_slot_bytes(slot) + slot->keysize;
 }
 
-void hm_delete(DzHashmap hm, const void *key, const size_t keysize) {
+bool hm_update(DzHashmap hm, const void *key, const size_t keysize,
+               const void *value, const size_t valuesize,
+               DzHmError *error) {
   DZ_ASSERT(hm, "Caller must supply a hashmap");
   DZ_ASSERT(key, "Caller must supply a key");
   DZ_ASSERT(keysize, "Caller must supply a key");
+  DZ_ASSERT(value, "Caller must supply a value");
+  DZ_ASSERT(valuesize, "Caller must supply a value");
+  DZ_ASSERT(valuesize <= MAX_VALUE_SIZE, "Value is too large");
+  if (!hm || !key || !keysize || !value || !valuesize ||
+      valuesize > MAX_VALUE_SIZE) {
+    hm_error_set(error, DzHmError_Argument);
+    return false;
+  }
+  hm_error_set(error, DzHmError_None);
+  DzHashmapSlot *slot = hm_internal_get_slot(
+      hm, key, keysize, hm_internal_hash(hm, key, keysize));
+  if (!slot) {
+    return false;
+  }
+  if (slot->valuesize == valuesize) {
+    memcpy(hm_slot_bytes(slot) + slot->keysize, value, valuesize);
+    return true;
+  }
+  if (!hm_internal_slot_replace(&hm->slab, slot, hm->inline_small,
+                                slot->hash, key, keysize, value,
+                                valuesize)) {
+    hm_error_set(error, DzHmError_Memory);
+    return false;
+  }
+  return true;
+}
+
+void hm_delete_prehashed(DzHashmap hm, const void *key,
+                         const size_t keysize, const DzHmHash hash) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  DZ_ASSERT(keysize, "Caller must supply a key");
+  DZ_ASSERT(!hm || !key || hash == hm_internal_hash(hm, key, keysize),
+            "Hash must come from hm_hash on the same hashmap");
   if (!hm || !key || !keysize) {
     return;
   }
-  size_t index = hm_internal_get_index_hash(
-      key, keysize, hm->capacity, 0, hm->salt);
-  DzHashmapItem *current_item = hm->items[index];
-  size_t i = 1;
-  while (current_item != NULL) {
-    if (mem_eq(current_item->key, key, current_item->keysize,
-               keysize)) {
-      hm_item_free(current_item);
-      hm->items[index] = &DELETED_ITEM;
+  if (hm->old_ctrl) {
+    hm_migrate_step(hm);
+  }
+  const size_t index = hm_internal_find(hm, key, keysize, hash);
+  if (index == hm->capacity) {
+    // The old table is dropped whole once it's empty, so it doesn't
+    // need to track its tombstones
+    const size_t old_index =
+        hm_internal_find_old(hm, key, keysize, hash);
+    if (old_index != hm->old_capacity) {
+      hm_slot_free(&hm->slab, &hm->old_slots[old_index]);
+      hm->old_ctrl[old_index] = HM_CTRL_DELETED;
+      hm->old_count--;
       hm->count--;
-      break;
     }
-    index = hm_internal_get_index_hash(key, keysize, hm->capacity, i,
-                                       hm->salt);
-    current_item = hm->items[index];
-    i++;
+    return;
+  }
+  hm_slot_free(&hm->slab, &hm->slots[index]);
+  // Probes stop at the first group with an EMPTY slot, and a group
+  // that has ever been full never gets an EMPTY slot back. So if the
+  // group still has one, no probe ever went past this group, and the
+  // slot can be emptied without leaving a tombstone.
+  const size_t group = index - index % HM_GROUP_WIDTH;
+  if (hm_group_match_empty(&hm->ctrl[group])) {
+    hm->ctrl[index] = HM_CTRL_EMPTY;
+  } else {
+    hm->ctrl[index] = HM_CTRL_DELETED;
+    hm->tombstones++;
+  }
+  hm->count--;
+}
+
+void hm_delete(DzHashmap hm, const void *key, const size_t keysize) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!hm || !key) {
+    return;
   }
+  hm_delete_prehashed(hm, key, keysize,
+                      hm_internal_hash(hm, key, keysize));
 }
 
 size_t hm_count(DzHashmap hm) {
@@ -323,10 +967,155 @@ size_t hm_count(DzHashmap hm) {
   return hm->count;
 }
 
+DzHmIter hm_iter_begin(DzHashmap hm) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DzHmIter it;
+  memset(&it, 0, sizeof(it));
+  it.hm = hm;
+  if (hm) {
+    hm_finish_migration(hm);
+  }
+  return it;
+}
+
+bool hm_iter_next(DzHmIter *it) {
+  DZ_ASSERT(it, "Caller must supply an iterator");
+  if (!it || !it->hm) {
+    return false;
+  }
+  const DzHashmap hm = it->hm;
+  DZ_ASSERT(!hm->old_ctrl, "Hashmap changed during iteration");
+  while (it->index < hm->capacity) {
+    const size_t base = it->index - it->index % HM_GROUP_WIDTH;
+    // Drop the slots of the group that were already visited
+    const uint32_t mask = hm_group_match_full(&hm->ctrl[base]) &
+                          (~0u << (it->index - base));
+    if (!mask) {
+      it->index = base + HM_GROUP_WIDTH;
+      continue;
+    }
+    const size_t index = base + hm_mask_first(mask);
+    const DzHashmapSlot *slot = &hm->slots[index];
+    const char *bytes = hm_slot_bytes(slot);
+    it->key = bytes;
+    it->keysize = slot->keysize;
+    it->value = bytes + slot->keysize;
+    it->valuesize = slot->valuesize;
+    it->index = index + 1;
+    return true;
+  }
+  return false;
+}
+
+size_t hm_export(DzHashmap hm, DzHmSpan **keys_arr,
+                 DzHmSpan **values_arr) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  if (!hm) {
+    return 0;
+  }
+  // The dz_arr macros need plain array variables
+  DZArray(DzHmSpan) keys = keys_arr ? *keys_arr : NULL;
+  DZArray(DzHmSpan) values = values_arr ? *values_arr : NULL;
+  if (keys_arr) {
+    dz_arrreserve(keys, dz_arrlen(keys) + hm->count);
+  }
+  if (values_arr) {
+    dz_arrreserve(values, dz_arrlen(values) + hm->count);
+  }
+  DzHmIter it = hm_iter_begin(hm);
+  while (hm_iter_next(&it)) {
+    if (keys) {
+      const DzHmSpan key = {it.key, it.keysize};
+      dz_arrpush(keys, key);
+    }
+    if (values) {
+      const DzHmSpan value = {it.value, it.valuesize};
+      dz_arrpush(values, value);
+    }
+  }
+  if (keys_arr) {
+    *keys_arr = keys;
+  }
+  if (values_arr) {
+    *values_arr = values;
+  }
+  return hm->count;
+}
+
+// Adds the items of one table to the probe and byte counts of out
+static void hm_table_stats(const int8_t *ctrl, const DzHashmapSlot *slots,
+                           const size_t capacity, DzHmStats *out) {
+  for (size_t i = 0; i < capacity; i++) {
+    if (!hm_ctrl_is_full(ctrl[i])) {
+      continue;
+    }
+    const DzHashmapSlot *slot = &slots[i];
+    size_t length = 1;
+    for (DzHmProbe probe = hm_internal_probe_start(slot->hash, capacity);
+         probe.group != i / HM_GROUP_WIDTH;
+         hm_internal_probe_next(&probe)) {
+      length++;
+    }
+    out->probe_histogram[min(length, (size_t)HM_STATS_PROBE_BUCKETS) -
+                         1]++;
+    out->max_probe_length = max(out->max_probe_length, length);
+    out->avg_probe_length += length;
+    out->key_bytes += slot->keysize;
+    out->value_bytes += slot->valuesize;
+  }
+  out->metadata_bytes += capacity + capacity * sizeof(DzHashmapSlot);
+}
+
+void hm_stats(DzHashmap hm, DzHmStats *out) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(out, "Caller must supply a stats struct");
+  if (!hm || !out) {
+    return;
+  }
+  memset(out, 0, sizeof(*out));
+  out->capacity = hm->capacity + hm->old_capacity;
+  out->count = hm->count;
+  out->tombstones = hm->tombstones;
+  out->load_factor =
+      (double)(hm->count + hm->tombstones) / out->capacity;
+  hm_table_stats(hm->ctrl, hm->slots, hm->capacity, out);
+  if (hm->old_ctrl) {
+    hm_table_stats(hm->old_ctrl, hm->old_slots, hm->old_capacity, out);
+  }
+  if (hm->count) {
+    out->avg_probe_length /= hm->count;
+  }
+  out->metadata_bytes += sizeof(*hm);
+  out->resize_count = hm->resize_count;
+  out->rehash_count = hm->rehash_count;
+  out->rehash_ns = hm->rehash_ns;
+  out->counters_enabled = HM_COUNTERS_ENABLED;
+  out->finds = HM_COUNTER_GET(&hm->counters, finds);
+  out->find_hits = HM_COUNTER_GET(&hm->counters, find_hits);
+  out->find_groups = HM_COUNTER_GET(&hm->counters, find_groups);
+}
+
 const char *hm_get_str(DzHashmap hm, const char *key) {
   return (char *)hm_get(hm, key, strlen(key) + 1);
 }
 
+void hm_get_many_str(DzHashmap hm, const char *const keys[],
+                     const size_t n, const char *out_values[]) {
+  DZ_ASSERT(keys || !n, "Caller must supply keys");
+  if (!keys) {
+    return;
+  }
+  size_t keysizes[HM_GET_MANY_BATCH];
+  for (size_t start = 0; start < n; start += HM_GET_MANY_BATCH) {
+    const size_t batch = min(n - start, (size_t)HM_GET_MANY_BATCH);
+    for (size_t i = 0; i < batch; i++) {
+      keysizes[i] = strlen(keys[start + i]) + 1;
+    }
+    hm_get_many(hm, (const void *const *)&keys[start], keysizes,
+                batch, (const void **)&out_values[start]);
+  }
+}
+
 void hm_add_str(DzHashmap hm, const char *key, const char *value,
                 DzHmError *error) {
   hm_add(hm, key, strlen(key) + 1, value, strlen(value) + 1, error);
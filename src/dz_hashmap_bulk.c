@@ -0,0 +1,337 @@
+#include "dz_hashmap_bulk.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dz_array.h"
+#include "dz_debug.h"
+#include "dz_hash.h"
+#include "dz_hashmap_group.h"
+#include "dz_hashmap_internal.h"
+
+// Partitioning
+// A partition is a run of consecutive groups of the table, and an item
+// belongs to the partition holding the first group of its probe
+// sequence. Every thread owns whole partitions, and only ever writes
+// to their groups, so threads never touch the same slot. An item can
+// only be placed by its owner while its probe sequence stays inside
+// its partition. When the probe would step out, the item is deferred,
+// and added by the calling thread once every partition is filled.
+// Probes are short at the default load factor, so only the items
+// hashing near the end of a partition are ever deferred.
+
+// Partitions per thread. Several per thread evens out the work when
+// the keys don't spread evenly
+#define HM_BULK_PARTITIONS_PER_THREAD 8
+// Items per thread below which extra threads cost more than they save
+#define HM_BULK_MIN_ITEMS_PER_THREAD 4096
+
+typedef struct DzHmBulkEntry {
+  uint64_t hash;
+  size_t index;  // Of the pair in the input arrays
+} DzHmBulkEntry;
+
+typedef struct DzHmBulkShared {
+  const void *const *keys;
+  const size_t *keysizes;
+  const void *const *values;
+  const size_t *valuesizes;
+  size_t n;
+  size_t nthreads;
+  DzHashmap hm;
+  uint64_t *hashes;
+  DzHmBulkEntry *entries;  // Input order within each partition
+  size_t *counts;          // nthreads x partitions, then offsets
+  size_t partitions;       // A power of two
+  unsigned partition_shift;  // Group index >> shift is its partition
+} DzHmBulkShared;
+
+typedef struct DzHmBulkThread {
+  DzHmBulkShared *shared;
+  size_t id;
+  void (*run)(struct DzHmBulkThread *);
+  pthread_t thread;
+  DZSlab slab;  // Holds the items this thread placed
+  size_t count;  // Items this thread placed
+  DZArray(size_t) deferred;  // Input indexes, in input order
+  bool failed;
+  bool invalid;  // Its slice of the input holds a pair hm_add rejects
+} DzHmBulkThread;
+
+static void hm_bulk_error_set(DzHmError *error_ref, DzHmError value) {
+  if (error_ref) {
+    *error_ref = value;
+  }
+}
+
+// The input pairs [*start, *end) handled by thread id
+static void hm_bulk_range(const DzHmBulkShared *shared, const size_t id,
+                          size_t *start, size_t *end) {
+  *start = shared->n * id / shared->nthreads;
+  *end = shared->n * (id + 1) / shared->nthreads;
+}
+
+static size_t hm_bulk_partition_of(const DzHmBulkShared *shared,
+                                   const uint64_t hash) {
+  const DzHmProbe probe =
+      hm_internal_probe_start(hash, shared->hm->capacity);
+  return probe.group >> shared->partition_shift;
+}
+
+// Pass 1: checks and hashes a slice of the input, and counts its items
+// per partition. Stops at the first pair hm_add would reject
+static void hm_bulk_hash(DzHmBulkThread *self) {
+  DzHmBulkShared *shared = self->shared;
+  size_t *counts = &shared->counts[self->id * shared->partitions];
+  size_t start, end;
+  hm_bulk_range(shared, self->id, &start, &end);
+  for (size_t i = start; i < end; i++) {
+    if (!shared->keys[i] || !shared->keysizes[i] ||
+        shared->keysizes[i] > HM_MAX_KEY_SIZE ||
+        shared->valuesizes[i] > HM_MAX_VALUE_SIZE) {
+      self->invalid = true;
+      return;
+    }
+    const uint64_t hash = dz_hash_bytes(
+        shared->keys[i], shared->keysizes[i], shared->hm->salt);
+    shared->hashes[i] = hash;
+    counts[hm_bulk_partition_of(shared, hash)]++;
+  }
+}
+
+// Pass 2: copies the same slice into its place in the partitions. The
+// counts now hold where each partition's items of the slice start
+static void hm_bulk_scatter(DzHmBulkThread *self) {
+  DzHmBulkShared *shared = self->shared;
+  size_t *offsets = &shared->counts[self->id * shared->partitions];
+  size_t start, end;
+  hm_bulk_range(shared, self->id, &start, &end);
+  for (size_t i = start; i < end; i++) {
+    const uint64_t hash = shared->hashes[i];
+    DzHmBulkEntry *entry =
+        &shared->entries[offsets[hm_bulk_partition_of(shared, hash)]++];
+    entry->hash = hash;
+    entry->index = i;
+  }
+}
+
+// Adds one item to the partition of groups [first, last). Returns
+// false if it has to be deferred
+static bool hm_bulk_place(DzHmBulkThread *self, const size_t first,
+                          const size_t last,
+                          const DzHmBulkEntry *entry) {
+  const DzHmBulkShared *shared = self->shared;
+  DzHashmap hm = shared->hm;
+  const uint64_t hash = entry->hash;
+  const void *key = shared->keys[entry->index];
+  const size_t keysize = shared->keysizes[entry->index];
+  const void *value =
+      shared->values ? shared->values[entry->index] : NULL;
+  const size_t valuesize = shared->valuesizes[entry->index];
+  const int8_t h2 = hm_hash_h2(hash);
+  DzHmProbe probe = hm_internal_probe_start(hash, hm->capacity);
+  while (probe.group >= first && probe.group < last) {
+    const size_t base = probe.group * HM_GROUP_WIDTH;
+    const int8_t *group = &hm->ctrl[base];
+    for (uint32_t mask = hm_group_match(group, h2); mask;
+         mask &= mask - 1) {
+      DzHashmapSlot *slot = &hm->slots[base + hm_mask_first(mask)];
+      if (hm_slot_key_eq(slot, hash, key, keysize)) {
+        self->failed |= !hm_internal_slot_replace(
+            &self->slab, slot, hm->inline_small, hash, key, keysize,
+            value, valuesize);
+        return true;
+      }
+    }
+    // Nothing is ever deleted here, so the first group with an EMPTY
+    // slot ends the search, and is also where the key goes
+    const uint32_t empty = hm_group_match_empty(group);
+    if (empty) {
+      const size_t index = base + hm_mask_first(empty);
+      if (!hm_internal_slot_set(&self->slab, &hm->slots[index],
+                                hm->inline_small, hash, key, keysize,
+                                value, valuesize)) {
+        self->failed = true;
+        return true;
+      }
+      hm->ctrl[index] = h2;
+      self->count++;
+      return true;
+    }
+    hm_internal_probe_next(&probe);
+  }
+  return false;
+}
+
+// Pass 3: fills every partition owned by the thread
+static void hm_bulk_fill(DzHmBulkThread *self) {
+  DzHmBulkShared *shared = self->shared;
+  const size_t groups = (size_t)1 << shared->partition_shift;
+  for (size_t p = self->id; p < shared->partitions && !self->failed;
+       p += shared->nthreads) {
+    // After pass 2, the offset of the last slice of partition p is
+    // where the items of partition p + 1 start
+    const size_t *ends = &shared->counts[(shared->nthreads - 1) *
+                                         shared->partitions];
+    const size_t start = p ? ends[p - 1] : 0;
+    for (size_t i = start; i < ends[p]; i++) {
+      if (!hm_bulk_place(self, p * groups, (p + 1) * groups,
+                         &shared->entries[i])) {
+        dz_arrpush(self->deferred, shared->entries[i].index);
+      }
+    }
+  }
+}
+
+static void *hm_bulk_thread_main(void *arg) {
+  DzHmBulkThread *self = (DzHmBulkThread *)arg;
+  self->run(self);
+  return NULL;
+}
+
+// Runs run on every thread, the calling thread being thread 0, and
+// waits for all of them. The work of threads that could not be started
+// is done by the calling thread, which is safe because no thread
+// waits on another within a pass
+static void hm_bulk_run(DzHmBulkThread *threads, const size_t nthreads,
+                        void (*run)(DzHmBulkThread *)) {
+  size_t started = 1;
+  for (; started < nthreads; started++) {
+    threads[started].run = run;
+    if (pthread_create(&threads[started].thread, NULL,
+                       hm_bulk_thread_main, &threads[started])) {
+      break;
+    }
+  }
+  run(&threads[0]);
+  for (size_t t = started; t < nthreads; t++) {
+    run(&threads[t]);
+  }
+  for (size_t t = 1; t < started; t++) {
+    pthread_join(threads[t].thread, NULL);
+  }
+}
+
+// Turns the per thread counts of pass 1 into the offsets where every
+// thread's items of every partition start: partition by partition,
+// and by thread within a partition, which keeps input order
+static void hm_bulk_offsets(DzHmBulkShared *shared) {
+  size_t offset = 0;
+  for (size_t p = 0; p < shared->partitions; p++) {
+    for (size_t t = 0; t < shared->nthreads; t++) {
+      size_t *count = &shared->counts[t * shared->partitions + p];
+      const size_t next = offset + *count;
+      *count = offset;
+      offset = next;
+    }
+  }
+}
+
+static size_t hm_bulk_thread_count(size_t nthreads, const size_t n) {
+  if (!nthreads) {
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = cores > 0 ? (size_t)cores : 1;
+  }
+  return max(min(nthreads, n / HM_BULK_MIN_ITEMS_PER_THREAD), 1);
+}
+
+DzHashmap hm_build_bulk(const void *const keys[],
+                        const size_t keysizes[],
+                        const void *const values[],
+                        const size_t valuesizes[], const size_t n,
+                        const size_t nthreads, DzHmError *error) {
+  DZ_ASSERT(!n || (keys && keysizes && valuesizes),
+            "Caller must supply keys and value sizes");
+  if (n && (!keys || !keysizes || !valuesizes)) {
+    hm_bulk_error_set(error, DzHmError_Argument);
+    return NULL;
+  }
+  hm_bulk_error_set(error, DzHmError_None);
+  DzHashmap hm = hm_init_with_capacity(n, error);
+  if (!hm || !n) {
+    return hm;
+  }
+  DzHmBulkShared shared;
+  memset(&shared, 0, sizeof(shared));
+  shared.keys = keys;
+  shared.keysizes = keysizes;
+  shared.values = values;
+  shared.valuesizes = valuesizes;
+  shared.n = n;
+  shared.nthreads = hm_bulk_thread_count(nthreads, n);
+  shared.hm = hm;
+  const size_t groups = hm->capacity / HM_GROUP_WIDTH;
+  shared.partitions = 1;
+  while (shared.partitions <
+             shared.nthreads * HM_BULK_PARTITIONS_PER_THREAD &&
+         shared.partitions < groups) {
+    shared.partitions *= 2;
+  }
+  while (((size_t)1 << shared.partition_shift) * shared.partitions <
+         groups) {
+    shared.partition_shift++;
+  }
+  shared.hashes = (uint64_t *)malloc(n * sizeof(uint64_t));
+  shared.entries = (DzHmBulkEntry *)malloc(n * sizeof(DzHmBulkEntry));
+  shared.counts = (size_t *)calloc(shared.nthreads * shared.partitions,
+                                   sizeof(size_t));
+  DzHmBulkThread *threads = (DzHmBulkThread *)calloc(
+      shared.nthreads, sizeof(DzHmBulkThread));
+  bool ok = shared.hashes && shared.entries && shared.counts && threads;
+  DZ_ASSERT(ok, "Malloc on bulk build failed");
+  DzHmError failure = DzHmError_Memory;
+  if (ok) {
+    for (size_t t = 0; t < shared.nthreads; t++) {
+      threads[t].shared = &shared;
+      threads[t].id = t;
+      threads[t].slab = dz_slab_init(0);
+    }
+    hm_bulk_run(threads, shared.nthreads, hm_bulk_hash);
+    for (size_t t = 0; t < shared.nthreads; t++) {
+      if (threads[t].invalid) {
+        ok = false;
+        failure = DzHmError_Argument;
+      }
+    }
+  }
+  if (ok) {
+    hm_bulk_offsets(&shared);
+    hm_bulk_run(threads, shared.nthreads, hm_bulk_scatter);
+  }
+  free(shared.hashes);
+  if (ok) {
+    hm_bulk_run(threads, shared.nthreads, hm_bulk_fill);
+  }
+  // Every slab is merged, even on failure, so hm_free releases the
+  // items that were placed
+  for (size_t t = 0; threads && t < shared.nthreads; t++) {
+    ok &= !threads[t].failed;
+    hm->count += threads[t].count;
+    dz_slab_merge(&hm->slab, &threads[t].slab);
+  }
+  // Deferred items go through the normal path. A key's deferred
+  // pairs were all seen by one thread, in input order
+  for (size_t t = 0; ok && t < shared.nthreads; t++) {
+    for (size_t i = 0; ok && i < dz_arrlen(threads[t].deferred); i++) {
+      const size_t index = threads[t].deferred[i];
+      const uint64_t hash =
+          dz_hash_bytes(keys[index], keysizes[index], hm->salt);
+      ok = hm_internal_put(hm, keys[index], keysizes[index], hash,
+                           values ? values[index] : NULL,
+                           valuesizes[index], error) != NULL;
+    }
+  }
+  for (size_t t = 0; threads && t < shared.nthreads; t++) {
+    dz_arrfree(threads[t].deferred);
+  }
+  free(threads);
+  free(shared.entries);
+  free(shared.counts);
+  if (!ok) {
+    hm_bulk_error_set(error, failure);
+    hm_free(hm);
+    return NULL;
+  }
+  return hm;
+}
@@ -0,0 +1,243 @@
+#include "dz_hashmap_cache.h"
+
+#include <string.h>
+
+#include "dz_debug.h"
+#include "dz_hashmap_group.h"
+#include "dz_hashmap_internal.h"
+
+typedef struct DzHmCacheInstance {
+  DzHashmap hm;
+  size_t max_entries;  // 0 for no limit
+  size_t max_bytes;    // 0 for no limit
+  size_t bytes;        // Keys and values of every item
+  size_t hand;         // Next slot the CLOCK hand looks at
+  DzHmCacheEvictFn evict;
+  void *user;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} DzHmCacheInstance;
+
+static void hm_cache_error_set(DzHmError *error_ref, DzHmError value) {
+  if (error_ref) {
+    *error_ref = value;
+  }
+}
+
+static inline size_t hm_cache_item_size(const DzHashmapSlot *slot) {
+  return (size_t)slot->keysize + slot->valuesize;
+}
+
+// True if entries items, taking bytes bytes, are over a limit
+static inline bool hm_cache_over(const DzHmCache cache,
+                                 const size_t entries,
+                                 const size_t bytes) {
+  return (cache->max_entries && entries > cache->max_entries) ||
+         (cache->max_bytes && bytes > cache->max_bytes);
+}
+
+// Moves the hand to the next item that wasn't used since the hand
+// last passed it, clearing the bit of every used item on the way,
+// and evicts it. The item in slot keep is never evicted, pass
+// hm->capacity to allow any. The cache must hold another item
+static void hm_cache_evict_one(DzHmCache cache, const size_t keep) {
+  DzHashmap hm = cache->hm;
+  DZ_ASSERT(hm->count > (keep < hm->capacity),
+            "Cannot evict from an empty cache");
+  DZ_ASSERT(!hm->old_ctrl, "Caches never resize incrementally");
+  while (true) {
+    if (cache->hand >= hm->capacity) {
+      cache->hand = 0;
+    }
+    const size_t index = cache->hand++;
+    if (index == keep || !hm_ctrl_is_full(hm->ctrl[index])) {
+      continue;
+    }
+    DzHashmapSlot *slot = &hm->slots[index];
+    if (slot->referenced) {
+      slot->referenced = false;
+      continue;
+    }
+    const char *bytes = hm_slot_bytes(slot);
+    if (cache->evict) {
+      cache->evict(bytes, slot->keysize, bytes + slot->keysize,
+                   slot->valuesize, cache->user);
+    }
+    cache->bytes -= hm_cache_item_size(slot);
+    cache->evictions++;
+    hm_delete_prehashed(hm, bytes, slot->keysize, slot->hash);
+    return;
+  }
+}
+
+DzHmCache hm_cache_init(const size_t max_entries, const size_t max_bytes,
+                        DzHmError *error) {
+  DZ_ASSERT(max_entries || max_bytes, "Cache must have a limit");
+  if (!max_entries && !max_bytes) {
+    hm_cache_error_set(error, DzHmError_Argument);
+    return NULL;
+  }
+  hm_cache_error_set(error, DzHmError_None);
+  DzHmCache cache =
+      (DzHmCache)calloc(1, sizeof(struct DzHmCacheInstance));
+  DZ_ASSERT(cache, "Malloc on cache failed");
+  if (!cache) {
+    hm_cache_error_set(error, DzHmError_Memory);
+    return NULL;
+  }
+  // With an entry limit the table never needs to grow
+  cache->hm = max_entries ? hm_init_with_capacity(max_entries, error)
+                          : hm_init(error);
+  if (!cache->hm) {
+    free(cache);
+    return NULL;
+  }
+  cache->max_entries = max_entries;
+  cache->max_bytes = max_bytes;
+  return cache;
+}
+
+void hm_cache_free(DzHmCache cache) {
+  DZ_ASSERT(cache);
+  if (!cache) {
+    return;
+  }
+  hm_free(cache->hm);
+  free(cache);
+}
+
+void hm_cache_set_evict_callback(DzHmCache cache,
+                                 const DzHmCacheEvictFn evict,
+                                 void *user) {
+  DZ_ASSERT(cache, "Caller must supply a cache");
+  if (!cache) {
+    return;
+  }
+  cache->evict = evict;
+  cache->user = user;
+}
+
+const void *hm_cache_get(DzHmCache cache, const void *key,
+                         const size_t keysize, size_t *valuesize) {
+  DZ_ASSERT(cache, "Caller must supply a cache");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!cache || !key || !keysize) {
+    return NULL;
+  }
+  DzHashmapSlot *slot = hm_internal_get_slot(
+      cache->hm, key, keysize, hm_hash(cache->hm, key, keysize));
+  if (!slot) {
+    cache->misses++;
+    return NULL;
+  }
+  cache->hits++;
+  slot->referenced = true;
+  if (valuesize) {
+    *valuesize = slot->valuesize;
+  }
+  return hm_slot_bytes(slot) + slot->keysize;
+}
+
+const char *hm_cache_get_str(DzHmCache cache, const char *key) {
+  return (const char *)hm_cache_get(cache, key, strlen(key) + 1, NULL);
+}
+
+void hm_cache_put(DzHmCache cache, const void *key, const size_t keysize,
+                  const void *value, const size_t valuesize,
+                  DzHmError *error) {
+  DZ_ASSERT(cache, "Caller must supply a cache");
+  DZ_ASSERT(key, "Caller must supply a key");
+  DZ_ASSERT(value, "Caller must supply a value");
+  if (!cache || !key || !keysize || !value || !valuesize) {
+    hm_cache_error_set(error, DzHmError_Argument);
+    return;
+  }
+  const size_t size = keysize + valuesize;
+  if (cache->max_bytes && size > cache->max_bytes) {
+    hm_cache_error_set(error, DzHmError_Argument);
+    return;
+  }
+  hm_cache_error_set(error, DzHmError_None);
+  DzHashmap hm = cache->hm;
+  const uint64_t hash = hm_hash(hm, key, keysize);
+  DzHashmapSlot *slot = hm_internal_get_slot(hm, key, keysize, hash);
+  const bool existing = slot != NULL;
+  const size_t old_size = existing ? hm_cache_item_size(slot) : 0;
+  if (existing) {
+    // A failed overwrite leaves the old item in place
+    if (!hm_internal_slot_replace(&hm->slab, slot, hm->inline_small,
+                                  hash, key, keysize, value,
+                                  valuesize)) {
+      hm_cache_error_set(error, DzHmError_Memory);
+      return;
+    }
+  } else {
+    while (hm->count &&
+           hm_cache_over(cache, hm->count + 1, cache->bytes + size)) {
+      hm_cache_evict_one(cache, hm->capacity);
+    }
+    slot = hm_internal_insert(hm, key, keysize, hash, value, valuesize,
+                              error);
+    if (!slot) {
+      return;
+    }
+  }
+  cache->bytes = cache->bytes - old_size + size;
+  // New items have to be read once to survive the next sweep, so a
+  // burst of keys that are never read again can't push out the hot
+  // ones. Overwritten items count as used. An overwrite can only go
+  // over the byte limit, and the item just written is never evicted
+  // to get back under it, since it fits alone
+  slot->referenced = existing;
+  const size_t index = (size_t)(slot - hm->slots);
+  while (hm_cache_over(cache, hm->count, cache->bytes)) {
+    hm_cache_evict_one(cache, index);
+  }
+}
+
+void hm_cache_put_str(DzHmCache cache, const char *key,
+                      const char *value, DzHmError *error) {
+  hm_cache_put(cache, key, strlen(key) + 1, value, strlen(value) + 1,
+               error);
+}
+
+void hm_cache_delete(DzHmCache cache, const void *key,
+                     const size_t keysize) {
+  DZ_ASSERT(cache, "Caller must supply a cache");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!cache || !key || !keysize) {
+    return;
+  }
+  const uint64_t hash = hm_hash(cache->hm, key, keysize);
+  const DzHashmapSlot *slot =
+      hm_internal_get_slot(cache->hm, key, keysize, hash);
+  if (!slot) {
+    return;
+  }
+  cache->bytes -= hm_cache_item_size(slot);
+  hm_delete_prehashed(cache->hm, key, keysize, hash);
+}
+
+size_t hm_cache_count(DzHmCache cache) {
+  DZ_ASSERT(cache, "Caller must supply a cache");
+  if (!cache) {
+    return 0;
+  }
+  return hm_count(cache->hm);
+}
+
+void hm_cache_stats(DzHmCache cache, DzHmCacheStats *out) {
+  DZ_ASSERT(cache, "Caller must supply a cache");
+  DZ_ASSERT(out, "Caller must supply a stats struct");
+  if (!cache || !out) {
+    return;
+  }
+  out->count = hm_count(cache->hm);
+  out->bytes = cache->bytes;
+  out->hits = cache->hits;
+  out->misses = cache->misses;
+  out->evictions = cache->evictions;
+  const uint64_t lookups = cache->hits + cache->misses;
+  out->hit_rate = lookups ? (double)cache->hits / lookups : 0;
+}
@@ -0,0 +1,403 @@
+#include "dz_hashmap_frozen.h"
+
+#include <string.h>
+
+#include "dz_debug.h"
+#include "dz_hash.h"
+#include "dz_hashmap_group.h"
+#include "dz_hashmap_internal.h"
+
+// Perfect hashing
+// Hash and displace (as in CHD): keys are split into buckets of about
+// HM_FROZEN_BUCKET_SIZE keys by their hash. Each bucket gets a
+// "pilot", picked at build time so that
+//   slot = reduce(dz_hash_u64(hash, pilot), count)
+// sends every key of the bucket to a slot no other key uses. Buckets
+// are placed biggest first, while most slots are still free, so the
+// search for a pilot stays short.
+// There are exactly as many slots as keys, so the last buckets are
+// placed into a nearly full table, and their pilot search takes about
+// count / free slots tries. With the taken array outgrowing the caches
+// on top, the build cost per key grows with the size of the map. A
+// load factor under 1 with a remap of the spare slots (as in PTHash)
+// would keep it flat, at the cost of a bigger map.
+
+// Average number of keys per bucket. Bigger buckets mean fewer pilots,
+// but longer searches for them
+#define HM_FROZEN_BUCKET_SIZE 4
+// Fresh salts tried before giving up. A salt only fails if two keys of
+// a bucket have the exact same 64 bit hash
+#define HM_FROZEN_MAX_ATTEMPTS 8
+
+typedef struct DzHmFrozenEntry {
+  uint32_t keysize;
+  uint32_t valuesize;
+  uint64_t offset;  // Of [key bytes][value bytes] in data
+} DzHmFrozenEntry;
+
+// Followed in the same allocation by
+//  [pilots: bucket_count x uint32_t][entries: count x DzHmFrozenEntry]
+//  [data]
+// When every key has the same size, and every value too (the common
+// case of fixed size keys and values), there are no entries: the item
+// of slot i is at data + i * stride, which saves a cache miss per get
+typedef struct DzHmFrozenInstance {
+  uint64_t salt;
+  size_t count;
+  size_t bucket_count;
+  size_t size_bytes;
+  size_t stride;  // 0 if the items use entries
+  uint32_t keysize;
+  uint32_t valuesize;
+  const uint32_t *pilots;
+  const DzHmFrozenEntry *entries;
+  const char *data;
+} DzHmFrozenInstance;
+
+static void hm_frozen_error_set(DzHmError *error_ref,
+                                DzHmError value) {
+  if (error_ref) {
+    *error_ref = value;
+  }
+}
+
+// Maps x to [0, n) without a division
+static inline size_t hm_frozen_reduce(const uint64_t x,
+                                      const size_t n) {
+  return (size_t)(((__uint128_t)x * n) >> 64);
+}
+
+static inline size_t hm_frozen_bucket(const uint64_t hash,
+                                      const size_t bucket_count) {
+  return hm_frozen_reduce(hash, bucket_count);
+}
+
+static inline size_t hm_frozen_slot(const uint64_t hash,
+                                    const uint32_t pilot,
+                                    const size_t count) {
+  return hm_frozen_reduce(dz_hash_u64(hash, pilot), count);
+}
+
+static inline size_t hm_frozen_align8(const size_t n) {
+  return (n + 7) & ~(size_t)7;
+}
+
+// Build state. Keys are referred to by their index in sources
+typedef struct DzHmFrozenBuild {
+  size_t count;
+  size_t bucket_count;
+  const DzHashmapSlot **sources;
+  uint64_t *hashes;
+  size_t *bucket_start;  // bucket_count + 1 offsets into keys
+  size_t *keys;          // Key indices, grouped by bucket
+  size_t *order;         // Buckets, biggest first
+  uint32_t *pilots;
+  size_t *slot_of_key;
+  bool *taken;
+} DzHmFrozenBuild;
+
+static void hm_frozen_build_free(DzHmFrozenBuild *build) {
+  free(build->sources);
+  free(build->hashes);
+  free(build->bucket_start);
+  free(build->keys);
+  free(build->order);
+  free(build->pilots);
+  free(build->slot_of_key);
+  free(build->taken);
+}
+
+// Searches the pilot of one bucket. Returns false if the bucket can
+// never be placed with this salt, because two of its keys have the
+// same hash
+static bool hm_frozen_place_bucket(DzHmFrozenBuild *build,
+                                   const size_t bucket) {
+  const size_t start = build->bucket_start[bucket];
+  const size_t size = build->bucket_start[bucket + 1] - start;
+  const size_t *keys = &build->keys[start];
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (build->hashes[keys[i]] == build->hashes[keys[j]]) {
+        return false;
+      }
+    }
+  }
+  for (uint64_t pilot = 0; pilot <= UINT32_MAX; pilot++) {
+    bool fits = true;
+    for (size_t i = 0; i < size && fits; i++) {
+      const size_t slot = hm_frozen_slot(
+          build->hashes[keys[i]], (uint32_t)pilot, build->count);
+      fits = !build->taken[slot];
+      for (size_t j = 0; j < i && fits; j++) {
+        fits = build->slot_of_key[keys[j]] != slot;
+      }
+      build->slot_of_key[keys[i]] = slot;
+    }
+    if (fits) {
+      for (size_t i = 0; i < size; i++) {
+        build->taken[build->slot_of_key[keys[i]]] = true;
+      }
+      build->pilots[bucket] = (uint32_t)pilot;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Finds a pilot for every bucket with the given salt. Returns
+// DzHmError_Collision if some bucket could not be placed
+static DzHmError hm_frozen_build_attempt(DzHmFrozenBuild *build,
+                                         const uint64_t salt) {
+  for (size_t k = 0; k < build->count; k++) {
+    const DzHashmapSlot *source = build->sources[k];
+    build->hashes[k] =
+        dz_hash_bytes(hm_slot_bytes(source), source->keysize, salt);
+  }
+  // Counting sort of the keys by bucket
+  memset(build->bucket_start, 0,
+         (build->bucket_count + 1) * sizeof(size_t));
+  for (size_t k = 0; k < build->count; k++) {
+    build->bucket_start[hm_frozen_bucket(build->hashes[k],
+                                         build->bucket_count) +
+                        1]++;
+  }
+  size_t max_size = 0;
+  for (size_t b = 0; b < build->bucket_count; b++) {
+    max_size = max(max_size, build->bucket_start[b + 1]);
+    build->bucket_start[b + 1] += build->bucket_start[b];
+  }
+  for (size_t k = 0; k < build->count; k++) {
+    const size_t b =
+        hm_frozen_bucket(build->hashes[k], build->bucket_count);
+    // slot_of_key is free until placement, so it counts the keys
+    // written to each bucket so far
+    build->keys[build->bucket_start[b] + build->slot_of_key[b]++] = k;
+  }
+  // Counting sort of the buckets by size, biggest first
+  size_t *size_start = (size_t *)calloc(max_size + 2, sizeof(size_t));
+  if (!size_start) {
+    return DzHmError_Memory;
+  }
+  for (size_t b = 0; b < build->bucket_count; b++) {
+    const size_t size =
+        build->bucket_start[b + 1] - build->bucket_start[b];
+    size_start[max_size - size + 1]++;
+  }
+  for (size_t s = 0; s <= max_size; s++) {
+    size_start[s + 1] += size_start[s];
+  }
+  for (size_t b = 0; b < build->bucket_count; b++) {
+    const size_t size =
+        build->bucket_start[b + 1] - build->bucket_start[b];
+    build->order[size_start[max_size - size]++] = b;
+  }
+  free(size_start);
+  memset(build->taken, 0, build->count * sizeof(bool));
+  for (size_t i = 0; i < build->bucket_count; i++) {
+    if (!hm_frozen_place_bucket(build, build->order[i])) {
+      return DzHmError_Collision;
+    }
+  }
+  return DzHmError_None;
+}
+
+// Copies the items into one allocation, each item in its slot
+static DzHmFrozen hm_frozen_assemble(const DzHmFrozenBuild *build,
+                                     const uint64_t salt) {
+  bool uniform = build->count > 0;
+  for (size_t k = 1; k < build->count && uniform; k++) {
+    uniform = build->sources[k]->keysize == build->sources[0]->keysize &&
+              build->sources[k]->valuesize == build->sources[0]->valuesize;
+  }
+  const size_t stride =
+      uniform ? hm_frozen_align8(build->sources[0]->keysize +
+                                 build->sources[0]->valuesize)
+              : 0;
+  const size_t pilots_offset =
+      hm_frozen_align8(sizeof(DzHmFrozenInstance));
+  const size_t entries_offset = hm_frozen_align8(
+      pilots_offset + build->bucket_count * sizeof(uint32_t));
+  const size_t data_offset =
+      entries_offset +
+      (uniform ? 0 : build->count * sizeof(DzHmFrozenEntry));
+  size_t data_size = 0;
+  for (size_t k = 0; k < build->count; k++) {
+    data_size += hm_frozen_align8(build->sources[k]->keysize +
+                                  build->sources[k]->valuesize);
+  }
+  char *block = (char *)malloc(data_offset + data_size);
+  DZ_ASSERT(block, "Malloc on frozen hashmap failed");
+  if (!block) {
+    return NULL;
+  }
+  DzHmFrozen frozen = (DzHmFrozen)block;
+  uint32_t *pilots = (uint32_t *)(block + pilots_offset);
+  DzHmFrozenEntry *entries =
+      uniform ? NULL : (DzHmFrozenEntry *)(block + entries_offset);
+  char *data = block + data_offset;
+  memcpy(pilots, build->pilots, build->bucket_count * sizeof(uint32_t));
+  size_t offset = 0;
+  for (size_t k = 0; k < build->count; k++) {
+    const DzHashmapSlot *source = build->sources[k];
+    const size_t size = source->keysize + source->valuesize;
+    const size_t slot = build->slot_of_key[k];
+    if (uniform) {
+      memcpy(data + slot * stride, hm_slot_bytes(source), size);
+      continue;
+    }
+    DzHmFrozenEntry *entry = &entries[slot];
+    entry->keysize = source->keysize;
+    entry->valuesize = source->valuesize;
+    entry->offset = offset;
+    memcpy(data + offset, hm_slot_bytes(source), size);
+    offset += hm_frozen_align8(size);
+  }
+  frozen->salt = salt;
+  frozen->count = build->count;
+  frozen->bucket_count = build->bucket_count;
+  frozen->size_bytes = data_offset + data_size;
+  frozen->stride = stride;
+  frozen->keysize = uniform ? build->sources[0]->keysize : 0;
+  frozen->valuesize = uniform ? build->sources[0]->valuesize : 0;
+  frozen->pilots = pilots;
+  frozen->entries = entries;
+  frozen->data = data;
+  return frozen;
+}
+
+DzHmFrozen hm_freeze(DzHashmap hm, DzHmError *error) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  if (!hm) {
+    hm_frozen_error_set(error, DzHmError_Argument);
+    return NULL;
+  }
+  hm_frozen_error_set(error, DzHmError_None);
+  DzHmFrozenBuild build;
+  memset(&build, 0, sizeof(build));
+  build.count = hm->count;
+  build.bucket_count =
+      max((hm->count + HM_FROZEN_BUCKET_SIZE - 1) / HM_FROZEN_BUCKET_SIZE,
+          (size_t)1);
+  const size_t n = max(build.count, (size_t)1);
+  build.sources = (const DzHashmapSlot **)malloc(n * sizeof(void *));
+  build.hashes = (uint64_t *)malloc(n * sizeof(uint64_t));
+  build.bucket_start =
+      (size_t *)malloc((build.bucket_count + 1) * sizeof(size_t));
+  build.keys = (size_t *)malloc(n * sizeof(size_t));
+  build.order = (size_t *)malloc(build.bucket_count * sizeof(size_t));
+  build.pilots =
+      (uint32_t *)calloc(build.bucket_count, sizeof(uint32_t));
+  build.slot_of_key = (size_t *)malloc(
+      max(n, build.bucket_count) * sizeof(size_t));
+  build.taken = (bool *)malloc(n * sizeof(bool));
+  if (!build.sources || !build.hashes || !build.bucket_start ||
+      !build.keys || !build.order || !build.pilots ||
+      !build.slot_of_key || !build.taken) {
+    hm_frozen_build_free(&build);
+    hm_frozen_error_set(error, DzHmError_Memory);
+    return NULL;
+  }
+  // Items can be in the old table during an incremental resize
+  size_t k = 0;
+  for (size_t i = 0; i < hm->capacity; i++) {
+    if (hm_ctrl_is_full(hm->ctrl[i])) {
+      build.sources[k++] = &hm->slots[i];
+    }
+  }
+  for (size_t i = 0; hm->old_ctrl && i < hm->old_capacity; i++) {
+    if (hm_ctrl_is_full(hm->old_ctrl[i])) {
+      build.sources[k++] = &hm->old_slots[i];
+    }
+  }
+  DZ_ASSERT(k == build.count);
+  DzHmFrozen frozen = NULL;
+  DzHmError result = DzHmError_Collision;
+  // Only collisions are worth another salt
+  for (size_t attempt = 0;
+       attempt < HM_FROZEN_MAX_ATTEMPTS && result == DzHmError_Collision;
+       attempt++) {
+    uint64_t salt;
+    arc4random_buf(&salt, sizeof(salt));
+    memset(build.slot_of_key, 0,
+           max(n, build.bucket_count) * sizeof(size_t));
+    result = hm_frozen_build_attempt(&build, salt);
+    if (result == DzHmError_None) {
+      frozen = hm_frozen_assemble(&build, salt);
+      if (!frozen) {
+        result = DzHmError_Memory;
+      }
+    }
+  }
+  hm_frozen_error_set(error, result);
+  hm_frozen_build_free(&build);
+  return frozen;
+}
+
+void hm_frozen_free(DzHmFrozen frozen) {
+  DZ_ASSERT(frozen);
+  // The instance is the start of the single allocation
+  free(frozen);
+}
+
+const void *hm_frozen_get(DzHmFrozen frozen, const void *key,
+                          const size_t keysize, size_t *valuesize) {
+  DZ_ASSERT(frozen, "Caller must supply a frozen hashmap");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!frozen || !key || !keysize || !frozen->count) {
+    return NULL;
+  }
+  const uint64_t hash = dz_hash_bytes(key, keysize, frozen->salt);
+  const uint32_t pilot =
+      frozen->pilots[hm_frozen_bucket(hash, frozen->bucket_count)];
+  const size_t slot = hm_frozen_slot(hash, pilot, frozen->count);
+  const char *item;
+  uint32_t item_keysize;
+  uint32_t item_valuesize;
+  if (frozen->stride) {
+    item = frozen->data + slot * frozen->stride;
+    item_keysize = frozen->keysize;
+    item_valuesize = frozen->valuesize;
+  } else {
+    const DzHmFrozenEntry *entry = &frozen->entries[slot];
+    item = frozen->data + entry->offset;
+    item_keysize = entry->keysize;
+    item_valuesize = entry->valuesize;
+  }
+  if (!mem_eq(item, key, item_keysize, keysize)) {
+    return NULL;
+  }
+  if (valuesize) {
+    *valuesize = item_valuesize;
+  }
+  return item + item_keysize;
+}
+
+const char *hm_frozen_get_str(DzHmFrozen frozen, const char *key) {
+  return (const char *)hm_frozen_get(frozen, key, strlen(key) + 1,
+                                     NULL);
+}
+
+size_t hm_frozen_count(DzHmFrozen frozen) {
+  DZ_ASSERT(frozen, "Caller must supply a frozen hashmap");
+  if (!frozen) {
+    return 0;
+  }
+  return frozen->count;
+}
+
+size_t hm_frozen_size_bytes(DzHmFrozen frozen) {
+  DZ_ASSERT(frozen, "Caller must supply a frozen hashmap");
+  if (!frozen) {
+    return 0;
+  }
+  return frozen->size_bytes;
+}
+
+double hm_frozen_bits_per_key(DzHmFrozen frozen) {
+  DZ_ASSERT(frozen, "Caller must supply a frozen hashmap");
+  if (!frozen || !frozen->count) {
+    return 0;
+  }
+  return (double)(frozen->bucket_count * sizeof(uint32_t) * 8) /
+         frozen->count;
+}
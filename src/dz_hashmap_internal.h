@@ -0,0 +1,155 @@
+#pragma once
+
+// Layout of DzHashmap, shared by the modules that read its table
+// directly. Not part of the public API.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dz_allocator.h"
+#include "dz_debug.h"
+#include "dz_hashmap.h"
+#include "dz_slab.h"
+
+// Table layout
+// The table is a flat array of slots, plus a parallel array of one
+// byte "control" values. A control byte is either EMPTY, DELETED, or
+// holds the low 7 bits of the hash (H2) of the key in that slot with
+// the top bit set. EMPTY is 0, so a zeroed table is an empty table,
+// and big tables can come straight from calloc without a memset.
+// Slots are probed in groups of HM_GROUP_WIDTH, and a whole group of
+// control bytes is compared against H2 at once, so most lookups only
+// touch one cache line of control bytes and a single slot.
+
+// Bytes of keys and values stored in the slot itself by the small
+// item mode, instead of in a block from the slab
+#define HM_INLINE_SIZE 16
+
+// Largest key and value sizes, which have to fit the 31 bit size
+// fields of a slot
+#define HM_MAX_KEY_SIZE ((size_t)INT32_MAX)
+#define HM_MAX_VALUE_SIZE ((size_t)INT32_MAX)
+
+// Key and value bytes are stored back to back: [key bytes][value
+// bytes]. Usually in one block from the map's slab, pointed to by
+// data. Small items of maps in small item mode are stored in
+// inline_data instead, which saves the allocation and the pointer
+// chase, but moves along with the slot.
+typedef struct DzHashmapSlot {
+  uint64_t hash;
+  uint32_t keysize : 31;
+  uint32_t referenced : 1;  // CLOCK bit of DzHmCache, cleared on write
+  uint32_t valuesize : 31;
+  uint32_t is_inline : 1;
+  union {
+    char *data;
+    char inline_data[HM_INLINE_SIZE];
+  };
+} DzHashmapSlot;
+
+// Operation counters of DZ_HM_COUNTERS builds. Always part of the
+// instance, so the layout doesn't depend on the flag. Lookups count
+// under the shared lock of a concurrent hashmap shard, so the counters
+// are only touched with relaxed atomic loads and stores. They stay as
+// cheap as plain increments, at the cost of dropping the odd count
+// when threads read the same map at once
+typedef struct DzHmCounters {
+  uint64_t finds;
+  uint64_t find_hits;
+  uint64_t find_groups;
+} DzHmCounters;
+
+#ifdef DZ_HM_COUNTERS
+#define HM_COUNTERS_ENABLED true
+#define HM_COUNTER_ADD(counters, field, n)                         \
+  __atomic_store_n(                                                \
+      &(counters)->field,                                          \
+      __atomic_load_n(&(counters)->field, __ATOMIC_RELAXED) + (n), \
+      __ATOMIC_RELAXED)
+#else
+#define HM_COUNTERS_ENABLED false
+#define HM_COUNTER_ADD(counters, field, n) ((void)(counters), (void)(n))
+#endif
+
+// Reads a counter that other threads may be adding to
+#define HM_COUNTER_GET(counters, field) \
+  __atomic_load_n(&(counters)->field, __ATOMIC_RELAXED)
+
+typedef struct DzHashmapInstance {
+  int8_t *ctrl;  // capacity control bytes
+  DzHashmapSlot *slots;
+  size_t capacity;    // Always a power of two multiple of the group
+  size_t count;       // Live items
+  size_t tombstones;  // Slots marked DELETED
+  size_t growth_limit;  // Grows when count + tombstones reaches this
+  double max_load_factor;
+  uint64_t salt;  // Used to prevent hash table attacks
+  const DZAllocator *allocator;  // Of everything below. NULL for malloc
+  DZSlab slab;    // Owns the key and value bytes of every item
+  // Incremental resizing. While old_ctrl is set, the items of the
+  // previous table are still being moved over, a few slots at a time
+  // on every operation. Every key is in exactly one of the tables.
+  bool incremental;
+  int8_t *old_ctrl;
+  DzHashmapSlot *old_slots;
+  size_t old_capacity;
+  size_t old_count;      // Items not moved yet, included in count
+  size_t migrate_index;  // Next slot of the old table to move
+  bool inline_small;     // New small items are stored in their slot
+  // Resize accounting, for hm_stats
+  size_t resize_count;
+  size_t rehash_count;
+  uint64_t rehash_ns;
+  DzHmCounters counters;
+} DzHashmapInstance;
+
+// The key and value bytes of an occupied slot
+static inline char *hm_slot_bytes(const DzHashmapSlot *slot) {
+  return slot->is_inline ? (char *)slot->inline_data : slot->data;
+}
+
+// Whether slot holds key, whose hash is hash
+static inline bool hm_slot_key_eq(const DzHashmapSlot *slot,
+                                  const uint64_t hash,
+                                  const void *key,
+                                  const size_t keysize) {
+  return slot->hash == hash &&
+         mem_eq(hm_slot_bytes(slot), key, slot->keysize, keysize);
+}
+
+// Copies key and value into the slot if inline_small is set and they
+// fit, and into a single new block from slab otherwise. A NULL value
+// is zero-filled. Returns false if memory ran out
+extern bool hm_internal_slot_set(DZSlab *slab, DzHashmapSlot *slot,
+                                 bool inline_small, uint64_t hash,
+                                 const void *key, size_t keysize,
+                                 const void *value, size_t valuesize);
+
+// Overwrites the key and value of an occupied slot, whose storage
+// came from slab. Returns false if memory ran out, leaving the slot
+// as it was
+extern bool hm_internal_slot_replace(DZSlab *slab, DzHashmapSlot *slot,
+                                     bool inline_small, uint64_t hash,
+                                     const void *key, size_t keysize,
+                                     const void *value,
+                                     size_t valuesize);
+
+// Returns the slot holding key in either table, or NULL. Moves a few
+// items along if an incremental resize is in progress
+extern DzHashmapSlot *hm_internal_get_slot(DzHashmap hm, const void *key,
+                                           size_t keysize, uint64_t hash);
+
+// Adds an item for a key that is in neither table. A NULL value is
+// zero-filled. Returns its slot, or NULL if memory ran out
+extern DzHashmapSlot *hm_internal_insert(DzHashmap hm, const void *key,
+                                         size_t keysize, uint64_t hash,
+                                         const void *value,
+                                         size_t valuesize,
+                                         DzHmError *error);
+
+// Adds or overwrites key, like hm_add_prehashed, and returns its slot.
+// Returns NULL if memory ran out
+extern DzHashmapSlot *hm_internal_put(DzHashmap hm, const void *key,
+                                      size_t keysize, uint64_t hash,
+                                      const void *value, size_t valuesize,
+                                      DzHmError *error);
@@ -0,0 +1,458 @@
+#include "dz_hashmap_snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dz_debug.h"
+#include "dz_hash.h"
+#include "dz_hashmap_group.h"
+#include "dz_hashmap_internal.h"
+
+// File layout
+//  [header][control bytes][slots][data]
+// Control bytes and slots are a table laid out and probed exactly like
+// a DzHashmap table, built fresh by hm_save without tombstones. Slots
+// hold the offset of their key and value bytes in the data section
+// instead of a pointer, so the file can be mapped at any address.
+// Every section starts at a multiple of HM_SNAPSHOT_ALIGN.
+
+const uint32_t HM_SNAPSHOT_VERSION = 1;
+
+static const char HM_SNAPSHOT_MAGIC[8] = "DZHMSNAP";
+static const uint32_t HM_SNAPSHOT_BYTE_ORDER = 0x01020304;
+// The checksum is chained over blocks of this many bytes, so it can be
+// computed while streaming the file out
+#define HM_SNAPSHOT_CHECKSUM_BLOCK (64 * 1024)
+#define HM_SNAPSHOT_ALIGN 64
+static const uint64_t HM_SNAPSHOT_CHECKSUM_SEED = 0x5eed5eed5eed5eedull;
+
+typedef struct DzHmSnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t header_size;
+  uint64_t file_size;
+  uint64_t salt;
+  uint64_t capacity;
+  uint64_t count;
+  uint64_t ctrl_offset;
+  uint64_t slots_offset;
+  uint64_t data_offset;
+  uint64_t checksum;  // Of every byte after the header
+} DzHmSnapshotHeader;
+
+typedef struct DzHmSnapshotSlot {
+  uint64_t hash;
+  uint32_t keysize;
+  uint32_t valuesize;
+  uint64_t offset;  // Of [key bytes][value bytes] in the data section
+} DzHmSnapshotSlot;
+
+typedef struct DzHmSnapshotInstance {
+  void *map;
+  size_t map_size;
+  uint64_t salt;
+  size_t capacity;
+  size_t count;
+  const int8_t *ctrl;
+  const DzHmSnapshotSlot *slots;
+  const char *data;
+} DzHmSnapshotInstance;
+
+static void hm_snapshot_error_set(DzHmError *error_ref,
+                                  DzHmError value) {
+  if (error_ref) {
+    *error_ref = value;
+  }
+}
+
+static inline uint64_t hm_snapshot_align(const uint64_t n) {
+  return (n + HM_SNAPSHOT_ALIGN - 1) & ~(uint64_t)(HM_SNAPSHOT_ALIGN - 1);
+}
+
+// Writing
+
+// Buffers the bytes written after the header, and folds every full
+// block into the checksum
+typedef struct DzHmSnapshotWriter {
+  FILE *file;
+  char block[HM_SNAPSHOT_CHECKSUM_BLOCK];
+  size_t used;
+  uint64_t checksum;
+  bool failed;
+} DzHmSnapshotWriter;
+
+static void hm_snapshot_flush(DzHmSnapshotWriter *writer) {
+  if (!writer->used) {
+    return;
+  }
+  writer->checksum =
+      dz_hash_bytes(writer->block, writer->used, writer->checksum);
+  if (fwrite(writer->block, 1, writer->used, writer->file) !=
+      writer->used) {
+    writer->failed = true;
+  }
+  writer->used = 0;
+}
+
+static void hm_snapshot_write(DzHmSnapshotWriter *writer,
+                              const void *bytes, size_t n) {
+  const char *p = (const char *)bytes;
+  while (n) {
+    const size_t chunk =
+        min(n, (size_t)HM_SNAPSHOT_CHECKSUM_BLOCK - writer->used);
+    memcpy(writer->block + writer->used, p, chunk);
+    writer->used += chunk;
+    p += chunk;
+    n -= chunk;
+    if (writer->used == HM_SNAPSHOT_CHECKSUM_BLOCK) {
+      hm_snapshot_flush(writer);
+    }
+  }
+}
+
+// Writes zeroes up to the file offset `to`
+static void hm_snapshot_pad(DzHmSnapshotWriter *writer,
+                            const uint64_t from, const uint64_t to) {
+  static const char zeroes[HM_SNAPSHOT_ALIGN] = {0};
+  DZ_ASSERT(to - from <= HM_SNAPSHOT_ALIGN);
+  hm_snapshot_write(writer, zeroes, to - from);
+}
+
+// Smallest table capacity that holds n items at the default load
+static size_t hm_snapshot_capacity_for(const size_t n) {
+  size_t capacity = HM_GROUP_WIDTH;
+  while ((size_t)(capacity * HM_DEFAULT_MAX_LOAD_FACTOR) <= n) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+// Places one item of the source map in the snapshot table
+static void hm_snapshot_place(int8_t *ctrl, DzHmSnapshotSlot *slots,
+                              const DzHashmapSlot **sources,
+                              const size_t capacity,
+                              const DzHashmapSlot *source) {
+  DzHmProbe probe = hm_internal_probe_start(source->hash, capacity);
+  while (true) {
+    const size_t base = probe.group * HM_GROUP_WIDTH;
+    const uint32_t mask = hm_group_match_empty_or_deleted(&ctrl[base]);
+    if (mask) {
+      const size_t index = base + hm_mask_first(mask);
+      ctrl[index] = hm_hash_h2(source->hash);
+      slots[index].hash = source->hash;
+      slots[index].keysize = source->keysize;
+      slots[index].valuesize = source->valuesize;
+      sources[index] = source;
+      return;
+    }
+    hm_internal_probe_next(&probe);
+  }
+}
+
+// Creates a file next to path with a name no other writer uses, and
+// opens it for writing. Fills tmp_path, of tmp_path_size bytes, with
+// its name. Returns NULL if no file could be created
+static FILE *hm_snapshot_create_tmp(const char *path, char *tmp_path,
+                                    const size_t tmp_path_size) {
+  static uint32_t next_tmp_id = 0;
+  for (int attempt = 0; attempt < 100; attempt++) {
+    const uint32_t id =
+        __atomic_fetch_add(&next_tmp_id, 1, __ATOMIC_RELAXED);
+    snprintf(tmp_path, tmp_path_size, "%s.tmp.%ld.%u", path,
+             (long)getpid(), id);
+    // Created with the permissions fopen would have given path
+    const int fd =
+        open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0) {
+      if (errno == EEXIST) {
+        continue;
+      }
+      return NULL;
+    }
+    FILE *file = fdopen(fd, "wb");
+    if (!file) {
+      close(fd);
+      unlink(tmp_path);
+    }
+    return file;
+  }
+  return NULL;
+}
+
+void hm_save(DzHashmap hm, const char *path, DzHmError *error) {
+  DZ_ASSERT(hm, "Caller must supply a hashmap");
+  DZ_ASSERT(path, "Caller must supply a path");
+  if (!hm || !path) {
+    hm_snapshot_error_set(error, DzHmError_Argument);
+    return;
+  }
+  hm_snapshot_error_set(error, DzHmError_None);
+  const size_t capacity = hm_snapshot_capacity_for(hm->count);
+  int8_t *ctrl = (int8_t *)calloc(capacity, 1);
+  DzHmSnapshotSlot *slots =
+      (DzHmSnapshotSlot *)calloc(capacity, sizeof(DzHmSnapshotSlot));
+  const DzHashmapSlot **sources =
+      (const DzHashmapSlot **)calloc(capacity, sizeof(void *));
+  DzHmSnapshotWriter *writer =
+      (DzHmSnapshotWriter *)calloc(1, sizeof(DzHmSnapshotWriter));
+  // Room for the ".tmp.<pid>.<id>" suffix
+  const size_t tmp_path_size = strlen(path) + 48;
+  char *tmp_path = (char *)malloc(tmp_path_size);
+  if (!ctrl || !slots || !sources || !writer || !tmp_path) {
+    hm_snapshot_error_set(error, DzHmError_Memory);
+    goto cleanup;
+  }
+  // Items can be in the old table during an incremental resize
+  for (size_t i = 0; i < hm->capacity; i++) {
+    if (hm_ctrl_is_full(hm->ctrl[i])) {
+      hm_snapshot_place(ctrl, slots, sources, capacity, &hm->slots[i]);
+    }
+  }
+  for (size_t i = 0; hm->old_ctrl && i < hm->old_capacity; i++) {
+    if (hm_ctrl_is_full(hm->old_ctrl[i])) {
+      hm_snapshot_place(ctrl, slots, sources, capacity,
+                        &hm->old_slots[i]);
+    }
+  }
+  // Data is written in slot order, each item 8 byte aligned
+  uint64_t data_size = 0;
+  for (size_t i = 0; i < capacity; i++) {
+    if (sources[i]) {
+      slots[i].offset = data_size;
+      data_size += (sources[i]->keysize + sources[i]->valuesize + 7) &
+                   ~(uint64_t)7;
+    }
+  }
+  DzHmSnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, HM_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = HM_SNAPSHOT_VERSION;
+  header.byte_order = HM_SNAPSHOT_BYTE_ORDER;
+  header.header_size = sizeof(header);
+  header.salt = hm->salt;
+  header.capacity = capacity;
+  header.count = hm->count;
+  header.ctrl_offset = hm_snapshot_align(sizeof(header));
+  header.slots_offset = hm_snapshot_align(header.ctrl_offset + capacity);
+  header.data_offset = hm_snapshot_align(
+      header.slots_offset + capacity * sizeof(DzHmSnapshotSlot));
+  header.file_size = header.data_offset + data_size;
+
+  // Processes may have the file at path mapped, and truncating it
+  // under them would fault their reads, so the snapshot is written
+  // to a new file that is renamed over path once it is complete
+  writer->file = hm_snapshot_create_tmp(path, tmp_path, tmp_path_size);
+  if (!writer->file) {
+    hm_snapshot_error_set(error, DzHmError_Io);
+    goto cleanup;
+  }
+  writer->checksum = HM_SNAPSHOT_CHECKSUM_SEED;
+  // The header is written again with the checksum at the end
+  if (fwrite(&header, sizeof(header), 1, writer->file) != 1) {
+    writer->failed = true;
+  }
+  hm_snapshot_pad(writer, sizeof(header), header.ctrl_offset);
+  hm_snapshot_write(writer, ctrl, capacity);
+  hm_snapshot_pad(writer, header.ctrl_offset + capacity,
+                  header.slots_offset);
+  hm_snapshot_write(writer, slots, capacity * sizeof(DzHmSnapshotSlot));
+  hm_snapshot_pad(writer,
+                  header.slots_offset +
+                      capacity * sizeof(DzHmSnapshotSlot),
+                  header.data_offset);
+  for (size_t i = 0; i < capacity; i++) {
+    if (!sources[i]) {
+      continue;
+    }
+    const size_t size = sources[i]->keysize + sources[i]->valuesize;
+    hm_snapshot_write(writer, hm_slot_bytes(sources[i]), size);
+    hm_snapshot_pad(writer, size, (size + 7) & ~(size_t)7);
+  }
+  hm_snapshot_flush(writer);
+  header.checksum = writer->checksum;
+  if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+      fwrite(&header, sizeof(header), 1, writer->file) != 1) {
+    writer->failed = true;
+  }
+  // The data must be on disk before the rename makes it visible, or
+  // a crash could leave path empty
+  if (fflush(writer->file) != 0 || fsync(fileno(writer->file)) != 0) {
+    writer->failed = true;
+  }
+  if (fclose(writer->file) != 0 || writer->failed ||
+      rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    hm_snapshot_error_set(error, DzHmError_Io);
+  }
+
+cleanup:
+  free(tmp_path);
+  free(ctrl);
+  free(slots);
+  free(sources);
+  free(writer);
+}
+
+// Reading
+
+// Checks that the header describes a file this code can read, and
+// that every section lies inside the file
+static bool hm_snapshot_header_valid(const DzHmSnapshotHeader *header,
+                                     const size_t file_size) {
+  if (memcmp(header->magic, HM_SNAPSHOT_MAGIC, sizeof(header->magic)) ||
+      header->version != HM_SNAPSHOT_VERSION ||
+      header->byte_order != HM_SNAPSHOT_BYTE_ORDER ||
+      header->header_size != sizeof(DzHmSnapshotHeader) ||
+      header->file_size != file_size) {
+    return false;
+  }
+  const uint64_t capacity = header->capacity;
+  if (capacity < HM_GROUP_WIDTH || (capacity & (capacity - 1)) ||
+      header->count >= capacity) {
+    return false;
+  }
+  return header->ctrl_offset % HM_SNAPSHOT_ALIGN == 0 &&
+         header->slots_offset % HM_SNAPSHOT_ALIGN == 0 &&
+         header->ctrl_offset >= sizeof(DzHmSnapshotHeader) &&
+         header->slots_offset >= header->ctrl_offset + capacity &&
+         header->data_offset >=
+             header->slots_offset +
+                 capacity * sizeof(DzHmSnapshotSlot) &&
+         header->data_offset <= file_size;
+}
+
+static uint64_t hm_snapshot_checksum(const char *bytes,
+                                     const size_t n) {
+  uint64_t checksum = HM_SNAPSHOT_CHECKSUM_SEED;
+  for (size_t done = 0; done < n;
+       done += HM_SNAPSHOT_CHECKSUM_BLOCK) {
+    checksum = dz_hash_bytes(
+        bytes + done, min(n - done, (size_t)HM_SNAPSHOT_CHECKSUM_BLOCK),
+        checksum);
+  }
+  return checksum;
+}
+
+DzHmSnapshot hm_open_mmap(const char *path, const bool verify_checksum,
+                          DzHmError *error) {
+  DZ_ASSERT(path, "Caller must supply a path");
+  if (!path) {
+    hm_snapshot_error_set(error, DzHmError_Argument);
+    return NULL;
+  }
+  hm_snapshot_error_set(error, DzHmError_None);
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    hm_snapshot_error_set(error, DzHmError_Io);
+    return NULL;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    hm_snapshot_error_set(error, DzHmError_Io);
+    return NULL;
+  }
+  const size_t file_size = (size_t)info.st_size;
+  if (file_size < sizeof(DzHmSnapshotHeader)) {
+    close(fd);
+    hm_snapshot_error_set(error, DzHmError_Format);
+    return NULL;
+  }
+  void *map = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps the file alive on its own
+  close(fd);
+  if (map == MAP_FAILED) {
+    hm_snapshot_error_set(error, DzHmError_Io);
+    return NULL;
+  }
+  const DzHmSnapshotHeader *header = (const DzHmSnapshotHeader *)map;
+  const char *bytes = (const char *)map;
+  if (!hm_snapshot_header_valid(header, file_size) ||
+      (verify_checksum &&
+       hm_snapshot_checksum(bytes + sizeof(*header),
+                            file_size - sizeof(*header)) !=
+           header->checksum)) {
+    munmap(map, file_size);
+    hm_snapshot_error_set(error, DzHmError_Format);
+    return NULL;
+  }
+  DzHmSnapshot snapshot =
+      (DzHmSnapshot)calloc(1, sizeof(struct DzHmSnapshotInstance));
+  if (!snapshot) {
+    munmap(map, file_size);
+    hm_snapshot_error_set(error, DzHmError_Memory);
+    return NULL;
+  }
+  snapshot->map = map;
+  snapshot->map_size = file_size;
+  snapshot->salt = header->salt;
+  snapshot->capacity = header->capacity;
+  snapshot->count = header->count;
+  snapshot->ctrl = (const int8_t *)(bytes + header->ctrl_offset);
+  snapshot->slots =
+      (const DzHmSnapshotSlot *)(bytes + header->slots_offset);
+  snapshot->data = bytes + header->data_offset;
+  return snapshot;
+}
+
+void hm_snapshot_close(DzHmSnapshot snapshot) {
+  DZ_ASSERT(snapshot);
+  if (!snapshot) {
+    return;
+  }
+  munmap(snapshot->map, snapshot->map_size);
+  free(snapshot);
+}
+
+const void *hm_snapshot_get(DzHmSnapshot snapshot, const void *key,
+                            const size_t keysize, size_t *valuesize) {
+  DZ_ASSERT(snapshot, "Caller must supply a snapshot");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!snapshot || !key || !keysize) {
+    return NULL;
+  }
+  const uint64_t hash = dz_hash_bytes(key, keysize, snapshot->salt);
+  const int8_t h2 = hm_hash_h2(hash);
+  DzHmProbe probe = hm_internal_probe_start(hash, snapshot->capacity);
+  while (true) {
+    const size_t base = probe.group * HM_GROUP_WIDTH;
+    const int8_t *group = &snapshot->ctrl[base];
+    for (uint32_t mask = hm_group_match(group, h2); mask;
+         mask &= mask - 1) {
+      const DzHmSnapshotSlot *slot =
+          &snapshot->slots[base + hm_mask_first(mask)];
+      const char *item = snapshot->data + slot->offset;
+      if (slot->hash == hash &&
+          mem_eq(item, key, slot->keysize, keysize)) {
+        if (valuesize) {
+          *valuesize = slot->valuesize;
+        }
+        return item + slot->keysize;
+      }
+    }
+    if (hm_group_match_empty(group)) {
+      return NULL;
+    }
+    hm_internal_probe_next(&probe);
+  }
+}
+
+const char *hm_snapshot_get_str(DzHmSnapshot snapshot,
+                                const char *key) {
+  return (const char *)hm_snapshot_get(snapshot, key, strlen(key) + 1,
+                                       NULL);
+}
+
+size_t hm_snapshot_count(DzHmSnapshot snapshot) {
+  DZ_ASSERT(snapshot, "Caller must supply a snapshot");
+  if (!snapshot) {
+    return 0;
+  }
+  return snapshot->count;
+}
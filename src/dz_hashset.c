@@ -0,0 +1,165 @@
+#include "dz_hashset.h"
+
+#include <string.h>
+
+#include "dz_debug.h"
+#include "dz_hashmap_group.h"
+#include "dz_hashmap_internal.h"
+
+// A hashmap whose items all have empty values. Small item mode is
+// always on: no pointer into the table is ever handed out, so keys
+// moving along with their slots doesn't matter
+typedef struct DzHashsetInstance {
+  DzHashmap hm;
+} DzHashsetInstance;
+
+static void hs_error_set(DzHmError *error_ref, DzHmError value) {
+  if (error_ref) {
+    *error_ref = value;
+  }
+}
+
+static DzHashset hs_wrap(DzHashmap hm, DzHmError *error) {
+  if (!hm) {
+    return NULL;
+  }
+  DzHashset set = (DzHashset)malloc(sizeof(struct DzHashsetInstance));
+  DZ_ASSERT(set, "Malloc on hashset failed");
+  if (!set) {
+    hm_free(hm);
+    hs_error_set(error, DzHmError_Memory);
+    return NULL;
+  }
+  hm_set_inline_small_items(hm, true);
+  set->hm = hm;
+  return set;
+}
+
+DzHashset hs_init(DzHmError *error) {
+  return hs_wrap(hm_init(error), error);
+}
+
+DzHashset hs_init_with_capacity(const size_t capacity,
+                                DzHmError *error) {
+  return hs_wrap(hm_init_with_capacity(capacity, error), error);
+}
+
+void hs_free(DzHashset set) {
+  DZ_ASSERT(set);
+  if (!set) {
+    return;
+  }
+  hm_free(set->hm);
+  free(set);
+}
+
+// Adds key with its hash in the set's map, unless it's already there
+static bool hs_insert_prehashed(DzHashmap hm, const void *key,
+                                const size_t keysize,
+                                const uint64_t hash, DzHmError *error) {
+  if (hm_internal_get_slot(hm, key, keysize, hash)) {
+    return false;
+  }
+  return hm_internal_insert(hm, key, keysize, hash, NULL, 0, error) !=
+         NULL;
+}
+
+bool hs_insert(DzHashset set, const void *key, const size_t keysize,
+               DzHmError *error) {
+  DZ_ASSERT(set, "Caller must supply a set");
+  DZ_ASSERT(key, "Caller must supply a key");
+  DZ_ASSERT(keysize, "Caller must supply a key");
+  DZ_ASSERT(keysize <= INT32_MAX, "Key is too large");
+  if (!set || !key || !keysize || keysize > INT32_MAX) {
+    hs_error_set(error, DzHmError_Argument);
+    return false;
+  }
+  hs_error_set(error, DzHmError_None);
+  return hs_insert_prehashed(set->hm, key, keysize,
+                             hm_hash(set->hm, key, keysize), error);
+}
+
+bool hs_insert_str(DzHashset set, const char *key, DzHmError *error) {
+  return hs_insert(set, key, strlen(key) + 1, error);
+}
+
+bool hs_contains(DzHashset set, const void *key, const size_t keysize) {
+  DZ_ASSERT(set, "Caller must supply a set");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!set || !key || !keysize) {
+    return false;
+  }
+  return hm_internal_get_slot(set->hm, key, keysize,
+                              hm_hash(set->hm, key, keysize)) != NULL;
+}
+
+bool hs_contains_str(DzHashset set, const char *key) {
+  return hs_contains(set, key, strlen(key) + 1);
+}
+
+bool hs_remove(DzHashset set, const void *key, const size_t keysize) {
+  DZ_ASSERT(set, "Caller must supply a set");
+  DZ_ASSERT(key, "Caller must supply a key");
+  if (!set || !key || !keysize) {
+    return false;
+  }
+  const size_t count = hm_count(set->hm);
+  hm_delete(set->hm, key, keysize);
+  return hm_count(set->hm) != count;
+}
+
+bool hs_remove_str(DzHashset set, const char *key) {
+  return hs_remove(set, key, strlen(key) + 1);
+}
+
+size_t hs_count(DzHashset set) {
+  DZ_ASSERT(set, "Caller must supply a set");
+  if (!set) {
+    return 0;
+  }
+  return hm_count(set->hm);
+}
+
+void hs_union(DzHashset set, DzHashset other, DzHmError *error) {
+  DZ_ASSERT(set && other, "Caller must supply two sets");
+  if (!set || !other) {
+    hs_error_set(error, DzHmError_Argument);
+    return;
+  }
+  hs_error_set(error, DzHmError_None);
+  if (set == other) {
+    return;
+  }
+  const DzHashmap from = other->hm;
+  DzHmError union_error = DzHmError_None;
+  // Grow once up front, instead of on the way
+  hm_reserve(set->hm, hm_count(set->hm) + hm_count(from), &union_error);
+  DzHmIter it = hm_iter_begin(from);
+  while (!union_error && hm_iter_next(&it)) {
+    // Every map salts its hashes, so the key is hashed again
+    hs_insert_prehashed(set->hm, it.key, it.keysize,
+                        hm_hash(set->hm, it.key, it.keysize),
+                        &union_error);
+  }
+  hs_error_set(error, union_error);
+}
+
+void hs_intersect(DzHashset set, DzHashset other) {
+  DZ_ASSERT(set && other, "Caller must supply two sets");
+  if (!set || !other || set == other) {
+    return;
+  }
+  const DzHashmap hm = set->hm;
+  // Deleting never moves other items, so the walk can delete as it
+  // goes
+  for (size_t i = 0; i < hm->capacity; i++) {
+    if (!hm_ctrl_is_full(hm->ctrl[i])) {
+      continue;
+    }
+    const DzHashmapSlot *slot = &hm->slots[i];
+    const char *key = hm_slot_bytes(slot);
+    if (!hs_contains(other, key, slot->keysize)) {
+      hm_delete_prehashed(hm, key, slot->keysize, slot->hash);
+    }
+  }
+}
@@ -0,0 +1,80 @@
+#include "dz_intern.h"
+
+#include <string.h>
+
+#include "dz_debug.h"
+
+// Every key needs a value, but only the key is used
+static const char DZ_INTERN_VALUE = 0;
+
+DZInterner dz_interner_init(DzHmError *error) {
+  DZInterner interner = {
+      .strings = hm_init(error),
+  };
+  return interner;
+}
+
+void dz_interner_free(DZInterner *interner) {
+  DZ_ASSERT(interner);
+  if (!interner || !interner->strings) {
+    return;
+  }
+  hm_free(interner->strings);
+  interner->strings = NULL;
+}
+
+// The hashmap's copy of a key never moves, even when the table
+// resizes, and interned strings are never deleted or overwritten
+const char *dz_intern(DZInterner *interner, const char *str,
+                      DzHmError *error) {
+  DZ_ASSERT(interner && interner->strings,
+            "Caller must supply an interner");
+  DZ_ASSERT(str, "Caller must supply a string");
+  if (!interner || !interner->strings || !str) {
+    if (error) {
+      *error = DzHmError_Argument;
+    }
+    return NULL;
+  }
+  const size_t size = strlen(str) + 1;
+  const DzHmHash hash = hm_hash(interner->strings, str, size);
+  const char *interned = (const char *)hm_get_key_prehashed(
+      interner->strings, str, size, hash);
+  if (interned) {
+    return interned;
+  }
+  DzHmError add_error = DzHmError_None;
+  hm_add_prehashed(interner->strings, str, size, hash,
+                   &DZ_INTERN_VALUE, sizeof(DZ_INTERN_VALUE),
+                   &add_error);
+  if (add_error) {
+    if (error) {
+      *error = add_error;
+    }
+    return NULL;
+  }
+  return (const char *)hm_get_key_prehashed(interner->strings, str,
+                                            size, hash);
+}
+
+const char *dz_intern_find(DZInterner *interner, const char *str) {
+  DZ_ASSERT(interner && interner->strings,
+            "Caller must supply an interner");
+  DZ_ASSERT(str, "Caller must supply a string");
+  if (!interner || !interner->strings || !str) {
+    return NULL;
+  }
+  const size_t size = strlen(str) + 1;
+  return (const char *)hm_get_key_prehashed(
+      interner->strings, str, size,
+      hm_hash(interner->strings, str, size));
+}
+
+size_t dz_interner_count(DZInterner *interner) {
+  DZ_ASSERT(interner && interner->strings,
+            "Caller must supply an interner");
+  if (!interner || !interner->strings) {
+    return 0;
+  }
+  return hm_count(interner->strings);
+}
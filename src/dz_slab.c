@@ -0,0 +1,255 @@
+#include "dz_slab.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dz_debug.h"
+
+const size_t DZ_SLAB_DEFAULT_CHUNK_SIZE = 64 * 1024;  // 64KB
+const size_t DZ_SLAB_MAX_BLOCK_SIZE = 4096;           // 4KB
+
+// Size classes are 16 byte steps up to 256 bytes, and powers of two
+// above that, up to DZ_SLAB_MAX_BLOCK_SIZE
+#define DZ_SLAB_ALIGN 16
+#define DZ_SLAB_SMALL_CLASSES 16
+#define DZ_SLAB_SMALL_MAX (DZ_SLAB_ALIGN * DZ_SLAB_SMALL_CLASSES)
+
+// Chunks and large blocks keep a header in front of the memory they
+// hand out, padded to a multiple of 16 bytes so that memory stays
+// aligned
+struct DZSlabChunk {
+  DZSlabChunk *next;
+  size_t size;
+};
+
+struct __attribute__((aligned(16))) DZSlabLargeBlock {
+  DZSlabLargeBlock *next;
+  DZSlabLargeBlock *prev;
+  size_t size;
+};
+
+// Freed blocks are threaded through their own first bytes
+struct DZSlabFreeBlock {
+  DZSlabFreeBlock *next;
+};
+
+static size_t dz_slab_class(const size_t n_bytes) {
+  DZ_ASSERT(n_bytes <= DZ_SLAB_MAX_BLOCK_SIZE);
+  if (n_bytes <= DZ_SLAB_SMALL_MAX) {
+    return n_bytes ? (n_bytes - 1) / DZ_SLAB_ALIGN : 0;
+  }
+  size_t class_index = DZ_SLAB_SMALL_CLASSES;
+  size_t class_size = DZ_SLAB_SMALL_MAX * 2;
+  while (class_size < n_bytes) {
+    class_size *= 2;
+    class_index++;
+  }
+  return class_index;
+}
+
+static size_t dz_slab_class_size(const size_t class_index) {
+  if (class_index < DZ_SLAB_SMALL_CLASSES) {
+    return (class_index + 1) * DZ_SLAB_ALIGN;
+  }
+  return (size_t)DZ_SLAB_SMALL_MAX
+         << (class_index - DZ_SLAB_SMALL_CLASSES + 1);
+}
+
+DZSlab dz_slab_init(const size_t chunk_size) {
+  return dz_slab_init_ex(chunk_size, NULL);
+}
+
+DZSlab dz_slab_init_ex(const size_t chunk_size,
+                       const DZAllocator *allocator) {
+  DZSlab slab;
+  memset(&slab, 0, sizeof(slab));
+  slab.allocator = allocator;
+  slab.chunk_size =
+      (chunk_size == 0) ? DZ_SLAB_DEFAULT_CHUNK_SIZE : chunk_size;
+  DZ_ASSERT(slab.chunk_size >= DZ_SLAB_MAX_BLOCK_SIZE,
+            "Chunks must fit the largest size class");
+  slab.chunk_size = max(slab.chunk_size, DZ_SLAB_MAX_BLOCK_SIZE);
+  return slab;
+}
+
+void dz_slab_free(DZSlab *slab) {
+  DZ_ASSERT(slab);
+  if (!slab) {
+    return;
+  }
+  DZSlabChunk *chunk = slab->chunks;
+  while (chunk) {
+    DZSlabChunk *next = chunk->next;
+    dz_impl_free(slab->allocator, chunk,
+                 sizeof(DZSlabChunk) + chunk->size);
+    chunk = next;
+  }
+  DZSlabLargeBlock *large = slab->large_blocks;
+  while (large) {
+    DZSlabLargeBlock *next = large->next;
+    dz_impl_free(slab->allocator, large,
+                 sizeof(DZSlabLargeBlock) + large->size);
+    large = next;
+  }
+  *slab = dz_slab_init_ex(slab->chunk_size, slab->allocator);
+}
+
+static void *dz_slab_alloc_large(DZSlab *slab, const size_t n_bytes) {
+  DZSlabLargeBlock *large = (DZSlabLargeBlock *)dz_impl_alloc(
+      slab->allocator, sizeof(DZSlabLargeBlock) + n_bytes);
+  DZ_ASSERT(large, "Could not malloc a large slab block");
+  if (!large) {
+    return NULL;
+  }
+  large->size = n_bytes;
+  large->prev = NULL;
+  large->next = slab->large_blocks;
+  if (slab->large_blocks) {
+    slab->large_blocks->prev = large;
+  }
+  slab->large_blocks = large;
+  return &large[1];
+}
+
+static void dz_slab_dealloc_large(DZSlab *slab, void *block) {
+  DZSlabLargeBlock *large = &((DZSlabLargeBlock *)block)[-1];
+  if (large->prev) {
+    large->prev->next = large->next;
+  } else {
+    slab->large_blocks = large->next;
+  }
+  if (large->next) {
+    large->next->prev = large->prev;
+  }
+  dz_impl_free(slab->allocator, large,
+               sizeof(DZSlabLargeBlock) + large->size);
+}
+
+// Gives whatever is left of the current chunk to the free lists, so
+// it isn't wasted when allocation moves on to another chunk
+static void dz_slab_retire_remaining(DZSlab *slab) {
+  while (slab->remaining >= DZ_SLAB_ALIGN) {
+    size_t class_index = dz_slab_class(
+        min(slab->remaining, DZ_SLAB_MAX_BLOCK_SIZE));
+    if (dz_slab_class_size(class_index) > slab->remaining) {
+      class_index--;
+    }
+    const size_t class_size = dz_slab_class_size(class_index);
+    DZSlabFreeBlock *free_block = (DZSlabFreeBlock *)slab->cursor;
+    free_block->next = slab->free_lists[class_index];
+    slab->free_lists[class_index] = free_block;
+    slab->cursor += class_size;
+    slab->remaining -= class_size;
+  }
+}
+
+// Starts a new chunk
+static bool dz_slab_grow(DZSlab *slab) {
+  dz_slab_retire_remaining(slab);
+  DZSlabChunk *chunk = (DZSlabChunk *)dz_impl_alloc(
+      slab->allocator, sizeof(DZSlabChunk) + slab->chunk_size);
+  DZ_ASSERT(chunk, "Could not malloc a slab chunk");
+  if (!chunk) {
+    return false;
+  }
+  chunk->size = slab->chunk_size;
+  chunk->next = slab->chunks;
+  slab->chunks = chunk;
+  slab->cursor = (char *)&chunk[1];
+  slab->remaining = slab->chunk_size;
+  return true;
+}
+
+void *dz_slab_alloc(DZSlab *slab, const size_t n_bytes) {
+  DZ_ASSERT(slab);
+  if (!slab) {
+    return NULL;
+  }
+  if (n_bytes > DZ_SLAB_MAX_BLOCK_SIZE) {
+    return dz_slab_alloc_large(slab, n_bytes);
+  }
+  const size_t class_index = dz_slab_class(n_bytes);
+  DZSlabFreeBlock *free_block = slab->free_lists[class_index];
+  if (free_block) {
+    slab->free_lists[class_index] = free_block->next;
+    return free_block;
+  }
+  const size_t class_size = dz_slab_class_size(class_index);
+  if (slab->remaining < class_size && !dz_slab_grow(slab)) {
+    return NULL;
+  }
+  void *block = slab->cursor;
+  slab->cursor += class_size;
+  slab->remaining -= class_size;
+  return block;
+}
+
+void dz_slab_dealloc(DZSlab *slab, void *block, const size_t n_bytes) {
+  DZ_ASSERT(slab);
+  if (!slab || !block) {
+    return;
+  }
+  if (n_bytes > DZ_SLAB_MAX_BLOCK_SIZE) {
+    dz_slab_dealloc_large(slab, block);
+    return;
+  }
+  const size_t class_index = dz_slab_class(n_bytes);
+  DZSlabFreeBlock *free_block = (DZSlabFreeBlock *)block;
+  free_block->next = slab->free_lists[class_index];
+  slab->free_lists[class_index] = free_block;
+}
+
+void dz_slab_merge(DZSlab *dst, DZSlab *src) {
+  DZ_ASSERT(dst && src);
+  DZ_ASSERT(dst->allocator == src->allocator,
+            "Merged slabs must share an allocator");
+  if (!dst || !src || dst == src) {
+    return;
+  }
+  // The rest of src's current chunk becomes free blocks, so every
+  // chunk of src can be treated as full from here on. They go behind
+  // the newest chunk of dst, which keeps its cursor
+  dz_slab_retire_remaining(src);
+  if (src->chunks) {
+    DZSlabChunk *last = src->chunks;
+    while (last->next) {
+      last = last->next;
+    }
+    if (dst->chunks) {
+      last->next = dst->chunks->next;
+      dst->chunks->next = src->chunks;
+    } else {
+      dst->chunks = src->chunks;
+    }
+  }
+  if (src->large_blocks) {
+    DZSlabLargeBlock *last = src->large_blocks;
+    while (last->next) {
+      last = last->next;
+    }
+    last->next = dst->large_blocks;
+    if (dst->large_blocks) {
+      dst->large_blocks->prev = last;
+    }
+    dst->large_blocks = src->large_blocks;
+  }
+  for (size_t i = 0; i < DZ_SLAB_CLASS_COUNT; i++) {
+    DZSlabFreeBlock *free_block = src->free_lists[i];
+    if (!free_block) {
+      continue;
+    }
+    while (free_block->next) {
+      free_block = free_block->next;
+    }
+    free_block->next = dst->free_lists[i];
+    dst->free_lists[i] = src->free_lists[i];
+  }
+  *src = dz_slab_init_ex(src->chunk_size, src->allocator);
+}
+
+bool dz_slab_same_class(const size_t a, const size_t b) {
+  if (a > DZ_SLAB_MAX_BLOCK_SIZE || b > DZ_SLAB_MAX_BLOCK_SIZE) {
+    return a == b;
+  }
+  return dz_slab_class(a) == dz_slab_class(b);
+}
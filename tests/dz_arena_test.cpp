@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <stdint.h>
+#include <string.h>
+
 extern "C" {
 #include "dz_arena.h"
 }
@@ -61,6 +64,34 @@ TEST(Arena, Clear) {
   dz_arena_free(&a);
 }
 
+TEST(Arena, Allocator) {
+  DZArena a = dz_arena_init(1000);
+  DZAllocator allocator = dz_arena_allocator(&a);
+  char *first = (char *)allocator.alloc(allocator.user_data, 10);
+  char *second = (char *)allocator.alloc(allocator.user_data, 10);
+  ASSERT_EQ((uintptr_t)first % 16, 0);
+  ASSERT_EQ((uintptr_t)second % 16, 0);
+  ASSERT_EQ(second, first + 16);
+  // The newest block grows in place, older ones move
+  memset(second, 's', 10);
+  ASSERT_EQ(allocator.realloc(allocator.user_data, second, 10, 100),
+            second);
+  memset(first, 'f', 10);
+  char *moved =
+      (char *)allocator.realloc(allocator.user_data, first, 10, 20);
+  ASSERT_NE(moved, first);
+  ASSERT_EQ(moved[9], 'f');
+  // Freeing the newest block gives it back
+  allocator.free(allocator.user_data, moved, 20);
+  ASSERT_EQ(allocator.alloc(allocator.user_data, 20), moved);
+  // Running out fails the allocation, and leaves the arena usable
+  ASSERT_FALSE(allocator.alloc(allocator.user_data, 1000));
+  ASSERT_EQ(a.error, DzArenaError_NONE);
+  dz_arena_clear(&a);
+  ASSERT_EQ(allocator.alloc(allocator.user_data, 1000), a.data);
+  dz_arena_free(&a);
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "dz_arena.h"
+#include "dz_array_sort.h"
+}
+
+#define INT_LESS(x, y) (*(x) < *(y))
+
+struct Record {
+  int32_t key;
+  uint32_t order;  // Index in the input, to check stability
+};
+
+static bool record_less(const Record *x, const Record *y) {
+  return x->key != y->key ? x->key < y->key : x->order < y->order;
+}
+
+static bool record_key_less(const Record *x, const Record *y) {
+  return x->key < y->key;
+}
+
+static uint64_t next_random(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Inputs that are hard on quicksorts: sorted, reversed, equal, organ
+// pipe, few distinct values, and random
+static std::vector<std::vector<int>> sort_inputs(const size_t n) {
+  std::vector<std::vector<int>> inputs(6, std::vector<int>(n));
+  uint64_t seed = n;
+  for (size_t i = 0; i < n; i++) {
+    inputs[0][i] = (int)i;
+    inputs[1][i] = (int)(n - i);
+    inputs[2][i] = 7;
+    inputs[3][i] = (int)(i < n / 2 ? i : n - i);
+    inputs[4][i] = (int)(next_random(&seed) % 4);
+    inputs[5][i] = (int)next_random(&seed);
+  }
+  return inputs;
+}
+
+static DZArray(int) to_array(const std::vector<int> &items) {
+  DZArray(int) arr = NULL;
+  dz_arrpush_n(arr, items.data(), items.size());
+  return arr;
+}
+
+static void expect_equal(DZArray(int) arr, const std::vector<int> &items) {
+  ASSERT_EQ(dz_arrlen(arr), items.size());
+  for (size_t i = 0; i < items.size(); i++) {
+    ASSERT_EQ(arr[i], items[i]) << "at " << i;
+  }
+}
+
+TEST(DzArrSort, MatchesStdSort) {
+  for (size_t n : {0, 1, 2, 3, 16, 17, 100, 1000, 100000}) {
+    for (std::vector<int> &input : sort_inputs(n)) {
+      DZArray(int) arr = to_array(input);
+      dz_arrsort(arr, INT_LESS);
+      std::sort(input.begin(), input.end());
+      expect_equal(arr, input);
+      dz_arrfree(arr);
+    }
+  }
+}
+
+TEST(DzArrSort, Heapsort) {
+  // Introsort only falls back on it for bad partitions, so it is
+  // checked on its own
+  for (size_t n : {1, 2, 5, 1000}) {
+    for (std::vector<int> &input : sort_inputs(n)) {
+      DZ_IMPL_ARR_HEAPSORT(int, input.data(), input.size(), INT_LESS);
+      ASSERT_TRUE(std::is_sorted(input.begin(), input.end()));
+    }
+  }
+}
+
+TEST(DzArrSort, FunctionComparison) {
+  DZArray(Record) arr = NULL;
+  uint64_t seed = 1;
+  for (uint32_t i = 0; i < 5000; i++) {
+    const Record record = {(int32_t)(next_random(&seed) % 100) - 50, i};
+    dz_arrpush(arr, record);
+  }
+  dz_arrsort(arr, record_less);
+  for (size_t i = 1; i < dz_arrlen(arr); i++) {
+    ASSERT_FALSE(record_less(&arr[i], &arr[i - 1]));
+  }
+  dz_arrfree(arr);
+}
+
+TEST(DzArrSort, NullArray) {
+  DZArray(int) arr = NULL;
+  dz_arrsort(arr, INT_LESS);
+  dz_arrradix_sort(arr);
+  const int item = 1;
+  ASSERT_EQ(dz_arrlower_bound(arr, &item, INT_LESS), 0);
+  ASSERT_EQ(dz_arrbsearch(arr, &item, INT_LESS), -1);
+  ASSERT_FALSE(arr);
+}
+
+TEST(DzArrSort, LowerBoundAndBsearch) {
+  for (size_t n : {1, 2, 3, 10, 1000}) {
+    // Even numbers, each twice
+    std::vector<int> items;
+    for (size_t i = 0; i < n; i++) {
+      items.push_back((int)(i / 2 * 2));
+    }
+    DZArray(int) arr = to_array(items);
+    for (int item = -1; item <= (int)n + 1; item++) {
+      const size_t expected =
+          std::lower_bound(items.begin(), items.end(), item) -
+          items.begin();
+      ASSERT_EQ(dz_arrlower_bound(arr, &item, INT_LESS), expected);
+      const ssize_t found = dz_arrbsearch(arr, &item, INT_LESS);
+      if (expected < n && items[expected] == item) {
+        ASSERT_EQ(found, (ssize_t)expected);
+      } else {
+        ASSERT_EQ(found, -1);
+      }
+    }
+    dz_arrfree(arr);
+  }
+}
+
+template <typename T>
+static void check_radix_sort(const size_t n, const uint64_t mask) {
+  std::vector<T> items(n);
+  uint64_t seed = n;
+  for (T &item : items) {
+    item = (T)(next_random(&seed) & mask);
+  }
+  DZArray(T) arr = NULL;
+  dz_arrpush_n(arr, items.data(), n);
+  ASSERT_TRUE(dz_arrradix_sort(arr));
+  std::sort(items.begin(), items.end());
+  ASSERT_EQ(dz_arrlen(arr), n);
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_EQ(arr[i], items[i]) << "at " << i;
+  }
+  dz_arrfree(arr);
+}
+
+TEST(DzArrSort, RadixSort) {
+  for (size_t n : {1, 2, 100, 100000}) {
+    check_radix_sort<uint8_t>(n, ~0ull);
+    check_radix_sort<int8_t>(n, ~0ull);
+    check_radix_sort<uint16_t>(n, ~0ull);
+    check_radix_sort<int16_t>(n, ~0ull);
+    check_radix_sort<uint32_t>(n, ~0ull);
+    check_radix_sort<int32_t>(n, ~0ull);
+    check_radix_sort<uint64_t>(n, ~0ull);
+    check_radix_sort<int64_t>(n, ~0ull);
+    // Small values in wide keys skip the passes of the upper bytes
+    check_radix_sort<uint64_t>(n, 0xFFFF);
+    check_radix_sort<int64_t>(n, 0x8000000000000FFFull);
+  }
+}
+
+TEST(DzArrSort, RadixSortByIsStable) {
+  DZArray(Record) arr = NULL;
+  std::vector<Record> records;
+  uint64_t seed = 2;
+  for (uint32_t i = 0; i < 20000; i++) {
+    const Record record = {(int32_t)(next_random(&seed) % 1000) - 500, i};
+    dz_arrpush(arr, record);
+    records.push_back(record);
+  }
+  ASSERT_TRUE(dz_arrradix_sort_by(arr, key));
+  std::stable_sort(records.begin(), records.end(),
+                   [](const Record &x, const Record &y) {
+                     return record_key_less(&x, &y);
+                   });
+  for (size_t i = 0; i < records.size(); i++) {
+    ASSERT_EQ(arr[i].key, records[i].key);
+    ASSERT_EQ(arr[i].order, records[i].order);
+  }
+  dz_arrfree(arr);
+}
+
+TEST(DzArrSort, RadixSortOutOfMemory) {
+  DZArena arena = dz_arena_init(4096);
+  DZAllocator allocator = dz_arena_allocator(&arena);
+  DZArray(uint32_t) arr = NULL;
+  dz_arrinit_ex(arr, &allocator);
+  for (uint32_t i = 0; i < 100; i++) {
+    dz_arrpush(arr, 100 - i);
+  }
+  // No room left in the arena for the scratch copy, which unsorted
+  // keys need
+  arena.first_empty_byte = arena.max_size;
+  ASSERT_FALSE(dz_arrradix_sort(arr));
+  for (uint32_t i = 0; i < 100; i++) {
+    ASSERT_EQ(arr[i], 100 - i);
+  }
+  // Neither does an array of equal keys, where every pass is skipped
+  for (uint32_t i = 0; i < 100; i++) {
+    arr[i] = 7;
+  }
+  ASSERT_TRUE(dz_arrradix_sort(arr));
+  dz_arrfree(arr);
+  dz_arena_free(&arena);
+}
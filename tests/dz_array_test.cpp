@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <cstddef>
+#include <vector>
 
 extern "C" {
+#include "dz_arena.h"
 #include "dz_array.h"
 }
 
@@ -233,6 +236,430 @@ TEST(Array, Clear) {
   dz_arrfree(arr);
 }
 
+TEST(Array, Allocator) {
+  DZArena arena = dz_arena_init(100000);
+  DZAllocator allocator = dz_arena_allocator(&arena);
+  DZArray(int) arr = NULL;
+  dz_arrinit_ex(arr, &allocator);
+  ASSERT_EQ(dz_array_header(arr)->allocator, &allocator);
+  ASSERT_EQ((uintptr_t)arr % 16, 0);
+  for (int i = 0; i < 1000; i++) {
+    dz_arrpush(arr, i);
+  }
+  ASSERT_EQ(dz_arrlen(arr), 1000);
+  ASSERT_EQ(arr[999], 999);
+  // Every growth came from the arena
+  ASSERT_GE((char *)arr, arena.data);
+  ASSERT_LT((char *)arr, arena.data + arena.first_empty_byte);
+  dz_arrfree(arr);
+  // The array was the newest block, so freeing it emptied the arena
+  ASSERT_EQ(arena.first_empty_byte, 0);
+  dz_arena_free(&arena);
+}
+
+TEST(Array, AllocatorOutOfMemory) {
+  DZArena arena = dz_arena_init(1024);
+  DZAllocator allocator = dz_arena_allocator(&arena);
+  DZArray(int) arr = NULL;
+  dz_arrinit_ex(arr, &allocator);
+  ASSERT_NE(arr, nullptr);
+  // Pushes that don't fit are dropped, and the array stays usable
+  for (int i = 0; i < 1000; i++) {
+    dz_arrpush(arr, i);
+  }
+  const size_t length = dz_arrlen(arr);
+  ASSERT_GT(length, 0);
+  ASSERT_LT(length, 1000);
+  ASSERT_LE(length, dz_array_header(arr)->capacity);
+  for (size_t i = 0; i < length; i++) {
+    ASSERT_EQ(arr[i], (int)i);
+  }
+  ASSERT_GT(dz_arrstats(arr).failed_allocs, 0);
+
+  const int items[] = {1, 2, 3};
+  dz_arrinsert(arr, 0, -1);
+  dz_arrpush_n(arr, items, 3);
+  dz_arrinsert_n(arr, 0, items, 3);
+  dz_arrresize(arr, 10000);
+  ASSERT_EQ(dz_arrlen(arr), length);
+  ASSERT_EQ(arr[0], 0);
+  dz_arrfree(arr);
+
+  // An allocator that is already full leaves the array NULL
+  arena.first_empty_byte = arena.max_size;
+  DZArray(int) empty = NULL;
+  dz_arrinit_ex(empty, &allocator);
+  ASSERT_EQ(empty, nullptr);
+  dz_arena_free(&arena);
+}
+
+TEST(Array, InitCapacity) {
+  DZArray(int) arr = NULL;
+  dz_arrinit_cap(arr, 2);
+  ASSERT_EQ(dz_arrlen(arr), 0);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 2);
+  dz_arrpush(arr, 1);
+  dz_arrpush(arr, 2);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 2);
+  dz_arrpush(arr, 3);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 4);
+  ASSERT_EQ(arr[2], 3);
+  dz_arrfree(arr);
+  // Even an empty array grows
+  DZArray(int) empty = NULL;
+  dz_arrinit_cap(empty, 0);
+  dz_arrpush(empty, 7);
+  ASSERT_EQ(dz_arrlen(empty), 1);
+  ASSERT_EQ(empty[0], 7);
+  dz_arrfree(empty);
+}
+
+TEST(Array, Reserve) {
+  DZArray(int) arr = NULL;
+  dz_arrreserve(arr, 1000);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 1000);
+  int *data = arr;
+  for (int i = 0; i < 1000; i++) {
+    dz_arrpush(arr, i);
+  }
+  ASSERT_EQ(arr, data);
+  // Never shrinks
+  dz_arrreserve(arr, 10);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 1000);
+  dz_arrfree(arr);
+}
+
+TEST(Array, ShrinkToFit) {
+  DZArray(int) arr = NULL;
+  for (int i = 0; i < 10; i++) {
+    dz_arrpush(arr, i);
+  }
+  dz_arrshrink_to_fit(arr);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 10);
+  ASSERT_EQ(arr[9], 9);
+  dz_arrclear(arr);
+  dz_arrshrink_to_fit(arr);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 0);
+  dz_arrpush(arr, 5);
+  ASSERT_EQ(arr[0], 5);
+  dz_arrfree(arr);
+}
+
+TEST(Array, PushN) {
+  int items[300];
+  for (int i = 0; i < 300; i++) {
+    items[i] = i;
+  }
+  DZArray(int) arr = NULL;
+  dz_arrpush_n(arr, items, 3);
+  ASSERT_EQ(dz_arrlen(arr), 3);
+  dz_arrpush_n(arr, items, 300);
+  ASSERT_EQ(dz_arrlen(arr), 303);
+  ASSERT_EQ(arr[2], 2);
+  ASSERT_EQ(arr[3], 0);
+  ASSERT_EQ(arr[302], 299);
+  dz_arrpush_n(arr, items, 0);
+  ASSERT_EQ(dz_arrlen(arr), 303);
+  dz_arrfree(arr);
+}
+
+TEST(Array, Resize) {
+  DZArray(int) arr = NULL;
+  dz_arrresize(arr, 100);
+  ASSERT_EQ(dz_arrlen(arr), 100);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(arr[i], 0);
+    arr[i] = i;
+  }
+  dz_arrresize(arr, 10);
+  ASSERT_EQ(dz_arrlen(arr), 10);
+  ASSERT_EQ(dz_array_header(arr)->capacity, 100);
+  // Items past the old length come back zeroed
+  dz_arrresize(arr, 20);
+  ASSERT_EQ(arr[9], 9);
+  ASSERT_EQ(arr[10], 0);
+  dz_arrresize(arr, 1000);
+  ASSERT_EQ(arr[999], 0);
+  ASSERT_EQ(arr[19], 0);
+  dz_arrfree(arr);
+}
+
+// Pushes and pops around the shrink boundary of an array that grew
+// to 100 items, and returns the reallocations it took
+static size_t oscillate(DZArray(int) & arr) {
+  for (int i = 0; i < 51; i++) {
+    dz_arrpush(arr, i);
+  }
+  const size_t before = dz_arrstats(arr).reallocs;
+  for (int round = 0; round < 100; round++) {
+    for (int i = 0; i < 10; i++) {
+      dz_arrpop(arr);
+    }
+    for (int i = 0; i < 10; i++) {
+      dz_arrpush(arr, i);
+    }
+  }
+  return dz_arrstats(arr).reallocs - before;
+}
+
+TEST(Array, PolicyHysteresis) {
+  // Shrinking as soon as half is free reallocates twice a round
+  DZArray(int) halving = NULL;
+  const DZArrayPolicy no_hysteresis = {2.0f, 2, 2};
+  dz_arrset_policy(halving, no_hysteresis);
+  ASSERT_EQ(oscillate(halving), 200);
+  dz_arrfree(halving);
+  // The default policy waits until three quarters are free
+  DZArray(int) arr = NULL;
+  ASSERT_EQ(oscillate(arr), 0);
+  for (int i = 0; i < 51; i++) {
+    dz_arrpop(arr);
+  }
+  ASSERT_EQ(dz_array_header(arr)->capacity, DZ_ARR_INIT_CAPACITY);
+  dz_arrfree(arr);
+}
+
+TEST(Array, PolicyNeverShrink) {
+  DZArray(int) arr = NULL;
+  dz_arrset_policy(arr, DZ_ARR_NEVER_SHRINK);
+  for (int i = 0; i < 1000; i++) {
+    dz_arrpush(arr, i);
+  }
+  const size_t capacity = dz_array_header(arr)->capacity;
+  while (dz_arrlen(arr)) {
+    dz_arrpop(arr);
+  }
+  ASSERT_EQ(dz_array_header(arr)->capacity, capacity);
+  dz_arrfree(arr);
+}
+
+TEST(Array, PolicyGrowthFactor) {
+  DZArray(int) arr = NULL;
+  const DZArrayPolicy policy = {1.5f, 4, 2};
+  dz_arrset_policy(arr, policy);
+  for (size_t i = 0; i < DZ_ARR_INIT_CAPACITY + 1; i++) {
+    dz_arrpush(arr, (int)i);
+  }
+  ASSERT_EQ(dz_array_header(arr)->capacity,
+            (size_t)(DZ_ARR_INIT_CAPACITY * 1.5));
+  dz_arrfree(arr);
+}
+
+TEST(Array, Stats) {
+  DZArray(int) arr = NULL;
+  ASSERT_EQ(dz_arrstats(arr).reallocs, 0);
+  for (size_t i = 0; i < DZ_ARR_INIT_CAPACITY * 6; i++) {
+    dz_arrpush(arr, (int)i);
+  }
+  // 50 -> 100 -> 200 -> 400
+  const DZArrayStats stats = dz_arrstats(arr);
+  ASSERT_EQ(stats.reallocs, 3);
+  ASSERT_LE(stats.bytes_moved,
+            3 * (sizeof(DZArrayHeader) + 200 * sizeof(int)));
+  dz_arrshrink_to_fit(arr);
+  ASSERT_EQ(dz_arrstats(arr).reallocs, 4);
+  dz_arrfree(arr);
+}
+
+TEST(Array, StatsStartAtZero) {
+  // Arena memory is reused as is, so the header starts out dirty
+  DZArena arena = dz_arena_init(1024);
+  DZAllocator allocator = dz_arena_allocator(&arena);
+  memset(arena.data, 0xff, arena.max_size);
+  DZArray(int) arr = NULL;
+  dz_arrinit_ex(arr, &allocator);
+  ASSERT_NE(arr, nullptr);
+  const DZArrayStats stats = dz_arrstats(arr);
+  ASSERT_EQ(stats.reallocs, 0);
+  ASSERT_EQ(stats.bytes_moved, 0);
+  ASSERT_EQ(stats.failed_allocs, 0);
+  dz_arrfree(arr);
+  dz_arena_free(&arena);
+}
+
+TEST(Array, RemoveRange) {
+  DZArray(int) arr = NULL;
+  for (int i = 0; i < 10; i++) {
+    dz_arrpush(arr, i);
+  }
+  dz_arrremove_range(arr, 2, 3);
+  const int expected[] = {0, 1, 5, 6, 7, 8, 9};
+  ASSERT_EQ(dz_arrlen(arr), 7);
+  for (size_t i = 0; i < 7; i++) {
+    ASSERT_EQ(arr[i], expected[i]);
+  }
+  dz_arrremove_range(arr, 5, 2);
+  ASSERT_EQ(dz_arrlen(arr), 5);
+  ASSERT_EQ(arr[4], 7);
+  dz_arrremove_range(arr, 0, 0);
+  ASSERT_EQ(dz_arrlen(arr), 5);
+  dz_arrremove_range(arr, 0, 5);
+  ASSERT_EQ(dz_arrlen(arr), 0);
+  dz_arrfree(arr);
+}
+
+TEST(Array, RemoveRangeShrinksOnce) {
+  DZArray(int) arr = NULL;
+  dz_arrresize(arr, 800);
+  const size_t capacity = dz_array_header(arr)->capacity;
+  const size_t reallocs = dz_arrstats(arr).reallocs;
+  dz_arrremove_range(arr, 0, 790);
+  ASSERT_EQ(dz_arrlen(arr), 10);
+  ASSERT_EQ(dz_array_header(arr)->capacity, capacity / 2);
+  ASSERT_EQ(dz_arrstats(arr).reallocs, reallocs + 1);
+  dz_arrfree(arr);
+}
+
+TEST(Array, InsertN) {
+  DZArray(int) arr = NULL;
+  const int items[] = {-1, -2, -3};
+  dz_arrinsert_n(arr, 0, items, 3);
+  ASSERT_EQ(dz_arrlen(arr), 3);
+  ASSERT_EQ(arr[2], -3);
+  for (int i = 0; i < 10; i++) {
+    dz_arrpush(arr, i);
+  }
+  dz_arrinsert_n(arr, 5, items, 3);
+  const int expected[] = {-1, -2, -3, 0, 1, -1, -2, -3,
+                          2,  3,  4,  5, 6, 7,  8,  9};
+  ASSERT_EQ(dz_arrlen(arr), 16);
+  for (size_t i = 0; i < 16; i++) {
+    ASSERT_EQ(arr[i], expected[i]);
+  }
+  dz_arrinsert_n(arr, 16, items, 1);
+  ASSERT_EQ(arr[16], -1);
+  dz_arrfree(arr);
+}
+
+TEST(Array, InsertNGrowsOnce) {
+  DZArray(int) arr = NULL;
+  for (size_t i = 0; i < DZ_ARR_INIT_CAPACITY; i++) {
+    dz_arrpush(arr, (int)i);
+  }
+  std::vector<int> items(1000, 7);
+  dz_arrinsert_n(arr, 1, items.data(), items.size());
+  ASSERT_EQ(dz_arrstats(arr).reallocs, 1);
+  ASSERT_EQ(dz_arrlen(arr), DZ_ARR_INIT_CAPACITY + 1000);
+  ASSERT_EQ(arr[0], 0);
+  ASSERT_EQ(arr[1000], 7);
+  ASSERT_EQ(arr[1001], 1);
+  ASSERT_EQ(arr[dz_arrlen(arr) - 1], (int)DZ_ARR_INIT_CAPACITY - 1);
+  dz_arrfree(arr);
+}
+
+static bool is_odd(const int *item) { return *item % 2; }
+#define IS_MULTIPLE_OF_3(item) (*(item) % 3 == 0)
+
+TEST(Array, RemoveIf) {
+  DZArray(int) arr = NULL;
+  dz_arrremove_if(arr, is_odd);
+  ASSERT_FALSE(arr);
+  for (int i = 0; i < 1000; i++) {
+    dz_arrpush(arr, i);
+  }
+  dz_arrremove_if(arr, is_odd);
+  ASSERT_EQ(dz_arrlen(arr), 500);
+  for (int i = 0; i < 500; i++) {
+    ASSERT_EQ(arr[i], 2 * i);
+  }
+  dz_arrremove_if(arr, IS_MULTIPLE_OF_3);
+  for (size_t i = 0; i < dz_arrlen(arr); i++) {
+    ASSERT_NE(arr[i] % 3, 0);
+    ASSERT_TRUE(i == 0 || arr[i] > arr[i - 1]);
+  }
+  ASSERT_EQ(dz_arrlen(arr), 333);
+  dz_arrfree(arr);
+}
+
+struct Rgb {
+  uint8_t r, g, b;
+};
+
+// Fills arrays of every length up to 100 with items of type T, made
+// from small numbers so that they repeat, and checks every search
+// against a plain loop, with every kernel the CPU supports
+template <typename T>
+static void check_search(T (*make)(int)) {
+  const DZArraySearchIsa best = dz_impl_arr_search_isa();
+  for (DZArraySearchIsa isa :
+       {DZ_ARR_SEARCH_SCALAR, DZ_ARR_SEARCH_SSE2, DZ_ARR_SEARCH_AVX2}) {
+    if (!dz_impl_arr_search_set_isa(isa)) {
+      continue;
+    }
+    for (int length = 0; length <= 100; length++) {
+      DZArray(T) arr = NULL;
+      for (int i = 0; i < length; i++) {
+        dz_arrpush(arr, make(i * 7 % 23));
+      }
+      std::vector<T> needles;
+      std::vector<ssize_t> expected;
+      for (int value = 0; value < 25; value++) {
+        const T needle = make(value);
+        ssize_t first = -1;
+        size_t count = 0;
+        for (int i = 0; i < length; i++) {
+          if (!memcmp(&arr[i], &needle, sizeof(T))) {
+            first = first == -1 ? i : first;
+            count++;
+          }
+        }
+        ASSERT_EQ(dz_arrindexof(arr, &needle), first)
+            << "isa " << isa << " length " << length;
+        ASSERT_EQ(dz_arrcontains(arr, &needle), first != -1);
+        ASSERT_EQ(dz_arrcount(arr, &needle), count);
+        needles.push_back(needle);
+        expected.push_back(first);
+      }
+      std::vector<ssize_t> indexes(needles.size());
+      dz_arrindexof_many(arr, needles.data(), needles.size(),
+                         indexes.data());
+      ASSERT_EQ(indexes, expected);
+      dz_arrfree(arr);
+    }
+  }
+  dz_impl_arr_search_set_isa(best);
+}
+
+TEST(Array, SearchScalarSizes) {
+  check_search<uint8_t>([](int v) { return (uint8_t)v; });
+  check_search<int16_t>([](int v) { return (int16_t)(v * 0x101); });
+  check_search<uint32_t>(
+      [](int v) { return (uint32_t)v * 0x01000193u; });
+  // Values only differing in one 32 bit half
+  check_search<uint64_t>(
+      [](int v) { return (uint64_t)(v % 5) << 32 | (uint64_t)(v / 5); });
+  check_search<double>([](int v) { return v - 0.5; });
+}
+
+TEST(Array, SearchOtherSizes) {
+  check_search<Rgb>([](int v) { return Rgb{1, (uint8_t)v, 2}; });
+  struct Triple {
+    int32_t a, b, c;
+  };
+  check_search<Triple>([](int v) { return Triple{0, v, 0}; });
+}
+
+TEST(Array, SearchIsBitwise) {
+  DZArray(double) arr = NULL;
+  dz_arrpush(arr, 0.0);
+  dz_arrpush(arr, -0.0);
+  const double negative_zero = -0.0;
+  ASSERT_EQ(dz_arrindexof(arr, &negative_zero), 1);
+  ASSERT_EQ(dz_arrcount(arr, &negative_zero), 1);
+  dz_arrfree(arr);
+}
+
+TEST(Array, SearchNull) {
+  DZArray(int) arr = NULL;
+  const int item = 3;
+  ASSERT_EQ(dz_arrindexof(arr, &item), -1);
+  ASSERT_FALSE(dz_arrcontains(arr, &item));
+  ASSERT_EQ(dz_arrcount(arr, &item), 0);
+  ssize_t index = 0;
+  dz_arrindexof_many(arr, &item, 1, &index);
+  ASSERT_EQ(index, -1);
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "dz_concurrent_hashmap.h"
+}
+
+TEST(ConcurrentHashmap, InsertGetDelete) {
+  DzHmError error = DzHmError_None;
+  DzConcurrentHashmap chm = chm_init(0, &error);
+  ASSERT_TRUE(chm);
+  ASSERT_EQ(error, DzHmError_None);
+  chm_add_str(chm, "key1", "value1", &error);
+  ASSERT_EQ(error, DzHmError_None);
+  ASSERT_EQ(chm_count(chm), 1);
+  char value[16];
+  ASSERT_EQ(chm_get_str(chm, "key1", value, sizeof(value)), 7);
+  ASSERT_STREQ(value, "value1");
+  ASSERT_TRUE(chm_contains(chm, "key1", 5));
+  chm_add_str(chm, "key1", "other", &error);
+  ASSERT_EQ(chm_get_str(chm, "key1", value, sizeof(value)), 6);
+  ASSERT_STREQ(value, "other");
+  ASSERT_EQ(chm_count(chm), 1);
+  chm_delete_str(chm, "key1");
+  ASSERT_EQ(chm_count(chm), 0);
+  ASSERT_EQ(chm_get_str(chm, "key1", value, sizeof(value)), 0);
+  ASSERT_FALSE(chm_contains(chm, "key1", 5));
+  chm_free(chm);
+}
+
+TEST(ConcurrentHashmap, ValueTooBigForBuffer) {
+  DzConcurrentHashmap chm = chm_init(4, NULL);
+  chm_add_str(chm, "key", "a long value", NULL);
+  char value[4] = "xyz";
+  ASSERT_EQ(chm_get_str(chm, "key", value, sizeof(value)), 13);
+  // Nothing is copied when the value doesn't fit
+  ASSERT_STREQ(value, "xyz");
+  chm_free(chm);
+}
+
+TEST(ConcurrentHashmap, SingleShard) {
+  DzConcurrentHashmap chm = chm_init(1, NULL);
+  for (uint64_t i = 0; i < 1000; i++) {
+    chm_add(chm, &i, sizeof(i), &i, sizeof(i), NULL);
+  }
+  ASSERT_EQ(chm_count(chm), 1000);
+  for (uint64_t i = 0; i < 1000; i++) {
+    uint64_t value = 0;
+    ASSERT_EQ(chm_get(chm, &i, sizeof(i), &value, sizeof(value)),
+              sizeof(value));
+    ASSERT_EQ(value, i);
+  }
+  chm_free(chm);
+}
+
+// Every thread owns a range of keys, which it keeps adding,
+// overwriting and deleting, while reader threads look up keys from
+// every range. A value is always written as {key, key ^ version}, so
+// readers can tell a torn or mismatched value apart from a valid one.
+TEST(ConcurrentHashmap, Stress) {
+  const size_t writers = 4;
+  const size_t readers = 4;
+  const uint64_t keys_per_writer = 5000;
+  const uint64_t rounds = 4;
+  DzConcurrentHashmap chm = chm_init(16, NULL);
+  std::atomic<bool> done(false);
+  std::atomic<size_t> bad_reads(0);
+  std::atomic<size_t> reads(0);
+  std::vector<std::thread> threads;
+  for (size_t w = 0; w < writers; w++) {
+    threads.emplace_back([&, w]() {
+      const uint64_t first = w * keys_per_writer;
+      for (uint64_t round = 0; round < rounds; round++) {
+        for (uint64_t k = first; k < first + keys_per_writer; k++) {
+          const uint64_t value[2] = {k, k ^ round};
+          chm_add(chm, &k, sizeof(k), value, sizeof(value), NULL);
+        }
+        for (uint64_t k = first; k < first + keys_per_writer; k += 3) {
+          chm_delete(chm, &k, sizeof(k));
+        }
+      }
+      // Leave every key in place, with the final version
+      for (uint64_t k = first; k < first + keys_per_writer; k++) {
+        const uint64_t value[2] = {k, k ^ rounds};
+        chm_add(chm, &k, sizeof(k), value, sizeof(value), NULL);
+      }
+    });
+  }
+  for (size_t r = 0; r < readers; r++) {
+    threads.emplace_back([&, r]() {
+      uint64_t k = r;
+      while (!done.load()) {
+        k = (k * 7 + 13) % (writers * keys_per_writer);
+        uint64_t value[2];
+        const size_t size =
+            chm_get(chm, &k, sizeof(k), value, sizeof(value));
+        if (size && (size != sizeof(value) || value[0] != k ||
+                     (value[1] ^ k) > rounds)) {
+          bad_reads++;
+        }
+        reads++;
+      }
+    });
+  }
+  for (size_t w = 0; w < writers; w++) {
+    threads[w].join();
+  }
+  done = true;
+  for (size_t r = 0; r < readers; r++) {
+    threads[writers + r].join();
+  }
+  ASSERT_EQ(bad_reads.load(), 0);
+  ASSERT_GT(reads.load(), 0);
+  ASSERT_EQ(chm_count(chm), writers * keys_per_writer);
+  for (uint64_t k = 0; k < writers * keys_per_writer; k++) {
+    uint64_t value[2];
+    ASSERT_EQ(chm_get(chm, &k, sizeof(k), value, sizeof(value)),
+              sizeof(value));
+    ASSERT_EQ(value[0], k);
+    ASSERT_EQ(value[1], k ^ rounds);
+  }
+  chm_free(chm);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <set>
+
+extern "C" {
+#include "dz_hash.h"
+}
+
+TEST(Hash, Deterministic) {
+  const char *key = "some key";
+  ASSERT_EQ(dz_hash_bytes(key, strlen(key), 42),
+            dz_hash_bytes(key, strlen(key), 42));
+}
+
+TEST(Hash, SeedChangesHash) {
+  const char *key = "some key";
+  ASSERT_NE(dz_hash_bytes(key, strlen(key), 1),
+            dz_hash_bytes(key, strlen(key), 2));
+}
+
+TEST(Hash, EmptyInput) {
+  ASSERT_EQ(dz_hash_bytes(NULL, 0, 7), dz_hash_bytes("", 0, 7));
+  ASSERT_NE(dz_hash_bytes(NULL, 0, 7), dz_hash_bytes(NULL, 0, 8));
+}
+
+TEST(Hash, EveryLengthDistinct) {
+  // Prefixes of the same buffer must all hash differently, which
+  // covers every branch of the word-at-a-time loop
+  char buffer[200];
+  for (size_t i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = (char)('a' + i % 26);
+  }
+  std::set<uint64_t> hashes;
+  for (size_t len = 0; len <= sizeof(buffer); len++) {
+    hashes.insert(dz_hash_bytes(buffer, len, 0));
+  }
+  ASSERT_EQ(hashes.size(), sizeof(buffer) + 1);
+}
+
+TEST(Hash, EveryByteMatters) {
+  char buffer[100] = {0};
+  const uint64_t base = dz_hash_bytes(buffer, sizeof(buffer), 0);
+  for (size_t i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = 1;
+    ASSERT_NE(dz_hash_bytes(buffer, sizeof(buffer), 0), base);
+    buffer[i] = 0;
+  }
+}
+
+TEST(Hash, Unaligned) {
+  char buffer[64];
+  char shifted[65];
+  for (size_t i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = (char)i;
+    shifted[i + 1] = (char)i;
+  }
+  ASSERT_EQ(dz_hash_bytes(buffer, sizeof(buffer), 3),
+            dz_hash_bytes(shifted + 1, sizeof(buffer), 3));
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+TEST(Hash, U64) {
+  ASSERT_EQ(dz_hash_u64(1234, 42), dz_hash_u64(1234, 42));
+  ASSERT_NE(dz_hash_u64(1234, 1), dz_hash_u64(1234, 2));
+  // Consecutive keys must spread over the low bits, which pick the
+  // fingerprint and the group
+  std::set<uint64_t> low_bits;
+  for (uint64_t i = 0; i < 4096; i++) {
+    low_bits.insert(dz_hash_u64(i, 7) & 0xFFF);
+  }
+  ASSERT_GT(low_bits.size(), 2000);
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "dz_hashmap_bulk.h"
+}
+
+// Parallel arrays of n uint64_t keys and values, in the form
+// hm_build_bulk takes them
+struct BulkInput {
+  std::vector<uint64_t> key_data;
+  std::vector<uint64_t> value_data;
+  std::vector<const void *> keys;
+  std::vector<const void *> values;
+  std::vector<size_t> keysizes;
+  std::vector<size_t> valuesizes;
+
+  BulkInput(const size_t n, const uint64_t key_mod)
+      : key_data(n), value_data(n), keys(n), values(n),
+        keysizes(n, sizeof(uint64_t)), valuesizes(n, sizeof(uint64_t)) {
+    for (size_t i = 0; i < n; i++) {
+      key_data[i] = (i % key_mod) * 0x9e3779b97f4a7c15ull;
+      value_data[i] = i;
+      keys[i] = &key_data[i];
+      values[i] = &value_data[i];
+    }
+  }
+};
+
+TEST(DzHmBulk, MatchesHmAdd) {
+  const size_t n = 100000;
+  BulkInput input(n, n);
+  for (size_t nthreads : {1, 2, 4, 8}) {
+    DzHmError error = DzHmError_None;
+    DzHashmap hm =
+        hm_build_bulk(input.keys.data(), input.keysizes.data(),
+                      input.values.data(), input.valuesizes.data(), n,
+                      nthreads, &error);
+    ASSERT_TRUE(hm);
+    ASSERT_EQ(error, DzHmError_None);
+    ASSERT_EQ(hm_count(hm), n);
+    for (size_t i = 0; i < n; i++) {
+      size_t valuesize = 0;
+      const uint64_t *value = (const uint64_t *)hm_get_with_size(
+          hm, &input.key_data[i], sizeof(uint64_t), &valuesize);
+      ASSERT_TRUE(value);
+      ASSERT_EQ(valuesize, sizeof(uint64_t));
+      ASSERT_EQ(*value, i);
+    }
+    for (uint64_t i = 0; i < 1000; i++) {
+      const uint64_t missing = i * 0x9e3779b97f4a7c15ull + 1;
+      ASSERT_FALSE(hm_get(hm, &missing, sizeof(missing)));
+    }
+    hm_free(hm);
+  }
+}
+
+TEST(DzHmBulk, LastValueWins) {
+  // Every key is given 50 times, spread over the whole input
+  const size_t n = 50000;
+  const uint64_t distinct = 1000;
+  BulkInput input(n, distinct);
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_build_bulk(
+      input.keys.data(), input.keysizes.data(), input.values.data(),
+      input.valuesizes.data(), n, 4, &error);
+  ASSERT_TRUE(hm);
+  ASSERT_EQ(hm_count(hm), distinct);
+  for (uint64_t k = 0; k < distinct; k++) {
+    const uint64_t key = k * 0x9e3779b97f4a7c15ull;
+    const uint64_t *value =
+        (const uint64_t *)hm_get(hm, &key, sizeof(key));
+    ASSERT_TRUE(value);
+    ASSERT_EQ(*value, n - distinct + k);
+  }
+  hm_free(hm);
+}
+
+TEST(DzHmBulk, MixedSizes) {
+  const size_t n = 20000;
+  std::vector<std::string> key_data(n);
+  std::vector<std::string> value_data(n);
+  std::vector<const void *> keys(n);
+  std::vector<const void *> values(n);
+  std::vector<size_t> keysizes(n);
+  std::vector<size_t> valuesizes(n);
+  for (size_t i = 0; i < n; i++) {
+    key_data[i] = "key" + std::to_string(i);
+    // Some values are bigger than the biggest slab size class
+    value_data[i] = std::string(i % 100 == 0 ? 5000 : i % 50, 'v');
+    keys[i] = key_data[i].data();
+    keysizes[i] = key_data[i].size();
+    values[i] = i % 7 == 0 ? NULL : value_data[i].data();
+    valuesizes[i] = value_data[i].size();
+  }
+  DzHmError error = DzHmError_None;
+  DzHashmap hm =
+      hm_build_bulk(keys.data(), keysizes.data(), values.data(),
+                    valuesizes.data(), n, 3, &error);
+  ASSERT_TRUE(hm);
+  ASSERT_EQ(hm_count(hm), n);
+  for (size_t i = 0; i < n; i++) {
+    size_t valuesize = 0;
+    const char *value = (const char *)hm_get_with_size(
+        hm, keys[i], keysizes[i], &valuesize);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(valuesize, value_data[i].size());
+    // NULL values are zero-filled
+    const std::string expected =
+        i % 7 == 0 ? std::string(valuesize, '\0') : value_data[i];
+    ASSERT_EQ(std::string(value, valuesize), expected);
+  }
+  hm_free(hm);
+}
+
+TEST(DzHmBulk, NullValuesArray) {
+  const size_t n = 10000;
+  BulkInput input(n, n);
+  DzHashmap hm =
+      hm_build_bulk(input.keys.data(), input.keysizes.data(), NULL,
+                    input.valuesizes.data(), n, 2, NULL);
+  ASSERT_TRUE(hm);
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t *value = (const uint64_t *)hm_get(
+        hm, &input.key_data[i], sizeof(uint64_t));
+    ASSERT_TRUE(value);
+    ASSERT_EQ(*value, 0);
+  }
+  hm_free(hm);
+}
+
+TEST(DzHmBulk, Empty) {
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_build_bulk(NULL, NULL, NULL, NULL, 0, 0, &error);
+  ASSERT_TRUE(hm);
+  ASSERT_EQ(error, DzHmError_None);
+  ASSERT_EQ(hm_count(hm), 0);
+  hm_add_str(hm, "a", "b", &error);
+  ASSERT_STREQ(hm_get_str(hm, "a"), "b");
+  hm_free(hm);
+}
+
+TEST(DzHmBulk, RejectsInvalidPairs) {
+  const size_t n = 20000;
+  const size_t bad = n - 1;
+  for (int kind = 0; kind < 4; kind++) {
+    for (size_t nthreads : {1, 4}) {
+      BulkInput input(n, n);
+      switch (kind) {
+        case 0:
+          input.keys[bad] = NULL;
+          break;
+        case 1:
+          input.keysizes[bad] = 0;
+          break;
+        case 2:
+          input.keysizes[bad] = (size_t)INT32_MAX + 1;
+          break;
+        default:
+          input.valuesizes[bad] = (size_t)INT32_MAX + 1;
+          break;
+      }
+      DzHmError error = DzHmError_None;
+      DzHashmap hm = hm_build_bulk(
+          input.keys.data(), input.keysizes.data(), input.values.data(),
+          input.valuesizes.data(), n, nthreads, &error);
+      ASSERT_FALSE(hm) << "kind " << kind;
+      ASSERT_EQ(error, DzHmError_Argument) << "kind " << kind;
+    }
+  }
+}
+
+TEST(DzHmBulk, ResultIsANormalHashmap) {
+  const size_t n = 30000;
+  BulkInput input(n, n);
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_build_bulk(
+      input.keys.data(), input.keysizes.data(), input.values.data(),
+      input.valuesizes.data(), n, 0, &error);
+  ASSERT_TRUE(hm);
+  DzHmStats stats;
+  hm_stats(hm, &stats);
+  ASSERT_EQ(stats.count, n);
+  ASSERT_EQ(stats.tombstones, 0);
+  ASSERT_EQ(stats.resize_count, 0);
+  // Deleting, overwriting and growing past the presized table
+  for (size_t i = 0; i < n; i += 2) {
+    hm_delete(hm, &input.key_data[i], sizeof(uint64_t));
+  }
+  for (uint64_t i = 0; i < 3 * n; i++) {
+    const uint64_t key = i + 1;
+    hm_add(hm, &key, sizeof(key), &i, sizeof(i), &error);
+  }
+  ASSERT_EQ(error, DzHmError_None);
+  for (size_t i = 1; i < n; i += 2) {
+    const uint64_t *value = (const uint64_t *)hm_get(
+        hm, &input.key_data[i], sizeof(uint64_t));
+    ASSERT_TRUE(value);
+    ASSERT_EQ(*value, i);
+  }
+  ASSERT_FALSE(hm_get(hm, &input.key_data[2], sizeof(uint64_t)));
+  hm_free(hm);
+}
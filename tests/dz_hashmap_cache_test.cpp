@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "dz_hashmap_cache.h"
+}
+
+static void record_eviction(const void *key, size_t keysize,
+                            const void *value, size_t valuesize,
+                            void *user) {
+  EXPECT_EQ(keysize, sizeof(uint64_t));
+  EXPECT_EQ(valuesize, sizeof(uint64_t));
+  EXPECT_EQ(*(const uint64_t *)value, *(const uint64_t *)key * 10);
+  ((std::vector<uint64_t> *)user)->push_back(*(const uint64_t *)key);
+}
+
+static void put_u64(DzHmCache cache, uint64_t key) {
+  const uint64_t value = key * 10;
+  DzHmError error = DzHmError_None;
+  hm_cache_put(cache, &key, sizeof(key), &value, sizeof(value), &error);
+  ASSERT_EQ(error, DzHmError_None);
+}
+
+static bool has_u64(DzHmCache cache, uint64_t key) {
+  return hm_cache_get(cache, &key, sizeof(key), NULL) != NULL;
+}
+
+TEST(DzHmCache, EntryLimit) {
+  DzHmError error = DzHmError_None;
+  DzHmCache cache = hm_cache_init(100, 0, &error);
+  ASSERT_TRUE(cache);
+  std::vector<uint64_t> evicted;
+  hm_cache_set_evict_callback(cache, record_eviction, &evicted);
+  for (uint64_t i = 0; i < 100; i++) {
+    put_u64(cache, i);
+  }
+  ASSERT_EQ(hm_cache_count(cache), 100u);
+  ASSERT_TRUE(evicted.empty());
+  for (uint64_t i = 100; i < 1000; i++) {
+    put_u64(cache, i);
+    ASSERT_EQ(hm_cache_count(cache), 100u);
+  }
+  ASSERT_EQ(evicted.size(), 900u);
+
+  DzHmCacheStats stats;
+  hm_cache_stats(cache, &stats);
+  ASSERT_EQ(stats.count, 100u);
+  ASSERT_EQ(stats.evictions, 900u);
+  ASSERT_EQ(stats.bytes, 100 * 2 * sizeof(uint64_t));
+  hm_cache_free(cache);
+}
+
+TEST(DzHmCache, UsedItemsSurvive) {
+  DzHmCache cache = hm_cache_init(64, 0, NULL);
+  for (uint64_t i = 0; i < 64; i++) {
+    put_u64(cache, i);
+  }
+  // Keep reading a hot set while streaming cold keys through
+  for (uint64_t i = 1000; i < 5000; i++) {
+    for (uint64_t hot = 0; hot < 8; hot++) {
+      ASSERT_TRUE(has_u64(cache, hot)) << "hot key " << hot;
+    }
+    put_u64(cache, i);
+  }
+  DzHmCacheStats stats;
+  hm_cache_stats(cache, &stats);
+  ASSERT_EQ(stats.hits, 4000u * 8);
+  ASSERT_EQ(stats.misses, 0u);
+  ASSERT_DOUBLE_EQ(stats.hit_rate, 1.0);
+  ASSERT_FALSE(has_u64(cache, 1000));
+  hm_cache_stats(cache, &stats);
+  ASSERT_EQ(stats.misses, 1u);
+  hm_cache_free(cache);
+}
+
+TEST(DzHmCache, ByteLimit) {
+  DzHmError error = DzHmError_None;
+  DzHmCache cache = hm_cache_init(0, 1000, &error);
+  ASSERT_TRUE(cache);
+  const std::string value(90, 'v');
+  for (int i = 0; i < 100; i++) {
+    const std::string key = "key" + std::to_string(i);
+    hm_cache_put_str(cache, key.c_str(), value.c_str(), &error);
+    ASSERT_EQ(error, DzHmError_None);
+    DzHmCacheStats stats;
+    hm_cache_stats(cache, &stats);
+    ASSERT_LE(stats.bytes, 1000u);
+  }
+  ASSERT_LT(hm_cache_count(cache), 11u);
+  ASSERT_STREQ(hm_cache_get_str(cache, "key99"), value.c_str());
+
+  // Growing a value can push other items out
+  const std::string big(900, 'b');
+  hm_cache_put_str(cache, "key99", big.c_str(), &error);
+  ASSERT_EQ(error, DzHmError_None);
+  ASSERT_EQ(hm_cache_count(cache), 1u);
+  ASSERT_STREQ(hm_cache_get_str(cache, "key99"), big.c_str());
+
+  const std::string too_big(1000, 't');
+  hm_cache_put_str(cache, "too big", too_big.c_str(), &error);
+  ASSERT_EQ(error, DzHmError_Argument);
+  ASSERT_FALSE(hm_cache_get_str(cache, "too big"));
+  hm_cache_free(cache);
+}
+
+TEST(DzHmCache, GrownItemIsNotEvicted) {
+  // With every bit set, the hand clears them all and then evicts the
+  // first item it reaches, whichever slot that is
+  const std::string value(90, 'v');
+  const std::string big(500, 'b');
+  for (int target = 0; target < 10; target++) {
+    DzHmError error = DzHmError_None;
+    DzHmCache cache = hm_cache_init(0, 1000, &error);
+    ASSERT_TRUE(cache);
+    for (int i = 0; i < 10; i++) {
+      const std::string key = "key" + std::to_string(i);
+      hm_cache_put_str(cache, key.c_str(), value.c_str(), &error);
+    }
+    ASSERT_EQ(hm_cache_count(cache), 10u);
+    for (int i = 0; i < 10; i++) {
+      const std::string key = "key" + std::to_string(i);
+      ASSERT_TRUE(hm_cache_get_str(cache, key.c_str()));
+    }
+    const std::string key = "key" + std::to_string(target);
+    hm_cache_put_str(cache, key.c_str(), big.c_str(), &error);
+    ASSERT_EQ(error, DzHmError_None);
+    ASSERT_STREQ(hm_cache_get_str(cache, key.c_str()), big.c_str())
+        << "target " << target;
+    DzHmCacheStats stats;
+    hm_cache_stats(cache, &stats);
+    ASSERT_LE(stats.bytes, 1000u);
+    hm_cache_free(cache);
+  }
+}
+
+TEST(DzHmCache, OverwriteAndDelete) {
+  DzHmCache cache = hm_cache_init(2, 0, NULL);
+  std::vector<uint64_t> evicted;
+  hm_cache_set_evict_callback(cache, record_eviction, &evicted);
+  put_u64(cache, 1);
+  put_u64(cache, 2);
+  put_u64(cache, 2);
+  ASSERT_EQ(hm_cache_count(cache), 2u);
+  ASSERT_TRUE(evicted.empty());
+  const uint64_t one = 1;
+  hm_cache_delete(cache, &one, sizeof(one));
+  hm_cache_delete(cache, &one, sizeof(one));
+  ASSERT_EQ(hm_cache_count(cache), 1u);
+  ASSERT_TRUE(evicted.empty());
+  put_u64(cache, 3);
+  ASSERT_TRUE(evicted.empty());
+  put_u64(cache, 4);
+  ASSERT_EQ(evicted.size(), 1u);
+  ASSERT_EQ(hm_cache_count(cache), 2u);
+  DzHmCacheStats stats;
+  hm_cache_stats(cache, &stats);
+  ASSERT_EQ(stats.bytes, 2 * 2 * sizeof(uint64_t));
+  hm_cache_free(cache);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <string>
+
+extern "C" {
+#include "dz_hashmap_frozen.h"
+}
+
+TEST(DzHmFrozen, RoundTrip) {
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_init(&error);
+  const uint64_t n = 20000;
+  for (uint64_t i = 0; i < n; i++) {
+    const uint64_t value = i * 3;
+    hm_add(hm, &i, sizeof(i), &value, sizeof(value), &error);
+  }
+  DzHmFrozen frozen = hm_freeze(hm, &error);
+  ASSERT_TRUE(frozen);
+  ASSERT_EQ(error, DzHmError_None);
+  hm_free(hm);
+
+  ASSERT_EQ(hm_frozen_count(frozen), n);
+  for (uint64_t i = 0; i < n; i++) {
+    size_t valuesize = 0;
+    const uint64_t *value = (const uint64_t *)hm_frozen_get(
+        frozen, &i, sizeof(i), &valuesize);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(valuesize, sizeof(uint64_t));
+    ASSERT_EQ(*value, i * 3);
+  }
+  // Misses land on some other key's slot, and fail the compare
+  for (uint64_t i = n; i < 2 * n; i++) {
+    ASSERT_FALSE(hm_frozen_get(frozen, &i, sizeof(i), NULL));
+  }
+  const uint32_t short_key = 1;
+  ASSERT_FALSE(hm_frozen_get(frozen, &short_key, sizeof(short_key),
+                             NULL));
+  EXPECT_GT(hm_frozen_bits_per_key(frozen), 0);
+  EXPECT_LT(hm_frozen_bits_per_key(frozen), 16);
+  EXPECT_GT(hm_frozen_size_bytes(frozen), n * 2 * sizeof(uint64_t));
+  hm_frozen_free(frozen);
+}
+
+TEST(DzHmFrozen, Strings) {
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_init(&error);
+  for (int i = 0; i < 500; i++) {
+    const std::string key = "key" + std::to_string(i);
+    const std::string value = std::string(i % 40, 'v');
+    hm_add_str(hm, key.c_str(), value.c_str(), &error);
+  }
+  // Overwritten and deleted items are not part of the frozen map
+  hm_add_str(hm, "key0", "changed", &error);
+  hm_delete_str(hm, "key1");
+  DzHmFrozen frozen = hm_freeze(hm, &error);
+  ASSERT_TRUE(frozen);
+  hm_free(hm);
+
+  EXPECT_EQ(hm_frozen_count(frozen), 499u);
+  EXPECT_STREQ(hm_frozen_get_str(frozen, "key0"), "changed");
+  EXPECT_FALSE(hm_frozen_get_str(frozen, "key1"));
+  for (int i = 2; i < 500; i++) {
+    const std::string key = "key" + std::to_string(i);
+    EXPECT_EQ(hm_frozen_get_str(frozen, key.c_str()),
+              std::string(i % 40, 'v'));
+  }
+  EXPECT_FALSE(hm_frozen_get_str(frozen, "key500"));
+  hm_frozen_free(frozen);
+}
+
+TEST(DzHmFrozen, Empty) {
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_init(&error);
+  DzHmFrozen frozen = hm_freeze(hm, &error);
+  ASSERT_TRUE(frozen);
+  ASSERT_EQ(error, DzHmError_None);
+  hm_free(hm);
+  EXPECT_EQ(hm_frozen_count(frozen), 0u);
+  EXPECT_FALSE(hm_frozen_get_str(frozen, "missing"));
+  EXPECT_EQ(hm_frozen_bits_per_key(frozen), 0);
+  hm_frozen_free(frozen);
+}
+
+TEST(DzHmFrozen, DuringIncrementalResize) {
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_init(&error);
+  hm_set_incremental_resize(hm, true);
+  const uint64_t n = 5000;
+  for (uint64_t i = 0; i < n; i++) {
+    hm_add(hm, &i, sizeof(i), &i, sizeof(i), &error);
+  }
+  DzHmFrozen frozen = hm_freeze(hm, &error);
+  ASSERT_TRUE(frozen);
+  hm_free(hm);
+  ASSERT_EQ(hm_frozen_count(frozen), n);
+  for (uint64_t i = 0; i < n; i++) {
+    const uint64_t *value =
+        (const uint64_t *)hm_frozen_get(frozen, &i, sizeof(i), NULL);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(*value, i);
+  }
+  hm_frozen_free(frozen);
+}
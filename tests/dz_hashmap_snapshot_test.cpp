@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+extern "C" {
+#include "dz_hashmap_snapshot.h"
+}
+
+// A path in the temporary directory that is removed at the end of
+// the test
+class SnapshotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char name[] = "/tmp/dz_snapshot_XXXXXX";
+    const int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path = name;
+  }
+  void TearDown() override { unlink(path.c_str()); }
+
+  // Flips one byte of the file at offset
+  void corrupt(long offset) {
+    FILE *file = fopen(path.c_str(), "r+b");
+    ASSERT_TRUE(file);
+    fseek(file, offset, SEEK_SET);
+    const int byte = fgetc(file);
+    fseek(file, offset, SEEK_SET);
+    fputc(byte ^ 0xFF, file);
+    fclose(file);
+  }
+
+  std::string path;
+};
+
+TEST_F(SnapshotTest, RoundTrip) {
+  DzHmError error = DzHmError_None;
+  DzHashmap hm = hm_init(&error);
+  const uint64_t n = 10000;
+  for (uint64_t i = 0; i < n; i++) {
+    const uint64_t value = i * 7;
+    hm_add(hm, &i, sizeof(i), &value, sizeof(value), &error);
+  }
+  hm_add_str(hm, "name", "a string value", &error);
+  hm_save(hm, path.c_str(), &error);
+  ASSERT_EQ(error, DzHmError_None);
+  hm_free(hm);
+
+  DzHmSnapshot snapshot = hm_open_mmap(path.c_str(), true, &error);
+  ASSERT_TRUE(snapshot);
+  ASSERT_EQ(error, DzHmError_None);
+  ASSERT_EQ(hm_snapshot_count(snapshot), n + 1);
+  for (uint64_t i = 0; i < n; i++) {
+    size_t valuesize = 0;
+    const uint64_t *value = (const uint64_t *)hm_snapshot_get(
+        snapshot, &i, sizeof(i), &valuesize);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(valuesize, sizeof(uint64_t));
+    ASSERT_EQ(*value, i * 7);
+  }
+  const uint64_t missing = n + 1;
+  ASSERT_EQ(hm_snapshot_get(snapshot, &missing, sizeof(missing), NULL),
+            (void *)NULL);
+  ASSERT_STREQ(hm_snapshot_get_str(snapshot, "name"), "a string value");
+  hm_snapshot_close(snapshot);
+}
+
+TEST_F(SnapshotTest, SavesBothTablesDuringIncrementalResize) {
+  DzHashmap hm = hm_init(NULL);
+  hm_set_incremental_resize(hm, true);
+  const uint64_t n = 57;  // Just past the first resize of 64 slots
+  for (uint64_t i = 0; i < n; i++) {
+    hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+  }
+  hm_set_inline_small_items(hm, true);
+  const uint64_t small = n;
+  hm_add(hm, &small, sizeof(small), &small, sizeof(small), NULL);
+  hm_save(hm, path.c_str(), NULL);
+  hm_free(hm);
+  DzHmSnapshot snapshot = hm_open_mmap(path.c_str(), true, NULL);
+  ASSERT_TRUE(snapshot);
+  ASSERT_EQ(hm_snapshot_count(snapshot), n + 1);
+  for (uint64_t i = 0; i <= n; i++) {
+    const uint64_t *value = (const uint64_t *)hm_snapshot_get(
+        snapshot, &i, sizeof(i), NULL);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(*value, i);
+  }
+  hm_snapshot_close(snapshot);
+}
+
+TEST_F(SnapshotTest, EmptyMap) {
+  DzHashmap hm = hm_init(NULL);
+  hm_save(hm, path.c_str(), NULL);
+  hm_free(hm);
+  DzHmSnapshot snapshot = hm_open_mmap(path.c_str(), true, NULL);
+  ASSERT_TRUE(snapshot);
+  ASSERT_EQ(hm_snapshot_count(snapshot), 0);
+  ASSERT_EQ(hm_snapshot_get_str(snapshot, "key"), (const char *)NULL);
+  hm_snapshot_close(snapshot);
+}
+
+TEST_F(SnapshotTest, RejectsBadFiles) {
+  DzHmError error = DzHmError_None;
+  ASSERT_EQ(hm_open_mmap("/nonexistent/dz_snapshot", false, &error),
+            (DzHmSnapshot)NULL);
+  ASSERT_EQ(error, DzHmError_Io);
+  // Empty file
+  ASSERT_EQ(hm_open_mmap(path.c_str(), false, &error), (DzHmSnapshot)NULL);
+  ASSERT_EQ(error, DzHmError_Format);
+
+  DzHashmap hm = hm_init(NULL);
+  hm_add_str(hm, "key", "value", NULL);
+  hm_save(hm, path.c_str(), NULL);
+  hm_free(hm);
+  // A damaged data section is only caught by the checksum
+  FILE *file = fopen(path.c_str(), "rb");
+  fseek(file, 0, SEEK_END);
+  const long size = ftell(file);
+  fclose(file);
+  corrupt(size - 1);
+  DzHmSnapshot snapshot = hm_open_mmap(path.c_str(), false, &error);
+  ASSERT_TRUE(snapshot);
+  hm_snapshot_close(snapshot);
+  ASSERT_EQ(hm_open_mmap(path.c_str(), true, &error), (DzHmSnapshot)NULL);
+  ASSERT_EQ(error, DzHmError_Format);
+  // A damaged magic number is always caught
+  corrupt(0);
+  ASSERT_EQ(hm_open_mmap(path.c_str(), false, &error), (DzHmSnapshot)NULL);
+  ASSERT_EQ(error, DzHmError_Format);
+}
+
+TEST_F(SnapshotTest, SaveOverOpenSnapshot) {
+  DzHashmap hm = hm_init(NULL);
+  const uint64_t n = 100000;
+  for (uint64_t i = 0; i < n; i++) {
+    hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+  }
+  hm_save(hm, path.c_str(), NULL);
+  DzHmSnapshot old_snapshot = hm_open_mmap(path.c_str(), true, NULL);
+  ASSERT_TRUE(old_snapshot);
+  // A smaller map saved over the file must not cut the old mapping
+  // short
+  hm_free(hm);
+  hm = hm_init(NULL);
+  hm_add_str(hm, "key", "value", NULL);
+  DzHmError error = DzHmError_None;
+  hm_save(hm, path.c_str(), &error);
+  ASSERT_EQ(error, DzHmError_None);
+  hm_free(hm);
+  for (uint64_t i = 0; i < n; i++) {
+    const uint64_t *value = (const uint64_t *)hm_snapshot_get(
+        old_snapshot, &i, sizeof(i), NULL);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(*value, i);
+  }
+  hm_snapshot_close(old_snapshot);
+  DzHmSnapshot snapshot = hm_open_mmap(path.c_str(), true, NULL);
+  ASSERT_TRUE(snapshot);
+  ASSERT_EQ(hm_snapshot_count(snapshot), 1);
+  ASSERT_STREQ(hm_snapshot_get_str(snapshot, "key"), "value");
+  hm_snapshot_close(snapshot);
+
+  hm = hm_init(NULL);
+  hm_save(hm, "/nonexistent/dz_snapshot", &error);
+  ASSERT_EQ(error, DzHmError_Io);
+  hm_free(hm);
+}
@@ -1,20 +1,30 @@
 #include <gtest/gtest.h>
 
+#include <string>
+#include <vector>
+
 #define _TESTING
 
 extern "C"
 {
+#include "dz_arena.h"
 #include "dz_hashmap.c"
 }
 
-TEST(DzHashmap_Item, Initialization)
+TEST(DzHashmap_Slot, Initialization)
 {
   const char*key1 = "key1";
   const char *value = "value";
-    DzHashmapItem *item = hm_item_create(key1, value, strlen(key1), strlen(value));
-    ASSERT_EQ(memcmp(item->key, key1, strlen(key1)), 0);
-    ASSERT_EQ(memcmp(item->value, value, strlen(value)), 0);
-    hm_item_free(item);
+    DZSlab slab = dz_slab_init(0);
+    DzHashmapSlot slot;
+    ASSERT_TRUE(hm_internal_slot_set(&slab, &slot, false, 7, key1, strlen(key1), value, strlen(value)));
+    ASSERT_EQ(slot.hash, 7);
+    ASSERT_FALSE(slot.is_inline);
+    ASSERT_EQ(memcmp(slot.data, key1, strlen(key1)), 0);
+    ASSERT_EQ(memcmp(slot.data + slot.keysize, value, strlen(value)), 0);
+    hm_slot_free(&slab, &slot);
+    ASSERT_EQ(slot.data, (char *)NULL);
+    dz_slab_free(&slab);
 }
 
 TEST(DzHashmap, Initialization)
@@ -22,12 +32,13 @@ TEST(DzHashmap, Initialization)
     DzHmError error = DzHmError_None;
     DzHashmap hm = hm_init(&error);
     ASSERT_EQ(error, DzHmError_None);
-    ASSERT_TRUE(hm->items);
+    ASSERT_TRUE(hm->ctrl);
+    ASSERT_TRUE(hm->slots);
     ASSERT_EQ(hm->capacity, HM_INIT_CAPACITY);
     ASSERT_EQ(hm->count, 0);
     for (size_t i = 0; i < hm->capacity; i++)
     {
-        ASSERT_EQ(hm->items[i], (DzHashmapItem *)NULL);
+        ASSERT_EQ(hm->ctrl[i], HM_CTRL_EMPTY);
     }
     hm_free(hm);
 }
@@ -104,26 +115,918 @@ TEST(DzHashmap, Resize)
         snprintf(str, 256, "%zu", i);
         hm_add_str(hm, str, str, NULL);
     }
-    printf("%zu", hm->capacity);
+    ASSERT_GT(hm->capacity, HM_INIT_CAPACITY);
+    ASSERT_EQ(hm_count(hm), HM_INIT_CAPACITY);
+    for (size_t i = 0; i < HM_INIT_CAPACITY; i++)
+    {
+        char str[256];
+        snprintf(str, 256, "%zu", i);
+        const char *value = hm_get_str(hm, str);
+        ASSERT_TRUE(value);
+        ASSERT_STREQ(value, str);
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, ManyKeys)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    const size_t n = 100000;
+    for (size_t i = 0; i < n; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), &error);
+        ASSERT_EQ(error, DzHmError_None);
+    }
+    ASSERT_EQ(hm_count(hm), n);
+    for (size_t i = 0; i < n; i += 2)
+    {
+        hm_delete(hm, &i, sizeof(i));
+    }
+    ASSERT_EQ(hm_count(hm), n / 2);
+    for (size_t i = 0; i < n; i++)
+    {
+        const size_t *value = (const size_t *)hm_get(hm, &i, sizeof(i));
+        if (i % 2 == 0)
+        {
+            ASSERT_EQ(value, (size_t *)NULL);
+        }
+        else
+        {
+            ASSERT_TRUE(value);
+            ASSERT_EQ(*value, i);
+        }
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, ValuePointerSurvivesResize)
+{
+    DzHashmap hm = hm_init(NULL);
+    hm_add_str(hm, "stable", "value", NULL);
+    const char *before = hm_get_str(hm, "stable");
+    for (size_t i = 0; i < HM_INIT_CAPACITY * 4; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+    }
+    ASSERT_EQ(before, hm_get_str(hm, "stable"));
+    hm_free(hm);
+}
+
+TEST(DzHashmap, OverwriteReusesStorage)
+{
+    DzHashmap hm = hm_init(NULL);
+    hm_add_str(hm, "key1", "value1", NULL);
+    const char *before = hm_get_str(hm, "key1");
+    hm_add_str(hm, "key1", "value2", NULL);
+    ASSERT_EQ(before, hm_get_str(hm, "key1"));
+    ASSERT_STREQ(hm_get_str(hm, "key1"), "value2");
+    // A much larger value needs a new block
+    char big[1000];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    hm_add_str(hm, "key1", big, NULL);
+    ASSERT_STREQ(hm_get_str(hm, "key1"), big);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, DeletedStorageIsReused)
+{
+    DzHashmap hm = hm_init(NULL);
+    hm_add_str(hm, "key1", "value1", NULL);
+    const char *before = hm_get_str(hm, "key1");
+    hm_delete_str(hm, "key1");
+    hm_add_str(hm, "key2", "value2", NULL);
+    ASSERT_EQ(before, hm_get_str(hm, "key2"));
+    hm_free(hm);
+}
+
+TEST(DzHashmap, TombstonesAreReused)
+{
+    DzHashmap hm = hm_init(NULL);
+    for (size_t i = 0; i < HM_INIT_CAPACITY * 100; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+        hm_delete(hm, &i, sizeof(i));
+    }
+    ASSERT_EQ(hm_count(hm), 0);
+    ASSERT_LT(hm->tombstones, hm->capacity);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, InitWithCapacityDoesNotResize)
+{
+    DzHmError error = DzHmError_None;
+    const size_t n = 1000;
+    DzHashmap hm = hm_init_with_capacity(n, &error);
+    ASSERT_EQ(error, DzHmError_None);
+    const size_t capacity = hm->capacity;
+    for (size_t i = 0; i < n; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), &error);
+    }
+    ASSERT_EQ(hm->capacity, capacity);
+    ASSERT_EQ(hm_count(hm), n);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, Reserve)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    hm_add_str(hm, "key1", "value1", &error);
+    hm_reserve(hm, 5000, &error);
+    ASSERT_EQ(error, DzHmError_None);
+    ASSERT_GT(hm->growth_limit, 5000);
+    const size_t capacity = hm->capacity;
+    // Reserving less never shrinks the table
+    hm_reserve(hm, 10, &error);
+    ASSERT_EQ(hm->capacity, capacity);
+    ASSERT_STREQ(hm_get_str(hm, "key1"), "value1");
+    hm_free(hm);
+}
+
+TEST(DzHashmap, ResizeNeverFillsTheTable)
+{
+    DzHashmap hm = hm_init(NULL);
+    for (size_t i = 0; i < 128; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+    }
+    const size_t capacity = hm->capacity;
+    // 128 slots hold the items, but leave no EMPTY slot to end probes
+    hm_resize(hm, 128, NULL);
+    ASSERT_EQ(hm->capacity, capacity);
+    const size_t missing = 128;
+    ASSERT_FALSE(hm_get(hm, &missing, sizeof(missing)));
+    hm_free(hm);
+}
+
+TEST(DzHashmap, GrowsGeometrically)
+{
+    DzHashmap hm = hm_init(NULL);
+    size_t resizes = 0;
+    size_t capacity = hm->capacity;
+    for (size_t i = 0; i < 100000; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+        if (hm->capacity != capacity)
+        {
+            ASSERT_EQ(hm->capacity, capacity * 2);
+            capacity = hm->capacity;
+            resizes++;
+        }
+    }
+    ASSERT_LT(resizes, 20);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, MaxLoadFactor)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    ASSERT_EQ(hm_get_max_load_factor(hm), HM_DEFAULT_MAX_LOAD_FACTOR);
+    hm_set_max_load_factor(hm, 0.5, &error);
+    ASSERT_EQ(error, DzHmError_None);
+    ASSERT_EQ(hm_get_max_load_factor(hm), 0.5);
+    for (size_t i = 0; i < 10000; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), &error);
+        ASSERT_LE(hm_count(hm), hm->capacity / 2);
+    }
+    // Lowering the load factor on a full table grows it right away
+    hm_set_max_load_factor(hm, 0.25, &error);
+    ASSERT_LE(hm_count(hm), hm->capacity / 4);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, DeleteWithoutTombstone)
+{
+    DzHashmap hm = hm_init(NULL);
+    hm_add_str(hm, "key1", "value1", NULL);
+    hm_delete_str(hm, "key1");
+    // The group had room left, so no probe can depend on the slot
+    ASSERT_EQ(hm->tombstones, 0);
+    for (size_t i = 0; i < hm->capacity; i++)
+    {
+        ASSERT_EQ(hm->ctrl[i], HM_CTRL_EMPTY);
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, ChurnKeepsCapacityAndTombstonesBounded)
+{
+    const size_t n = 10000;
+    DzHashmap hm = hm_init_with_capacity(n, NULL);
+    const size_t capacity = hm->capacity;
+    size_t next = 0;
+    for (; next < n; next++)
+    {
+        hm_add(hm, &next, sizeof(next), &next, sizeof(next), NULL);
+    }
+    for (size_t i = 0; i < n * 50; i++, next++)
+    {
+        const size_t oldest = next - n;
+        hm_delete(hm, &oldest, sizeof(oldest));
+        hm_add(hm, &next, sizeof(next), &next, sizeof(next), NULL);
+        ASSERT_LT(hm->count + hm->tombstones, hm->growth_limit + 1);
+    }
+    ASSERT_EQ(hm->capacity, capacity);
+    ASSERT_EQ(hm_count(hm), n);
+    for (size_t key = next - n; key < next; key++)
+    {
+        const size_t *value = (const size_t *)hm_get(hm, &key, sizeof(key));
+        ASSERT_TRUE(value);
+        ASSERT_EQ(*value, key);
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, RehashInPlace)
+{
+    DzHashmap hm = hm_init(NULL);
+    // Deletes only leave tombstones in groups that have been full.
+    // With a single EMPTY slot left, every other group is full
+    hm_set_max_load_factor(hm, 0.99, NULL);
+    // Fill, then delete most items so the table is mostly tombstones
+    for (size_t i = 0; i < hm->growth_limit; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+    }
+    for (size_t i = 0; i < hm->growth_limit; i += 3)
+    {
+        hm_delete(hm, &i, sizeof(i));
+    }
+    ASSERT_GT(hm->tombstones, 0);
+    const size_t count = hm_count(hm);
+    int8_t *ctrl = hm->ctrl;
+    hm_rehash_in_place(hm);
+    ASSERT_EQ(hm->ctrl, ctrl);
+    ASSERT_EQ(hm->tombstones, 0);
+    ASSERT_EQ(hm_count(hm), count);
+    size_t full = 0;
+    for (size_t i = 0; i < hm->capacity; i++)
+    {
+        ASSERT_NE(hm->ctrl[i], HM_CTRL_DELETED);
+        full += hm_ctrl_is_full(hm->ctrl[i]);
+    }
+    ASSERT_EQ(full, count);
+    for (size_t i = 0; i < hm->growth_limit; i++)
+    {
+        const size_t *value = (const size_t *)hm_get(hm, &i, sizeof(i));
+        if (i % 3 == 0)
+        {
+            ASSERT_EQ(value, (size_t *)NULL);
+        }
+        else
+        {
+            ASSERT_TRUE(value);
+            ASSERT_EQ(*value, i);
+        }
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, IncrementalResize)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    hm_set_incremental_resize(hm, true);
+    const size_t n = 20000;
+    bool saw_migration = false;
+    for (size_t i = 0; i < n; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), &error);
+        ASSERT_EQ(error, DzHmError_None);
+        if (hm->old_ctrl && hm->old_count > 10)
+        {
+            saw_migration = true;
+            // Every operation works while items are split over both
+            // tables, including on items that haven't moved yet
+            size_t unmoved = 0;
+            while (unmoved < hm->old_capacity &&
+                   !hm_ctrl_is_full(hm->old_ctrl[hm->old_capacity - 1 - unmoved]))
+            {
+                unmoved++;
+            }
+            const DzHashmapSlot old_slot = hm->old_slots[hm->old_capacity - 1 - unmoved];
+            size_t key;
+            memcpy(&key, hm_slot_bytes(&old_slot), sizeof(key));
+            const size_t *value = (const size_t *)hm_get(hm, &key, sizeof(key));
+            ASSERT_TRUE(value);
+            ASSERT_EQ(*value, key);
+            const size_t updated = key + n;
+            hm_add(hm, &key, sizeof(key), &updated, sizeof(updated), &error);
+            ASSERT_EQ(*(const size_t *)hm_get(hm, &key, sizeof(key)), updated);
+            hm_add(hm, &key, sizeof(key), &key, sizeof(key), &error);
+            const size_t count = hm_count(hm);
+            hm_delete(hm, &key, sizeof(key));
+            ASSERT_EQ(hm_count(hm), count - 1);
+            ASSERT_EQ(hm_get(hm, &key, sizeof(key)), (void *)NULL);
+            hm_add(hm, &key, sizeof(key), &key, sizeof(key), &error);
+            ASSERT_EQ(hm_count(hm), count);
+        }
+    }
+    ASSERT_TRUE(saw_migration);
+    ASSERT_EQ(hm_count(hm), n);
+    for (size_t i = 0; i < n; i++)
+    {
+        const size_t *value = (const size_t *)hm_get(hm, &i, sizeof(i));
+        ASSERT_TRUE(value);
+        ASSERT_EQ(*value, i);
+    }
+    // Turning incremental resizing off finishes any move in progress
+    hm_set_incremental_resize(hm, false);
+    ASSERT_EQ(hm->old_ctrl, (int8_t *)NULL);
+    ASSERT_EQ(hm_count(hm), n);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, IncrementalTombstoneCleanup)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    hm_set_incremental_resize(hm, true);
+    // A sliding window of n live keys leaves a tombstone per delete
+    const size_t n = 20000;
+    for (size_t i = 0; i < n; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), &error);
+    }
+    // Finishes the growth of the table before the churn starts
+    hm_set_incremental_resize(hm, false);
+    hm_set_incremental_resize(hm, true);
+    DzHmStats before;
+    hm_stats(hm, &before);
+    bool saw_same_size_migration = false;
+    for (size_t next = n; next < 10 * n; next++)
+    {
+        const size_t oldest = next - n;
+        hm_delete(hm, &oldest, sizeof(oldest));
+        hm_add(hm, &next, sizeof(next), &next, sizeof(next), &error);
+        ASSERT_EQ(error, DzHmError_None);
+        if (hm->old_ctrl && hm->old_capacity == hm->capacity && hm->old_count > 10)
+        {
+            saw_same_size_migration = true;
+            ASSERT_EQ(*(const size_t *)hm_get(hm, &next, sizeof(next)), next);
+            const size_t oldest_live = oldest + 1;
+            ASSERT_EQ(*(const size_t *)hm_get(hm, &oldest_live, sizeof(oldest_live)), oldest_live);
+        }
+    }
+    ASSERT_TRUE(saw_same_size_migration);
+    DzHmStats after;
+    hm_stats(hm, &after);
+    // Tombstones were dropped without growing the table
+    ASSERT_GT(after.rehash_count, before.rehash_count);
+    ASSERT_EQ(after.resize_count, before.resize_count);
+    ASSERT_EQ(hm_count(hm), n);
+    for (size_t i = 9 * n; i < 10 * n; i++)
+    {
+        const size_t *value = (const size_t *)hm_get(hm, &i, sizeof(i));
+        ASSERT_TRUE(value);
+        ASSERT_EQ(*value, i);
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, IncrementalResizeBoundedWork)
+{
+    // Latency itself is measured by bench/dz_hashmap_bench.c. Here every
+    // hm_add must move at most HM_MIGRATE_SLOTS_PER_OP slots of the old
+    // table, however big it is.
+    const size_t n = 1 << 20;
+    DzHashmap hm = hm_init(NULL);
+    hm_set_incremental_resize(hm, true);
+    size_t migrations = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const int8_t *old_ctrl = hm->old_ctrl;
+        const size_t old_capacity = hm->old_capacity;
+        const size_t migrate_index = hm->migrate_index;
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+        if (old_ctrl && hm->old_ctrl == old_ctrl)
+        {
+            ASSERT_LE(hm->migrate_index - migrate_index, HM_MIGRATE_SLOTS_PER_OP);
+            continue;
+        }
+        if (old_ctrl)
+        {
+            // This add finished the migration
+            ASSERT_LE(old_capacity - migrate_index, HM_MIGRATE_SLOTS_PER_OP);
+        }
+        if (hm->old_ctrl)
+        {
+            // This add started a new one
+            migrations++;
+            ASSERT_LE(hm->migrate_index, HM_MIGRATE_SLOTS_PER_OP);
+        }
+    }
+    ASSERT_GT(migrations, 10);
+    DzHmStats stats;
+    hm_stats(hm, &stats);
+    ASSERT_EQ(stats.resize_count, migrations);
+    ASSERT_EQ(hm_count(hm), n);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, GetMany)
+{
+    DzHashmap hm = hm_init(NULL);
+    const size_t n = 1000;
+    for (size_t i = 0; i < n; i += 2)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+    }
+    std::vector<size_t> keys(n);
+    std::vector<const void *> key_ptrs(n);
+    std::vector<size_t> keysizes(n, sizeof(size_t));
+    for (size_t i = 0; i < n; i++)
+    {
+        keys[i] = i;
+        key_ptrs[i] = &keys[i];
+    }
+    std::vector<const void *> values(n);
+    // An odd count leaves a partial batch at the end
+    hm_get_many(hm, key_ptrs.data(), keysizes.data(), n - 1, values.data());
+    for (size_t i = 0; i < n - 1; i++)
+    {
+        ASSERT_EQ(values[i], hm_get(hm, &i, sizeof(i)));
+        if (i % 2 == 0)
+        {
+            ASSERT_EQ(*(const size_t *)values[i], i);
+        }
+        else
+        {
+            ASSERT_EQ(values[i], (void *)NULL);
+        }
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, GetManyStr)
+{
+    DzHashmap hm = hm_init(NULL);
+    hm_add_str(hm, "key1", "value1", NULL);
+    hm_add_str(hm, "key2", "value2", NULL);
+    const char *keys[] = {"key2", "missing", "key1"};
+    const char *values[3];
+    hm_get_many_str(hm, keys, 3, values);
+    ASSERT_STREQ(values[0], "value2");
+    ASSERT_EQ(values[1], (char *)NULL);
+    ASSERT_STREQ(values[2], "value1");
     hm_free(hm);
 }
 
+TEST(DzHashmap, GetManyDuringIncrementalResize)
+{
+    DzHashmap hm = hm_init(NULL);
+    hm_set_incremental_resize(hm, true);
+    size_t i = 0;
+    while (!hm->old_ctrl)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), NULL);
+        i++;
+    }
+    std::vector<size_t> keys(i);
+    std::vector<const void *> key_ptrs(i);
+    std::vector<size_t> keysizes(i, sizeof(size_t));
+    std::vector<const void *> values(i);
+    for (size_t k = 0; k < i; k++)
+    {
+        keys[k] = k;
+        key_ptrs[k] = &keys[k];
+    }
+    hm_get_many(hm, key_ptrs.data(), keysizes.data(), i, values.data());
+    for (size_t k = 0; k < i; k++)
+    {
+        ASSERT_TRUE(values[k]);
+        ASSERT_EQ(*(const size_t *)values[k], k);
+    }
+    hm_free(hm);
+}
+
+TEST(Group, Match)
+{
+    alignas(16) int8_t group[HM_GROUP_WIDTH];
+    memset(group, HM_CTRL_EMPTY, sizeof(group));
+    group[3] = hm_hash_h2(0x15);
+    group[9] = hm_hash_h2(0x15);
+    group[10] = HM_CTRL_DELETED;
+    group[11] = hm_hash_h2(0x7F);
+    ASSERT_EQ(hm_group_match(group, hm_hash_h2(0x15)), (1u << 3) | (1u << 9));
+    ASSERT_EQ(hm_group_match(group, hm_hash_h2(0x16)), 0u);
+    ASSERT_EQ(hm_group_match_empty(group),
+              0xFFFFu & ~((1u << 3) | (1u << 9) | (1u << 10) | (1u << 11)));
+    ASSERT_EQ(hm_group_match_empty_or_deleted(group),
+              0xFFFFu & ~((1u << 3) | (1u << 9) | (1u << 11)));
+}
+
+TEST(Probe, VisitsEveryGroup)
+{
+    const size_t capacity = HM_GROUP_WIDTH * 64;
+    DzHmProbe probe = hm_internal_probe_start(0x123456789, capacity);
+    std::vector<bool> visited(capacity / HM_GROUP_WIDTH, false);
+    for (size_t i = 0; i < capacity / HM_GROUP_WIDTH; i++)
+    {
+        ASSERT_FALSE(visited[probe.group]);
+        visited[probe.group] = true;
+        hm_internal_probe_next(&probe);
+    }
+}
+
 /*TEST(Hash, Hash)*/
 /*{*/
 /*    size_t hash = hm_internal_hash("cat", 3, 151, 53);*/
 /*    ASSERT_EQ(hash, 5);*/
 /*}*/
 
-TEST(Prime, findNextPrime)
-{
-    ASSERT_TRUE(is_prime(100008317));
-    ASSERT_FALSE(is_prime(100008317 + 1));
-    ASSERT_TRUE(is_prime(100008317 + 2));
-    ASSERT_EQ(prime_find_next(100008317), 100008319);
-}
-
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
+
+TEST(DzHashmap, GetWithSize)
+{
+    DzHashmap hm = hm_init(NULL);
+    hm_add_str(hm, "key", "value", NULL);
+    size_t valuesize = 0;
+    const char *value = (const char *)hm_get_with_size(hm, "key", 4, &valuesize);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(valuesize, 6);
+    ASSERT_STREQ(value, "value");
+    valuesize = 0;
+    ASSERT_EQ(hm_get_with_size(hm, "missing", 8, &valuesize), (void *)NULL);
+    ASSERT_EQ(valuesize, 0);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, Prehashed)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    const char *key = "header-name";
+    const size_t keysize = strlen(key) + 1;
+    const DzHmHash hash = hm_hash(hm, key, keysize);
+    ASSERT_EQ(hash, hm_hash_str(hm, key));
+    ASSERT_EQ(hm_get_prehashed(hm, key, keysize, hash), (void *)NULL);
+    hm_add_prehashed(hm, key, keysize, hash, "v1", 3, &error);
+    ASSERT_EQ(error, DzHmError_None);
+    // Prehashed and regular calls see the same items
+    ASSERT_STREQ(hm_get_str(hm, key), "v1");
+    ASSERT_STREQ((const char *)hm_get_prehashed(hm, key, keysize, hash), "v1");
+    hm_add_str(hm, key, "v2", &error);
+    ASSERT_STREQ((const char *)hm_get_prehashed(hm, key, keysize, hash), "v2");
+    // The stored key is the map's own copy
+    const char *stored = (const char *)hm_get_key_prehashed(hm, key, keysize, hash);
+    ASSERT_TRUE(stored);
+    ASSERT_NE(stored, key);
+    ASSERT_STREQ(stored, key);
+    hm_delete_prehashed(hm, key, keysize, hash);
+    ASSERT_EQ(hm_count(hm), 0);
+    ASSERT_EQ(hm_get_str(hm, key), (char *)NULL);
+    hm_free(hm);
+}
+
+TEST(DzHashmap_Slot, Inline)
+{
+    DZSlab slab = dz_slab_init(0);
+    DzHashmapSlot slot;
+    const uint64_t key = 5;
+    const uint64_t value = 6;
+    ASSERT_TRUE(hm_internal_slot_set(&slab, &slot, true, 7, &key, sizeof(key), &value, sizeof(value)));
+    ASSERT_TRUE(slot.is_inline);
+    ASSERT_EQ(hm_slot_bytes(&slot), slot.inline_data);
+    ASSERT_EQ(memcmp(hm_slot_bytes(&slot) + sizeof(key), &value, sizeof(value)), 0);
+    // Too big to stay inline, so it moves to the slab
+    char big[HM_INLINE_SIZE] = "big value";
+    ASSERT_TRUE(hm_internal_slot_replace(&slab, &slot, true, 7, &key, sizeof(key), big, sizeof(big)));
+    ASSERT_FALSE(slot.is_inline);
+    ASSERT_STREQ(hm_slot_bytes(&slot) + sizeof(key), "big value");
+    ASSERT_TRUE(hm_internal_slot_replace(&slab, &slot, true, 7, &key, sizeof(key), &value, sizeof(value)));
+    ASSERT_TRUE(slot.is_inline);
+    hm_slot_free(&slab, &slot);
+    dz_slab_free(&slab);
+}
+
+TEST(DzHashmap, InlineSmallItems)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    hm_set_inline_small_items(hm, true);
+    const size_t n = 20000;
+    for (size_t i = 0; i < n; i++)
+    {
+        hm_add(hm, &i, sizeof(i), &i, sizeof(i), &error);
+        ASSERT_EQ(error, DzHmError_None);
+    }
+    hm_add_str(hm, "a key that is too long to be inline", "value", &error);
+    ASSERT_EQ(hm_count(hm), n + 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        const size_t *value = (const size_t *)hm_get(hm, &i, sizeof(i));
+        ASSERT_TRUE(value);
+        ASSERT_EQ(*value, i);
+    }
+    ASSERT_STREQ(hm_get_str(hm, "a key that is too long to be inline"), "value");
+    const size_t zero = 0;
+    const size_t index = hm_internal_find(hm, &zero, sizeof(zero), hm_internal_hash(hm, &zero, sizeof(zero)));
+    ASSERT_TRUE(hm->slots[index].is_inline);
+    for (size_t i = 0; i < n; i += 2)
+    {
+        hm_delete(hm, &i, sizeof(i));
+    }
+    ASSERT_EQ(hm_count(hm), n / 2 + 1);
+    for (size_t i = 1; i < n; i += 2)
+    {
+        const size_t updated = i * 2;
+        hm_add(hm, &i, sizeof(i), &updated, sizeof(updated), &error);
+        ASSERT_EQ(*(const size_t *)hm_get(hm, &i, sizeof(i)), updated);
+    }
+    // Items added before the mode is turned off stay inline
+    hm_set_inline_small_items(hm, false);
+    const size_t one = 1;
+    ASSERT_EQ(*(const size_t *)hm_get(hm, &one, sizeof(one)), 2);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, Stats)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    DzHmStats stats;
+    hm_stats(hm, &stats);
+    ASSERT_EQ(stats.count, 0);
+    ASSERT_EQ(stats.capacity, HM_INIT_CAPACITY);
+    ASSERT_EQ(stats.resize_count, 0);
+    ASSERT_EQ(stats.max_probe_length, 0);
+
+    const size_t n = 10000;
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint32_t value = (uint32_t)i;
+        hm_add(hm, &i, sizeof(i), &value, sizeof(value), &error);
+    }
+    // A group that never filled up keeps its EMPTY slots, so delete
+    // every other key of a full table to leave some tombstones
+    for (size_t i = 0; i < n; i += 2)
+    {
+        hm_delete(hm, &i, sizeof(i));
+    }
+    hm_stats(hm, &stats);
+    ASSERT_EQ(stats.count, n / 2);
+    ASSERT_EQ(stats.capacity, hm->capacity);
+    ASSERT_EQ(stats.tombstones, hm->tombstones);
+    ASSERT_GT(stats.resize_count, 0);
+    ASSERT_GT(stats.rehash_ns, 0);
+    ASSERT_DOUBLE_EQ(stats.load_factor,
+                     (double)(stats.count + stats.tombstones) / stats.capacity);
+    size_t histogram_total = 0;
+    for (size_t i = 0; i < HM_STATS_PROBE_BUCKETS; i++)
+    {
+        histogram_total += stats.probe_histogram[i];
+    }
+    ASSERT_EQ(histogram_total, stats.count);
+    ASSERT_GE(stats.avg_probe_length, 1.0);
+    ASSERT_GE(stats.max_probe_length, 1);
+    ASSERT_LE(stats.avg_probe_length, stats.max_probe_length);
+    ASSERT_EQ(stats.key_bytes, n / 2 * sizeof(size_t));
+    ASSERT_EQ(stats.value_bytes, n / 2 * sizeof(uint32_t));
+    ASSERT_EQ(stats.metadata_bytes,
+              sizeof(*hm) + hm->capacity * (1 + sizeof(DzHashmapSlot)));
+    ASSERT_EQ(stats.counters_enabled, HM_COUNTERS_ENABLED);
+    if (!stats.counters_enabled)
+    {
+        ASSERT_EQ(stats.finds, 0);
+    }
+    else
+    {
+        // Every add searches for the key first, and every delete too
+        ASSERT_GE(stats.finds, n + n / 2);
+        ASSERT_GE(stats.find_hits, n / 2);
+        ASSERT_GE(stats.find_groups, stats.finds);
+    }
+    hm_free(hm);
+}
+
+TEST(DzHashmap, GetOrInsert)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    const char *words[] = {"a", "b", "a", "c", "a", "b"};
+    for (size_t i = 0; i < array_len(words); i++)
+    {
+        bool inserted = false;
+        uint64_t *counter = (uint64_t *)hm_get_or_insert(
+            hm, words[i], strlen(words[i]) + 1, sizeof(uint64_t), &inserted, &error);
+        ASSERT_TRUE(counter);
+        ASSERT_EQ(error, DzHmError_None);
+        ASSERT_EQ(inserted, *counter == 0);
+        (*counter)++;
+    }
+    ASSERT_EQ(hm_count(hm), 3);
+    ASSERT_EQ(*(const uint64_t *)hm_get(hm, "a", 2), 3);
+    ASSERT_EQ(*(const uint64_t *)hm_get(hm, "b", 2), 2);
+    ASSERT_EQ(*(const uint64_t *)hm_get(hm, "c", 2), 1);
+
+    // Grows the table, and in small item mode the items move with it
+    hm_set_inline_small_items(hm, true);
+    for (uint64_t i = 0; i < 5000; i++)
+    {
+        uint64_t *value = (uint64_t *)hm_get_or_insert(hm, &i, sizeof(i), sizeof(uint64_t), NULL, &error);
+        ASSERT_TRUE(value);
+        *value = i * 2;
+    }
+    for (uint64_t i = 0; i < 5000; i++)
+    {
+        bool inserted = true;
+        const uint64_t *value = (const uint64_t *)hm_get_or_insert(hm, &i, sizeof(i), sizeof(uint64_t), &inserted, &error);
+        ASSERT_FALSE(inserted);
+        ASSERT_EQ(*value, i * 2);
+    }
+    ASSERT_EQ(hm_count(hm), 5003);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, Update)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    const uint64_t key = 7;
+    const uint64_t value = 1;
+    ASSERT_FALSE(hm_update(hm, &key, sizeof(key), &value, sizeof(value), &error));
+    ASSERT_EQ(hm_count(hm), 0);
+
+    hm_add(hm, &key, sizeof(key), &value, sizeof(value), &error);
+    const void *before = hm_get(hm, &key, sizeof(key));
+    const uint64_t updated = 2;
+    ASSERT_TRUE(hm_update(hm, &key, sizeof(key), &updated, sizeof(updated), &error));
+    // Same size: written in place
+    ASSERT_EQ(hm_get(hm, &key, sizeof(key)), before);
+    ASSERT_EQ(*(const uint64_t *)before, 2);
+
+    const char longer[] = "a value much longer than eight bytes";
+    ASSERT_TRUE(hm_update(hm, &key, sizeof(key), longer, sizeof(longer), &error));
+    size_t valuesize = 0;
+    ASSERT_STREQ((const char *)hm_get_with_size(hm, &key, sizeof(key), &valuesize), longer);
+    ASSERT_EQ(valuesize, sizeof(longer));
+    ASSERT_EQ(hm_count(hm), 1);
+    hm_free(hm);
+}
+
+TEST(DzHashmap, Iterate)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    DzHmIter empty = hm_iter_begin(hm);
+    ASSERT_FALSE(hm_iter_next(&empty));
+
+    hm_set_incremental_resize(hm, true);
+    const uint64_t n = 5000;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        const uint64_t value = i + 1;
+        hm_add(hm, &i, sizeof(i), &value, sizeof(value), &error);
+    }
+    for (uint64_t i = 0; i < n; i += 3)
+    {
+        hm_delete(hm, &i, sizeof(i));
+    }
+    std::vector<bool> seen(n, false);
+    size_t visited = 0;
+    DzHmIter it = hm_iter_begin(hm);
+    while (hm_iter_next(&it))
+    {
+        ASSERT_EQ(it.keysize, sizeof(uint64_t));
+        ASSERT_EQ(it.valuesize, sizeof(uint64_t));
+        const uint64_t key = *(const uint64_t *)it.key;
+        ASSERT_LT(key, n);
+        ASSERT_NE(key % 3, 0);
+        ASSERT_FALSE(seen[key]);
+        seen[key] = true;
+        ASSERT_EQ(*(const uint64_t *)it.value, key + 1);
+        // Reads are allowed during iteration
+        ASSERT_EQ(hm_get(hm, it.key, it.keysize), it.value);
+        visited++;
+    }
+    ASSERT_EQ(visited, hm_count(hm));
+    ASSERT_FALSE(hm_iter_next(&it));
+    hm_free(hm);
+}
+
+TEST(DzHashmap, Export)
+{
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init(&error);
+    for (int i = 0; i < 100; i++)
+    {
+        const std::string key = "key" + std::to_string(i);
+        const std::string value = "value" + std::to_string(i);
+        hm_add_str(hm, key.c_str(), value.c_str(), &error);
+    }
+    DZArray(DzHmSpan) keys = NULL;
+    DZArray(DzHmSpan) values = NULL;
+    const DzHmSpan first = {"first", 6};
+    dz_arrpush(keys, first);
+    ASSERT_EQ(hm_export(hm, &keys, &values), 100);
+    ASSERT_EQ(dz_arrlen(keys), 101);
+    ASSERT_EQ(dz_arrlen(values), 100);
+    ASSERT_STREQ((const char *)keys[0].data, "first");
+    for (size_t i = 0; i < 100; i++)
+    {
+        const char *key = (const char *)keys[i + 1].data;
+        ASSERT_EQ(keys[i + 1].size, strlen(key) + 1);
+        ASSERT_EQ(std::string("value") + (key + 3), (const char *)values[i].data);
+        ASSERT_EQ(hm_get_str(hm, key), values[i].data);
+    }
+    // Values only
+    DZArray(DzHmSpan) only_values = NULL;
+    ASSERT_EQ(hm_export(hm, NULL, &only_values), 100);
+    ASSERT_EQ(dz_arrlen(only_values), 100);
+    dz_arrfree(keys);
+    dz_arrfree(values);
+    dz_arrfree(only_values);
+    hm_free(hm);
+}
+
+// Counts the live blocks and bytes of an allocator built on malloc
+struct CountingAllocator
+{
+    size_t blocks = 0;
+    size_t bytes = 0;
+};
+
+static void *counting_alloc(void *user_data, size_t size)
+{
+    CountingAllocator *counts = (CountingAllocator *)user_data;
+    counts->blocks++;
+    counts->bytes += size;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *user_data, void *block, size_t old_size, size_t new_size)
+{
+    CountingAllocator *counts = (CountingAllocator *)user_data;
+    counts->bytes += new_size - old_size;
+    return realloc(block, new_size);
+}
+
+static void counting_free(void *user_data, void *block, size_t size)
+{
+    CountingAllocator *counts = (CountingAllocator *)user_data;
+    counts->blocks--;
+    counts->bytes -= size;
+    free(block);
+}
+
+TEST(DzHashmap, Allocator)
+{
+    CountingAllocator counts;
+    const DZAllocator allocator = {counting_alloc, counting_realloc, counting_free, &counts};
+    DzHmError error = DzHmError_None;
+    DzHashmap hm = hm_init_ex(0, &allocator, &error);
+    ASSERT_TRUE(hm);
+    hm_set_incremental_resize(hm, true);
+    const std::string big(DZ_SLAB_MAX_BLOCK_SIZE + 1, 'b');
+    for (uint64_t i = 0; i < 5000; i++)
+    {
+        const std::string value = i % 100 ? std::to_string(i) : big;
+        hm_add(hm, &i, sizeof(i), value.c_str(), value.size() + 1, &error);
+    }
+    for (uint64_t i = 0; i < 5000; i += 3)
+    {
+        hm_delete(hm, &i, sizeof(i));
+    }
+    ASSERT_EQ(error, DzHmError_None);
+    ASSERT_GT(counts.blocks, 2);
+    const uint64_t kept = 1;
+    ASSERT_STREQ((const char *)hm_get(hm, &kept, sizeof(kept)), "1");
+    // Every block went through the allocator, and is given back with
+    // the size it was allocated with
+    hm_free(hm);
+    ASSERT_EQ(counts.blocks, 0);
+    ASSERT_EQ(counts.bytes, 0);
+}
+
+TEST(DzHashmap, ArenaAllocator)
+{
+    DZArena arena = dz_arena_init(4 * 1024 * 1024);
+    DZAllocator allocator = dz_arena_allocator(&arena);
+    for (int round = 0; round < 3; round++)
+    {
+        DzHashmap hm = hm_init_ex(1000, &allocator, NULL);
+        ASSERT_TRUE(hm);
+        for (int i = 0; i < 1000; i++)
+        {
+            const std::string key = "key" + std::to_string(i);
+            hm_add_str(hm, key.c_str(), "value", NULL);
+        }
+        ASSERT_EQ(hm_count(hm), 1000);
+        ASSERT_STREQ(hm_get_str(hm, "key999"), "value");
+        ASSERT_GE((char *)hm, arena.data);
+        ASSERT_LT((char *)hm, arena.data + arena.max_size);
+        // Thrown away with the arena, without hm_free
+        dz_arena_clear(&arena);
+    }
+    dz_arena_free(&arena);
+}
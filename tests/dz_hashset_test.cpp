@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <string>
+
+extern "C" {
+#include "dz_hashset.h"
+}
+
+TEST(DzHashset, InsertContainsRemove) {
+  DzHmError error = DzHmError_None;
+  DzHashset set = hs_init(&error);
+  ASSERT_TRUE(set);
+  const uint64_t n = 10000;
+  for (uint64_t i = 0; i < n; i++) {
+    ASSERT_TRUE(hs_insert(set, &i, sizeof(i), &error));
+    ASSERT_EQ(error, DzHmError_None);
+  }
+  for (uint64_t i = 0; i < n; i++) {
+    ASSERT_FALSE(hs_insert(set, &i, sizeof(i), &error));
+  }
+  ASSERT_EQ(hs_count(set), n);
+  for (uint64_t i = 0; i < 2 * n; i++) {
+    ASSERT_EQ(hs_contains(set, &i, sizeof(i)), i < n);
+  }
+  for (uint64_t i = 0; i < n; i += 2) {
+    ASSERT_TRUE(hs_remove(set, &i, sizeof(i)));
+    ASSERT_FALSE(hs_remove(set, &i, sizeof(i)));
+  }
+  ASSERT_EQ(hs_count(set), n / 2);
+  for (uint64_t i = 0; i < n; i++) {
+    ASSERT_EQ(hs_contains(set, &i, sizeof(i)), i % 2 == 1);
+  }
+  hs_free(set);
+}
+
+TEST(DzHashset, Strings) {
+  DzHashset set = hs_init(NULL);
+  // Long keys don't fit in the table, and are stored out of line
+  const std::string long_key(100, 'k');
+  ASSERT_TRUE(hs_insert_str(set, "short", NULL));
+  ASSERT_TRUE(hs_insert_str(set, long_key.c_str(), NULL));
+  ASSERT_FALSE(hs_insert_str(set, long_key.c_str(), NULL));
+  ASSERT_TRUE(hs_contains_str(set, "short"));
+  ASSERT_TRUE(hs_contains_str(set, long_key.c_str()));
+  ASSERT_FALSE(hs_contains_str(set, "missing"));
+  ASSERT_TRUE(hs_remove_str(set, long_key.c_str()));
+  ASSERT_FALSE(hs_contains_str(set, long_key.c_str()));
+  ASSERT_EQ(hs_count(set), 1u);
+  hs_free(set);
+}
+
+TEST(DzHashset, UnionIntersect) {
+  DzHmError error = DzHmError_None;
+  DzHashset a = hs_init(&error);
+  DzHashset b = hs_init_with_capacity(1000, &error);
+  // a holds multiples of 2 below 3000, b multiples of 3
+  for (uint64_t i = 0; i < 3000; i++) {
+    if (i % 2 == 0) {
+      hs_insert(a, &i, sizeof(i), &error);
+    }
+    if (i % 3 == 0) {
+      hs_insert(b, &i, sizeof(i), &error);
+    }
+  }
+  hs_insert_str(b, "a string", &error);
+
+  DzHashset both = hs_init(&error);
+  hs_union(both, a, &error);
+  ASSERT_EQ(error, DzHmError_None);
+  ASSERT_EQ(hs_count(both), 1500u);
+  hs_intersect(both, b);
+  ASSERT_EQ(hs_count(both), 500u);
+  for (uint64_t i = 0; i < 3000; i++) {
+    ASSERT_EQ(hs_contains(both, &i, sizeof(i)), i % 6 == 0);
+  }
+
+  hs_union(a, b, &error);
+  ASSERT_EQ(error, DzHmError_None);
+  ASSERT_EQ(hs_count(a), 1500u + 1000u - 500u + 1u);
+  ASSERT_TRUE(hs_contains_str(a, "a string"));
+  for (uint64_t i = 0; i < 3000; i++) {
+    ASSERT_EQ(hs_contains(a, &i, sizeof(i)), i % 2 == 0 || i % 3 == 0);
+  }
+  // A set with itself
+  hs_union(a, a, &error);
+  hs_intersect(a, a);
+  ASSERT_EQ(hs_count(a), 2001u);
+  hs_free(a);
+  hs_free(b);
+  hs_free(both);
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "dz_intern.h"
+}
+
+TEST(Interner, SameStringSamePointer) {
+  DzHmError error = DzHmError_None;
+  DZInterner interner = dz_interner_init(&error);
+  ASSERT_EQ(error, DzHmError_None);
+  char a[] = "content-type";
+  char b[] = "content-type";
+  const char *ia = dz_intern(&interner, a, &error);
+  const char *ib = dz_intern(&interner, b, &error);
+  ASSERT_EQ(error, DzHmError_None);
+  ASSERT_EQ(ia, ib);
+  ASSERT_NE(ia, a);
+  ASSERT_STREQ(ia, "content-type");
+  ASSERT_NE(dz_intern(&interner, "accept", &error), ia);
+  ASSERT_EQ(dz_interner_count(&interner), 2);
+  dz_interner_free(&interner);
+}
+
+TEST(Interner, Find) {
+  DZInterner interner = dz_interner_init(NULL);
+  ASSERT_EQ(dz_intern_find(&interner, "host"), (const char *)NULL);
+  const char *host = dz_intern(&interner, "host", NULL);
+  ASSERT_EQ(dz_intern_find(&interner, "host"), host);
+  ASSERT_EQ(dz_interner_count(&interner), 1);
+  dz_interner_free(&interner);
+}
+
+TEST(Interner, HandlesSurviveGrowth) {
+  DZInterner interner = dz_interner_init(NULL);
+  std::vector<const char *> handles;
+  for (int i = 0; i < 10000; i++) {
+    handles.push_back(
+        dz_intern(&interner, std::to_string(i).c_str(), NULL));
+  }
+  ASSERT_EQ(dz_interner_count(&interner), 10000);
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_STREQ(handles[i], std::to_string(i).c_str());
+    ASSERT_EQ(dz_intern(&interner, std::to_string(i).c_str(), NULL),
+              handles[i]);
+  }
+  dz_interner_free(&interner);
+}
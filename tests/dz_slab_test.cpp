@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+extern "C" {
+#include "dz_slab.h"
+}
+
+TEST(Slab, Initialization) {
+  DZSlab slab = dz_slab_init(0);
+  ASSERT_EQ(slab.chunk_size, DZ_SLAB_DEFAULT_CHUNK_SIZE);
+  ASSERT_EQ(slab.chunks, (DZSlabChunk *)NULL);
+  dz_slab_free(&slab);
+}
+
+TEST(Slab, Allocation) {
+  DZSlab slab = dz_slab_init(0);
+  char *a = (char *)dz_slab_alloc(&slab, 50);
+  char *b = (char *)dz_slab_alloc(&slab, 50);
+  ASSERT_TRUE(a);
+  ASSERT_TRUE(b);
+  ASSERT_NE(a, b);
+  memset(a, 'a', 50);
+  memset(b, 'b', 50);
+  ASSERT_EQ(a[49], 'a');
+  ASSERT_EQ(b[0], 'b');
+  dz_slab_free(&slab);
+}
+
+TEST(Slab, Alignment) {
+  DZSlab slab = dz_slab_init(0);
+  for (size_t size = 1; size < 3000; size += 37) {
+    void *block = dz_slab_alloc(&slab, size);
+    ASSERT_EQ((uintptr_t)block % 16, 0);
+  }
+  dz_slab_free(&slab);
+}
+
+TEST(Slab, ReusesFreedBlocks) {
+  DZSlab slab = dz_slab_init(0);
+  void *a = dz_slab_alloc(&slab, 40);
+  dz_slab_dealloc(&slab, a, 40);
+  // Any size in the same class gets the freed block back
+  void *b = dz_slab_alloc(&slab, 33);
+  ASSERT_EQ(a, b);
+  dz_slab_free(&slab);
+}
+
+TEST(Slab, SteadyStateDoesNotGrow) {
+  DZSlab slab = dz_slab_init(0);
+  void *blocks[1000];
+  for (size_t i = 0; i < 1000; i++) {
+    blocks[i] = dz_slab_alloc(&slab, 24);
+  }
+  DZSlabChunk *chunks = slab.chunks;
+  for (size_t round = 0; round < 10; round++) {
+    for (size_t i = 0; i < 1000; i++) {
+      dz_slab_dealloc(&slab, blocks[i], 24);
+    }
+    for (size_t i = 0; i < 1000; i++) {
+      blocks[i] = dz_slab_alloc(&slab, 24);
+    }
+  }
+  ASSERT_EQ(slab.chunks, chunks);
+  dz_slab_free(&slab);
+}
+
+TEST(Slab, LargeBlocks) {
+  DZSlab slab = dz_slab_init(0);
+  char *a = (char *)dz_slab_alloc(&slab, DZ_SLAB_MAX_BLOCK_SIZE + 1);
+  char *b = (char *)dz_slab_alloc(&slab, 100000);
+  char *c = (char *)dz_slab_alloc(&slab, 100000);
+  memset(a, 1, DZ_SLAB_MAX_BLOCK_SIZE + 1);
+  memset(b, 2, 100000);
+  ASSERT_EQ((uintptr_t)a % 16, 0);
+  // Deallocating from the middle of the list keeps the rest intact
+  dz_slab_dealloc(&slab, b, 100000);
+  ASSERT_EQ(a[DZ_SLAB_MAX_BLOCK_SIZE], 1);
+  memset(c, 3, 100000);
+  dz_slab_free(&slab);
+}
+
+TEST(Slab, SameClass) {
+  ASSERT_TRUE(dz_slab_same_class(1, 16));
+  ASSERT_FALSE(dz_slab_same_class(16, 17));
+  ASSERT_TRUE(dz_slab_same_class(300, 500));
+  ASSERT_FALSE(dz_slab_same_class(DZ_SLAB_MAX_BLOCK_SIZE,
+                                  DZ_SLAB_MAX_BLOCK_SIZE + 1));
+}
+
+TEST(Slab, ChunkRemainderIsNotLost) {
+  DZSlab slab = dz_slab_init(DZ_SLAB_MAX_BLOCK_SIZE);
+  void *small = dz_slab_alloc(&slab, 16);
+  // Doesn't fit in what is left of the first chunk
+  void *big = dz_slab_alloc(&slab, DZ_SLAB_MAX_BLOCK_SIZE);
+  ASSERT_TRUE(small);
+  ASSERT_TRUE(big);
+  // The leftover of the first chunk serves the next small blocks
+  char *next = (char *)dz_slab_alloc(&slab, 2048);
+  ASSERT_GT(next, (char *)small);
+  ASSERT_LT(next, (char *)small + DZ_SLAB_MAX_BLOCK_SIZE);
+  dz_slab_free(&slab);
+}
+
+TEST(Slab, Merge) {
+  DZSlab dst = dz_slab_init(0);
+  DZSlab src = dz_slab_init(0);
+  void *kept = dz_slab_alloc(&dst, 64);
+  void *freed = dz_slab_alloc(&src, 64);
+  char *moved = (char *)dz_slab_alloc(&src, 64);
+  void *large = dz_slab_alloc(&src, DZ_SLAB_MAX_BLOCK_SIZE * 2);
+  memset(moved, 'm', 64);
+  dz_slab_dealloc(&src, freed, 64);
+  dz_slab_merge(&dst, &src);
+  ASSERT_EQ(src.chunks, (DZSlabChunk *)NULL);
+  ASSERT_EQ(src.large_blocks, (DZSlabLargeBlock *)NULL);
+  // Blocks of src stay where they are, and its free blocks are reused
+  ASSERT_EQ(moved[63], 'm');
+  ASSERT_EQ(dz_slab_alloc(&dst, 64), freed);
+  dz_slab_dealloc(&dst, large, DZ_SLAB_MAX_BLOCK_SIZE * 2);
+  dz_slab_dealloc(&dst, kept, 64);
+  // src is still usable, and dst frees everything at once
+  ASSERT_TRUE(dz_slab_alloc(&src, 64));
+  dz_slab_free(&src);
+  dz_slab_free(&dst);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <map>
+
+extern "C" {
+#include "dz_typed_hashmap.h"
+}
+
+DZ_HASHMAP_DEFINE(U64Map, uint64_t, uint32_t, dz_hash_u64, dz_eq_scalar)
+DZ_HASHMAP_DEFINE(StrMap, const char *, int, dz_hash_str, dz_eq_str)
+
+TEST(TypedHashmap, ZeroedMapIsEmpty) {
+  U64Map map = {0};
+  ASSERT_EQ(U64Map_count(&map), 0);
+  ASSERT_EQ(U64Map_get(&map, 1), (uint32_t *)NULL);
+  ASSERT_FALSE(U64Map_delete(&map, 1));
+  ASSERT_TRUE(U64Map_put(&map, 1, 10));
+  ASSERT_EQ(*U64Map_get(&map, 1), 10);
+  U64Map_free(&map);
+  ASSERT_EQ(map.ctrl, (int8_t *)NULL);
+}
+
+TEST(TypedHashmap, PutGetDelete) {
+  U64Map map;
+  ASSERT_TRUE(U64Map_init(&map, 0));
+  const uint64_t n = 100000;
+  for (uint64_t i = 0; i < n; i++) {
+    ASSERT_TRUE(U64Map_put(&map, i * 3, (uint32_t)i));
+  }
+  ASSERT_EQ(U64Map_count(&map), n);
+  for (uint64_t i = 0; i < n; i++) {
+    uint32_t *value = U64Map_get(&map, i * 3);
+    ASSERT_TRUE(value);
+    ASSERT_EQ(*value, i);
+    ASSERT_FALSE(U64Map_contains(&map, i * 3 + 1));
+  }
+  // Overwrite through put and through the returned pointer
+  ASSERT_TRUE(U64Map_put(&map, 0, 99));
+  ASSERT_EQ(*U64Map_get(&map, 0), 99);
+  *U64Map_get(&map, 3) = 100;
+  ASSERT_EQ(*U64Map_get(&map, 3), 100);
+  ASSERT_EQ(U64Map_count(&map), n);
+  for (uint64_t i = 0; i < n; i += 2) {
+    ASSERT_TRUE(U64Map_delete(&map, i * 3));
+  }
+  ASSERT_EQ(U64Map_count(&map), n / 2);
+  for (uint64_t i = 0; i < n; i++) {
+    ASSERT_EQ(U64Map_contains(&map, i * 3), i % 2 == 1);
+  }
+  U64Map_free(&map);
+}
+
+TEST(TypedHashmap, InitWithCapacityDoesNotResize) {
+  U64Map map;
+  ASSERT_TRUE(U64Map_init(&map, 1000));
+  const size_t capacity = map.capacity;
+  for (uint64_t i = 0; i < 1000; i++) {
+    U64Map_put(&map, i, (uint32_t)i);
+  }
+  ASSERT_EQ(map.capacity, capacity);
+  U64Map_free(&map);
+}
+
+TEST(TypedHashmap, ChurnKeepsCapacityBounded) {
+  U64Map map = {0};
+  const uint64_t n = 1000;
+  for (uint64_t i = 0; i < n; i++) {
+    U64Map_put(&map, i, (uint32_t)i);
+  }
+  const size_t capacity = map.capacity;
+  for (uint64_t i = n; i < 50 * n; i++) {
+    ASSERT_TRUE(U64Map_delete(&map, i - n));
+    ASSERT_TRUE(U64Map_put(&map, i, (uint32_t)i));
+  }
+  ASSERT_EQ(map.capacity, capacity);
+  ASSERT_EQ(U64Map_count(&map), n);
+  U64Map_free(&map);
+}
+
+TEST(TypedHashmap, StringKeys) {
+  StrMap map = {0};
+  char keys[100][16];
+  for (int i = 0; i < 100; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+    StrMap_put(&map, keys[i], i);
+  }
+  for (int i = 0; i < 100; i++) {
+    char lookup[16];
+    snprintf(lookup, sizeof(lookup), "key%d", i);
+    ASSERT_EQ(*StrMap_get(&map, lookup), i);
+  }
+  ASSERT_FALSE(StrMap_contains(&map, "missing"));
+  StrMap_free(&map);
+}
+
+TEST(TypedHashmap, MatchesStdMap) {
+  U64Map map = {0};
+  std::map<uint64_t, uint32_t> reference;
+  uint64_t state = 1;
+  for (int i = 0; i < 200000; i++) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    const uint64_t key = (state >> 33) % 5000;
+    if ((state >> 20) % 3 == 0) {
+      ASSERT_EQ(U64Map_delete(&map, key), reference.erase(key) == 1);
+    } else {
+      U64Map_put(&map, key, (uint32_t)i);
+      reference[key] = (uint32_t)i;
+    }
+  }
+  ASSERT_EQ(U64Map_count(&map), reference.size());
+  for (const auto &item : reference) {
+    ASSERT_EQ(*U64Map_get(&map, item.first), item.second);
+  }
+  U64Map_free(&map);
+}